@@ -0,0 +1,124 @@
+#include "Animables/AxisAnimationBatch.h"
+
+#include <Magnum/Math/Functions.h>
+#include <Magnum/Math/Constants.h>
+#include <Corrade/Containers/GrowableArray.h>
+#include <Corrade/Utility/Assert.h>
+#include <cmath>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define MOSAIIKKI_SSE2
+#include <emmintrin.h>
+#endif
+
+using namespace Magnum;
+using namespace Corrade;
+
+namespace
+{
+
+// phase of distance 0, moving in positive direction
+// for finite ranges, phase [0, 2 * range) moves up from -range, [2 * range, 4 * range) moves down from range
+Float initialPhase(Float range)
+{
+    return range < Constants::inf() ? range : 0.0f;
+}
+
+Float stepScalar(Float& phase, Float velocity, Float range, Float delta)
+{
+    Float p = phase + velocity * delta;
+    if(range < Constants::inf())
+    {
+        const Float period = 4.0f * range;
+        p -= period * std::floor(p / period);
+        phase = p;
+        return p < 2.0f * range ? p - range : 3.0f * range - p;
+    }
+
+    phase = p;
+    return p;
+}
+
+}
+
+void AxisAnimationBatch::reserve(size_t capacity)
+{
+    Containers::arrayReserve(_axes, capacity);
+    Containers::arrayReserve(velocities, capacity);
+    Containers::arrayReserve(ranges, capacity);
+    Containers::arrayReserve(phases, capacity);
+    Containers::arrayReserve(_distances, capacity);
+}
+
+size_t AxisAnimationBatch::add(const Vector3& axis, Float velocity, Float range)
+{
+    range = Math::abs(range);
+    // no movement possible, avoid a zero period
+    if(range == 0.0f)
+    {
+        velocity = 0.0f;
+        range = Constants::inf();
+    }
+
+    Containers::arrayAppend(_axes, axis.normalized());
+    Containers::arrayAppend(velocities, velocity);
+    Containers::arrayAppend(ranges, range);
+    Containers::arrayAppend(phases, initialPhase(range));
+    Containers::arrayAppend(_distances, 0.0f);
+    return phases.size() - 1;
+}
+
+void AxisAnimationBatch::reset()
+{
+    for(size_t i = 0; i < phases.size(); i++)
+    {
+        phases[i] = initialPhase(ranges[i]);
+        _distances[i] = 0.0f;
+    }
+}
+
+void AxisAnimationBatch::step(Float delta, size_t begin, size_t end)
+{
+    CORRADE_ASSERT(begin <= end && end <= size(), "AxisAnimationBatch::step(): range out of bounds", );
+
+    size_t i = begin;
+
+#ifdef MOSAIIKKI_SSE2
+    const __m128 delta4 = _mm_set1_ps(delta);
+    const __m128 infinity4 = _mm_set1_ps(Constants::inf());
+    const __m128 one4 = _mm_set1_ps(1.0f);
+    const __m128 two4 = _mm_set1_ps(2.0f);
+    const __m128 three4 = _mm_set1_ps(3.0f);
+    const __m128 four4 = _mm_set1_ps(4.0f);
+
+    for(; i + 4 <= end; i += 4)
+    {
+        const __m128 range = _mm_loadu_ps(ranges.data() + i);
+        const __m128 velocity = _mm_loadu_ps(velocities.data() + i);
+        __m128 p = _mm_add_ps(_mm_loadu_ps(phases.data() + i), _mm_mul_ps(velocity, delta4));
+
+        // p -= period * floor(p / period)
+        // SSE2 has no floor, truncate and correct negative values
+        // the phase stays within one period, so the quotient always fits an int
+        // infinite ranges produce NaN here, those lanes are masked out below
+        const __m128 period = _mm_mul_ps(four4, range);
+        const __m128 quotient = _mm_div_ps(p, period);
+        __m128 floored = _mm_cvtepi32_ps(_mm_cvttps_epi32(quotient));
+        floored = _mm_sub_ps(floored, _mm_and_ps(_mm_cmpgt_ps(floored, quotient), one4));
+        const __m128 wrapped = _mm_sub_ps(p, _mm_mul_ps(period, floored));
+
+        // triangle wave
+        const __m128 up = _mm_cmplt_ps(wrapped, _mm_mul_ps(two4, range));
+        const __m128 distance = _mm_or_ps(_mm_and_ps(up, _mm_sub_ps(wrapped, range)),
+                                          _mm_andnot_ps(up, _mm_sub_ps(_mm_mul_ps(three4, range), wrapped)));
+
+        const __m128 finite = _mm_cmplt_ps(range, infinity4);
+        p = _mm_or_ps(_mm_and_ps(finite, wrapped), _mm_andnot_ps(finite, p));
+        _mm_storeu_ps(phases.data() + i, p);
+        _mm_storeu_ps(_distances.data() + i, _mm_or_ps(_mm_and_ps(finite, distance), _mm_andnot_ps(finite, p)));
+    }
+#endif
+
+    for(; i < end; i++)
+        _distances[i] = stepScalar(phases[i], velocities[i], ranges[i], delta);
+}
@@ -0,0 +1,56 @@
+#pragma once
+
+#include <Magnum/Magnum.h>
+#include <Magnum/Math/Vector3.h>
+#include <Corrade/Containers/Array.h>
+#include <Corrade/Containers/ArrayView.h>
+
+// axis animations of many instances, stepped together in one pass over contiguous parameters
+// each one moves back and forth between -range and range along its axis (same as AxisRotationAnimable),
+// or keeps going for an infinite range
+// the ping-pong is evaluated in closed form: the state is a phase on a triangle wave with period 4 * range,
+// so huge deltas cost the same as small ones and there's no data-dependent loop to stop vectorization
+class AxisAnimationBatch
+{
+public:
+    size_t size() const
+    {
+        return phases.size();
+    }
+
+    void reserve(size_t capacity);
+
+    // returns the index of the new animation
+    size_t add(const Magnum::Vector3& axis, Magnum::Float velocity, Magnum::Float range);
+
+    // move everything back to distance 0, positive direction
+    void reset();
+
+    // uses SSE2 if available
+    void step(Magnum::Float delta)
+    {
+        step(delta, 0, size());
+    }
+
+    // only step animations [begin, end), ranges can be stepped in parallel
+    void step(Magnum::Float delta, size_t begin, size_t end);
+
+    // normalized
+    Corrade::Containers::ArrayView<const Magnum::Vector3> axes() const
+    {
+        return _axes;
+    }
+
+    // current signed distance along the axis
+    Corrade::Containers::ArrayView<const Magnum::Float> distances() const
+    {
+        return _distances;
+    }
+
+private:
+    Corrade::Containers::Array<Magnum::Vector3> _axes;
+    Corrade::Containers::Array<Magnum::Float> velocities;
+    Corrade::Containers::Array<Magnum::Float> ranges;
+    Corrade::Containers::Array<Magnum::Float> phases;
+    Corrade::Containers::Array<Magnum::Float> _distances;
+};
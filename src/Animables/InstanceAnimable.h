@@ -0,0 +1,106 @@
+#pragma once
+
+#include "InstanceStore.h"
+#include "Animables/AxisAnimationBatch.h"
+#include "JobSystem.h"
+#include <Magnum/SceneGraph/Animable.h>
+#include <Magnum/SceneGraph/AbstractObject.h>
+#include <Magnum/Math/Matrix4.h>
+#include <Magnum/Math/Vector3.h>
+#include <Magnum/Math/Angle.h>
+#include <Magnum/Math/Constants.h>
+#include <Corrade/Containers/ArrayView.h>
+#include <Corrade/Containers/Array.h>
+#include <Corrade/Containers/GrowableArray.h>
+
+// animates instances of an InstanceStore, one animable for all of them
+// the axis animations are stepped in batches, see AxisAnimationBatch
+// each instance moves back and forth along an axis and rotates around another
+template<typename Transform>
+class InstanceAnimable : public Magnum::SceneGraph::Animable3D
+{
+public:
+    typedef Magnum::SceneGraph::AbstractObject<Transform::Dimensions, typename Transform::Type> Object;
+
+    // instances per job
+    static constexpr size_t GrainSize = 1024;
+
+    // steps on the calling thread if jobSystem is nullptr
+    explicit InstanceAnimable(Object& object, InstanceStore& store, JobSystem* jobSystem = nullptr) :
+        Magnum::SceneGraph::Animable3D(object), store(store), jobSystem(jobSystem)
+    {
+        setRepeated(true);
+    }
+
+    void reserve(size_t capacity)
+    {
+        Corrade::Containers::arrayReserve(instances, capacity);
+        Corrade::Containers::arrayReserve(baseTransformations, capacity);
+        translation.reserve(capacity);
+        rotation.reserve(capacity);
+    }
+
+    // animation is relative to the instance's current transformation
+    // each instance can only be added once
+    void add(size_t instance,
+             const Magnum::Vector3& translationAxis,
+             Magnum::Float translationVelocity, /* units per second */
+             Magnum::Float translationRange,    /* units */
+             const Magnum::Vector3& rotationAxis,
+             Magnum::Rad rotationVelocity, /* radians per second */
+             Magnum::Rad rotationRange = Magnum::Rad(Magnum::Constants::inf()) /* radians */)
+    {
+        Corrade::Containers::arrayAppend(instances, instance);
+        Corrade::Containers::arrayAppend(baseTransformations, store.transformations()[instance]);
+        translation.add(translationAxis, translationVelocity, translationRange);
+        rotation.add(rotationAxis, Magnum::Float(rotationVelocity), Magnum::Float(rotationRange));
+    }
+
+private:
+    virtual void animationStopped() override
+    {
+        translation.reset();
+        rotation.reset();
+        update(0, instances.size());
+    }
+
+    virtual void animationStep(Magnum::Float /*absolute*/, Magnum::Float delta) override
+    {
+        auto step = [this, delta](size_t begin, size_t end) {
+            translation.step(delta, begin, end);
+            rotation.step(delta, begin, end);
+            update(begin, end);
+        };
+
+        if(jobSystem)
+            jobSystem->parallelFor(instances.size(), GrainSize, step);
+        else
+            step(0, instances.size());
+    }
+
+    void update(size_t begin, size_t end)
+    {
+        Corrade::Containers::ArrayView<Magnum::Matrix4> transformations = store.transformations();
+        Corrade::Containers::ArrayView<const Magnum::Vector3> translationAxes = translation.axes();
+        Corrade::Containers::ArrayView<const Magnum::Float> translationDistances = translation.distances();
+        Corrade::Containers::ArrayView<const Magnum::Vector3> rotationAxes = rotation.axes();
+        Corrade::Containers::ArrayView<const Magnum::Float> rotationDistances = rotation.distances();
+
+        for(size_t i = begin; i < end; i++)
+        {
+            // translate() is applied globally, rotateLocal() locally
+            Magnum::Matrix4 transformation =
+                baseTransformations[i] * Magnum::Matrix4::rotation(Magnum::Rad(rotationDistances[i]), rotationAxes[i]);
+            transformation.translation() += translationAxes[i] * translationDistances[i];
+            transformations[instances[i]] = transformation;
+        }
+    }
+
+    InstanceStore& store;
+    JobSystem* jobSystem;
+
+    Corrade::Containers::Array<size_t> instances;
+    Corrade::Containers::Array<Magnum::Matrix4> baseTransformations;
+    AxisAnimationBatch translation;
+    AxisAnimationBatch rotation;
+};
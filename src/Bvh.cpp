@@ -0,0 +1,176 @@
+#include "Bvh.h"
+
+#include <Magnum/Math/Functions.h>
+#include <Corrade/Containers/GrowableArray.h>
+#include <Corrade/Utility/Assert.h>
+#include <algorithm>
+
+using namespace Magnum;
+using namespace Corrade;
+
+namespace
+{
+
+enum class Containment
+{
+    Outside,
+    Intersecting,
+    Inside
+};
+
+Containment testFrustum(const Frustum& frustum, const Range3D& range)
+{
+    const Vector3 center = range.center();
+    const Vector3 extent = range.size() * 0.5f;
+
+    Containment result = Containment::Inside;
+    for(size_t i = 0; i < 6; i++)
+    {
+        // plane normals point inside
+        const Vector4& plane = frustum[i];
+        const Float distance = Math::dot(plane.xyz(), center) + plane.w();
+        const Float radius = Math::dot(Math::abs(plane.xyz()), extent);
+        if(distance < -radius)
+            return Containment::Outside;
+        if(distance < radius)
+            result = Containment::Intersecting;
+    }
+
+    return result;
+}
+
+}
+
+void Bvh::build(Containers::ArrayView<const Range3D> bounds)
+{
+    items = Containers::Array<UnsignedInt>(NoInit, bounds.size());
+    for(UnsignedInt i = 0; i < items.size(); i++)
+        items[i] = i;
+
+    nodes = {};
+    if(bounds.isEmpty())
+        return;
+
+    Containers::arrayReserve(nodes, 2 * (bounds.size() / LeafSize + 1));
+    Containers::arrayAppend(nodes, Node { {}, 0, UnsignedInt(items.size()) });
+    split(0, bounds);
+}
+
+void Bvh::split(UnsignedInt node, Containers::ArrayView<const Range3D> bounds)
+{
+    // explicit stack instead of recursion, the tree can get deep for degenerate input
+    Containers::Array<UnsignedInt> stack;
+    Containers::arrayAppend(stack, node);
+
+    while(!stack.isEmpty())
+    {
+        const UnsignedInt current = stack[stack.size() - 1];
+        Containers::arrayRemoveSuffix(stack);
+
+        const UnsignedInt first = nodes[current].first;
+        const UnsignedInt count = nodes[current].count;
+        UnsignedInt* begin = items.data() + first;
+        UnsignedInt* end = begin + count;
+
+        Range3D nodeBounds = bounds[*begin];
+        Range3D centers { bounds[*begin].center(), bounds[*begin].center() };
+        for(const UnsignedInt* item = begin + 1; item != end; item++)
+        {
+            nodeBounds = Math::join(nodeBounds, bounds[*item]);
+            const Vector3 center = bounds[*item].center();
+            centers = { Math::min(centers.min(), center), Math::max(centers.max(), center) };
+        }
+        nodes[current].bounds = nodeBounds;
+
+        if(count <= LeafSize)
+            continue;
+
+        // median split along the longest axis of the item centers
+        const Vector3 size = centers.size();
+        const size_t axis = size.x() >= size.y() && size.x() >= size.z() ? 0 : (size.y() >= size.z() ? 1 : 2);
+        UnsignedInt* middle = begin + count / 2;
+        std::nth_element(begin, middle, end, [&bounds, axis](UnsignedInt a, UnsignedInt b) {
+            return bounds[a].center()[axis] < bounds[b].center()[axis];
+        });
+
+        const UnsignedInt left = UnsignedInt(nodes.size());
+        const UnsignedInt leftCount = UnsignedInt(middle - begin);
+        Containers::arrayAppend(nodes, Node { {}, first, leftCount });
+        Containers::arrayAppend(nodes, Node { {}, first + leftCount, count - leftCount });
+        // nodes might have been reallocated, don't hold on to references
+        nodes[current].first = left;
+        nodes[current].count = 0;
+
+        Containers::arrayAppend(stack, left);
+        Containers::arrayAppend(stack, left + 1);
+    }
+}
+
+void Bvh::refit(Containers::ArrayView<const Range3D> bounds)
+{
+    CORRADE_ASSERT(bounds.size() == items.size(),
+                   "Bvh::refit(): expected" << items.size() << "bounds but got" << bounds.size(), );
+
+    for(size_t i = nodes.size(); i > 0; i--)
+    {
+        Node& node = nodes[i - 1];
+        if(node.count > 0)
+        {
+            Range3D nodeBounds = bounds[items[node.first]];
+            for(UnsignedInt item = node.first + 1; item < node.first + node.count; item++)
+                nodeBounds = Math::join(nodeBounds, bounds[items[item]]);
+            node.bounds = nodeBounds;
+        }
+        else
+            node.bounds = Math::join(nodes[node.first].bounds, nodes[node.first + 1].bounds);
+    }
+}
+
+void Bvh::cull(const Frustum& frustum,
+               Containers::ArrayView<const Range3D> bounds,
+               Containers::ArrayView<bool> visible) const
+{
+    CORRADE_ASSERT(bounds.size() == items.size() && visible.size() == items.size(),
+                   "Bvh::cull(): bounds and visible must have one entry per item", );
+
+    for(bool& item : visible)
+        item = false;
+
+    if(nodes.isEmpty())
+        return;
+
+    // node index, highest bit set if the node is known to be inside
+    constexpr UnsignedInt InsideBit = 1u << 31;
+    Containers::Array<UnsignedInt> stack;
+    Containers::arrayAppend(stack, 0u);
+
+    while(!stack.isEmpty())
+    {
+        const UnsignedInt entry = stack[stack.size() - 1];
+        Containers::arrayRemoveSuffix(stack);
+
+        const Node& node = nodes[entry & ~InsideBit];
+        Containment containment = Containment::Inside;
+        if(!(entry & InsideBit))
+        {
+            containment = testFrustum(frustum, node.bounds);
+            if(containment == Containment::Outside)
+                continue;
+        }
+
+        const UnsignedInt flag = containment == Containment::Inside ? InsideBit : 0;
+        if(node.count > 0)
+        {
+            for(UnsignedInt item = node.first; item < node.first + node.count; item++)
+            {
+                const UnsignedInt index = items[item];
+                visible[index] = flag || testFrustum(frustum, bounds[index]) != Containment::Outside;
+            }
+        }
+        else
+        {
+            Containers::arrayAppend(stack, node.first | flag);
+            Containers::arrayAppend(stack, (node.first + 1) | flag);
+        }
+    }
+}
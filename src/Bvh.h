@@ -0,0 +1,56 @@
+#pragma once
+
+#include <Magnum/Magnum.h>
+#include <Magnum/Math/Range.h>
+#include <Magnum/Math/Frustum.h>
+#include <Corrade/Containers/Array.h>
+#include <Corrade/Containers/ArrayView.h>
+
+// bounding volume hierarchy over axis-aligned boxes
+// build() once, then refit() every frame with the moved bounds, this keeps the tree structure
+// and is much cheaper than rebuilding as long as the items don't move too far from where they started
+class Bvh
+{
+public:
+    // maximum items per leaf
+    static constexpr size_t LeafSize = 4;
+
+    size_t size() const
+    {
+        return items.size();
+    }
+
+    size_t nodeCount() const
+    {
+        return nodes.size();
+    }
+
+    // item indices are indices into bounds
+    void build(Corrade::Containers::ArrayView<const Magnum::Range3D> bounds);
+
+    // bounds must have the same size as in build()
+    void refit(Corrade::Containers::ArrayView<const Magnum::Range3D> bounds);
+
+    // set visible[i] for all items whose bounds intersect the frustum, visible must have size() entries
+    // items of nodes completely inside the frustum aren't tested individually
+    // bounds are needed for the leaf tests and must be the ones used in the last build() or refit()
+    void cull(const Magnum::Frustum& frustum,
+              Corrade::Containers::ArrayView<const Magnum::Range3D> bounds,
+              Corrade::Containers::ArrayView<bool> visible) const;
+
+private:
+    struct Node
+    {
+        Magnum::Range3D bounds;
+        // leaf: first item and item count
+        // inner node: index of the left child, right child follows it, count is 0
+        Magnum::UnsignedInt first;
+        Magnum::UnsignedInt count;
+    };
+
+    void split(Magnum::UnsignedInt node, Corrade::Containers::ArrayView<const Magnum::Range3D> bounds);
+
+    // children always come after their parent, so refitting in reverse order updates children first
+    Corrade::Containers::Array<Node> nodes;
+    Corrade::Containers::Array<Magnum::UnsignedInt> items;
+};
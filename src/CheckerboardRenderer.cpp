@@ -0,0 +1,709 @@
+#include "CheckerboardRenderer.h"
+
+#include "Scene.h"
+#include <Magnum/GL/Version.h>
+#include <Magnum/GL/Context.h>
+#include <Magnum/GL/Extensions.h>
+#include <Magnum/GL/DebugOutput.h>
+#include <Magnum/GL/DefaultFramebuffer.h>
+#include <Magnum/GL/TextureFormat.h>
+#include <Magnum/GL/Renderer.h>
+#include <Magnum/MeshTools/FullScreenTriangle.h>
+#include <Magnum/Math/Color.h>
+#include <Magnum/Math/Functions.h>
+#include <Corrade/Utility/Format.h>
+#include <Corrade/Containers/String.h>
+#include <Corrade/Containers/Optional.h>
+
+using namespace Magnum;
+using namespace Corrade;
+using namespace Magnum::Math::Literals;
+
+namespace
+{
+// quadrant each frame of the four-frame cycle renders, same as FRAME_QUADRANTS in ReconstructionCommon.glsl
+constexpr Int FrameQuadrants[4] = { 0, 3, 1, 2 };
+} // namespace
+
+CheckerboardRenderer::CheckerboardRenderer(Vector2i size) :
+    outputFramebuffer(NoCreate),
+    outputColorAttachment(NoCreate),
+    scaledOutputFramebuffer(NoCreate),
+    scaledOutputColorAttachment(NoCreate),
+    fullscreenTriangle(NoCreate),
+    velocityFramebuffer(NoCreate),
+    velocityAttachment(NoCreate),
+    velocityDepthAttachment(NoCreate),
+    hiZPyramid(NoCreate),
+    framebuffers { GL::Framebuffer(NoCreate),
+                   GL::Framebuffer(NoCreate),
+                   GL::Framebuffer(NoCreate),
+                   GL::Framebuffer(NoCreate) },
+    colorAttachments(NoCreate),
+    depthAttachments(NoCreate),
+    linearDepthFramebuffers { GL::Framebuffer(NoCreate),
+                              GL::Framebuffer(NoCreate),
+                              GL::Framebuffer(NoCreate),
+                              GL::Framebuffer(NoCreate) },
+    linearDepthAttachments(NoCreate),
+    depthBlitShader(NoCreate),
+    linearDepthShader(NoCreate),
+    hiZShader(NoCreate),
+    reconstructionShaders(DirectInit, NoCreate),
+    computeReconstructionShaders(DirectInit, NoCreate)
+{
+    MAGNUM_ASSERT_GL_EXTENSION_SUPPORTED(GL::Extensions::ARB::explicit_attrib_location); // core in 3.3
+    MAGNUM_ASSERT_GL_EXTENSION_SUPPORTED(GL::Extensions::ARB::sample_shading);           // core in 4.0
+    MAGNUM_ASSERT_GL_EXTENSION_SUPPORTED(GL::Extensions::ARB::texture_multisample);      // core in 3.2
+    MAGNUM_ASSERT_GL_EXTENSION_SUPPORTED(GL::Extensions::ARB::uniform_buffer_object);    // core in 3.1
+
+    GL::Renderer::enable(GL::Renderer::Feature::Multisampling);
+
+    // Framebuffers
+
+    resizeFramebuffers(size);
+
+    // Shaders
+    // independent programs first, see ProgramCache::setupParallelCompile()
+
+    // only the resolve variant for the default options is compiled upfront, the others when they're first used
+
+#ifdef CORRADE_IS_DEBUG_BUILD
+    reconstructionFlags |= ReconstructionShader::Flag::Debug;
+#endif
+    computeResolveSupported = ReconstructionShader::isComputeSupported();
+
+    const ReconstructionShader::Flags defaultVariant = ReconstructionShader::variant(Options::Reconstruction{});
+    const size_t defaultVariantIndex = ReconstructionShader::variantIndex(defaultVariant);
+
+    DepthBlitShader::CompileState depthBlitState = DepthBlitShader::compile();
+    ReconstructionShader::CompileState reconstructionState =
+        ReconstructionShader::compile(reconstructionFlags | defaultVariant);
+    Containers::Optional<ReconstructionShader::CompileState> computeReconstructionState;
+    if(computeResolveSupported)
+        computeReconstructionState.emplace(ReconstructionShader::compile(reconstructionFlags | defaultVariant |
+                                                                         ReconstructionShader::Flag::Compute));
+
+    linearDepthShader = LinearDepthShader();
+    linearDepthShader.setLabel("Depth linearization shader");
+
+    if(HiZShader::isSupported())
+    {
+        hiZShader = HiZShader();
+        hiZShader.setLabel("Hi-Z pyramid shader");
+    }
+
+    depthBlitShader = DepthBlitShader(std::move(depthBlitState));
+    depthBlitShader.setLabel("Depth blit shader");
+
+    reconstructionShaders[defaultVariantIndex] = ReconstructionShader(std::move(reconstructionState));
+    reconstructionShaders[defaultVariantIndex].setLabel(
+        Utility::format("Checkerboard resolve shader (variant {})", defaultVariantIndex));
+
+    if(computeReconstructionState)
+    {
+        computeReconstructionShaders[defaultVariantIndex] =
+            ReconstructionShader(std::move(*computeReconstructionState));
+        computeReconstructionShaders[defaultVariantIndex].setLabel(
+            Utility::format("Checkerboard resolve compute shader (variant {})", defaultVariantIndex));
+    }
+
+    const GL::Version version = GL::Context::current().version();
+    CORRADE_INTERNAL_ASSERT(version >= GL::Version::GL300);
+    fullscreenTriangle = MeshTools::fullScreenTriangle(version);
+}
+
+void CheckerboardRenderer::prepareScene(Scene& scene)
+{
+    // LOD calculation is something roughly equivalent to: log2(max(len(dFdx(uv)), len(dFdy(uv)))
+    // halving the rendering width/height doubles the derivate length
+    // after upsampling, textures would become blurry compared to full-resolution rendering
+    // so offset LOD to lower mip level to full resolution equivalent (log2(sqrt(2)) = 0.5)
+    // textures of a scene that's still loading get it once they're uploaded
+    scene.textureLodBias = -0.5f;
+    for(Containers::Pointer<GL::Texture2D>& texture : scene.textures)
+    {
+        if(texture)
+            texture->setLodBias(scene.textureLodBias);
+    }
+}
+
+void CheckerboardRenderer::resizeFramebuffers(Vector2i size)
+{
+    // make texture dimensions multiple of two
+    size += size % 2;
+    this->size = size;
+
+    // xy = velocity, z = mask for dynamic objects
+    velocityAttachment = GL::Texture2D();
+    velocityAttachment.setStorage(1, GL::TextureFormat::RGBA16F, size);
+    velocityAttachment.setLabel("Velocity texture");
+    velocityDepthAttachment = GL::Texture2D();
+    velocityDepthAttachment.setStorage(1, GL::TextureFormat::DepthComponent24, size);
+    velocityDepthAttachment.setLabel("Velocity depth texture");
+
+    velocityFramebuffer = GL::Framebuffer({ { 0, 0 }, size });
+    velocityFramebuffer.attachTexture(GL::Framebuffer::ColorAttachment(0), velocityAttachment, 0 /* level */);
+    velocityFramebuffer.attachTexture(GL::Framebuffer::BufferAttachment::Depth, velocityDepthAttachment, 0 /* level */);
+    velocityFramebuffer.mapForDraw({ { VelocityShader::VelocityOutput, GL::Framebuffer::ColorAttachment(0) } });
+    velocityFramebuffer.setLabel("Velocity framebuffer");
+
+    CORRADE_INTERNAL_ASSERT(velocityFramebuffer.checkStatus(GL::FramebufferTarget::Read) ==
+                            GL::Framebuffer::Status::Complete);
+    CORRADE_INTERNAL_ASSERT(velocityFramebuffer.checkStatus(GL::FramebufferTarget::Draw) ==
+                            GL::Framebuffer::Status::Complete);
+
+    if(HiZShader::isSupported())
+    {
+        hiZPyramid = HiZShader::createPyramid(size);
+        hiZPyramid.setLabel("Hi-Z pyramid texture");
+    }
+
+    createFrameAttachments();
+
+    outputColorAttachment = GL::Texture2D();
+    outputColorAttachment.setStorage(1, GL::TextureFormat::RGBA8, size);
+    // filter and wrapping for zoomed GUI debug output
+    outputColorAttachment.setMagnificationFilter(SamplerFilter::Nearest);
+    outputColorAttachment.setWrapping({ GL::SamplerWrapping::ClampToBorder, GL::SamplerWrapping::ClampToBorder });
+    outputColorAttachment.setBorderColor(0x000000_rgbf);
+    outputColorAttachment.setLabel("Output color texture");
+
+    outputFramebuffer = GL::Framebuffer({ { 0, 0 }, size });
+    outputFramebuffer.attachTexture(GL::Framebuffer::ColorAttachment(0), outputColorAttachment, 0 /* level */);
+    // no depth buffer needed
+    outputFramebuffer.mapForDraw({ { ReconstructionShader::ColorOutput, GL::Framebuffer::ColorAttachment(0) } });
+    outputFramebuffer.setLabel("Output framebuffer");
+
+    CORRADE_INTERNAL_ASSERT(outputFramebuffer.checkStatus(GL::FramebufferTarget::Read) ==
+                            GL::Framebuffer::Status::Complete);
+    CORRADE_INTERNAL_ASSERT(outputFramebuffer.checkStatus(GL::FramebufferTarget::Draw) ==
+                            GL::Framebuffer::Status::Complete);
+
+    scaledOutputFramebuffer = GL::Framebuffer(NoCreate);
+    scaledOutputColorAttachment = GL::Texture2D(NoCreate);
+
+    // keep the scale, the new framebuffers need its viewports
+    _renderSize = {};
+    setRenderScale(_renderScale);
+}
+
+void CheckerboardRenderer::createFrameAttachments()
+{
+    const Vector2i quarterSize = size / 2;
+    const Vector3i arraySize = { quarterSize, Int(_frames) };
+
+    // the four-frame cycle renders without multisampling but keeps the 2x MSAA storage so the resolve reads
+    // the same textures, both samples get the same value and usually compress to one
+
+    colorAttachments = GL::MultisampleTexture2DArray();
+    colorAttachments.setStorage(2, GL::TextureFormat::RGBA8, arraySize, GL::MultisampleTextureSampleLocations::Fixed);
+    colorAttachments.setLabel("Color texture array (quarter-res 2x MSAA)");
+    depthAttachments = GL::MultisampleTexture2DArray();
+    depthAttachments.setStorage(
+        2, GL::TextureFormat::DepthComponent24, arraySize, GL::MultisampleTextureSampleLocations::Fixed);
+    depthAttachments.setLabel("Depth texture array (quarter-res 2x MSAA)");
+
+    for(size_t i = 0; i < _frames; i++)
+    {
+        framebuffers[i] = GL::Framebuffer({ { 0, 0 }, quarterSize });
+        framebuffers[i].attachTextureLayer(GL::Framebuffer::ColorAttachment(0), colorAttachments, i /* layer */);
+        framebuffers[i].attachTextureLayer(GL::Framebuffer::BufferAttachment::Depth, depthAttachments, i /* layer */);
+        framebuffers[i].mapForDraw({ { Shaders::GenericGL3D::ColorOutput, GL::Framebuffer::ColorAttachment(0) } });
+        framebuffers[i].setLabel(Utility::format("Framebuffer {} (quarter-res)", i + 1));
+
+        CORRADE_INTERNAL_ASSERT(framebuffers[i].checkStatus(GL::FramebufferTarget::Read) ==
+                                GL::Framebuffer::Status::Complete);
+        CORRADE_INTERNAL_ASSERT(framebuffers[i].checkStatus(GL::FramebufferTarget::Draw) ==
+                                GL::Framebuffer::Status::Complete);
+    }
+
+    // RG16F isn't precise enough for the default depth tolerance at the far plane
+    linearDepthAttachments = GL::Texture2DArray();
+    linearDepthAttachments.setStorage(1, GL::TextureFormat::RG32F, arraySize);
+    linearDepthAttachments.setLabel("Linear depth texture array (quarter-res)");
+
+    for(size_t i = 0; i < _frames; i++)
+    {
+        linearDepthFramebuffers[i] = GL::Framebuffer({ { 0, 0 }, quarterSize });
+        linearDepthFramebuffers[i].attachTextureLayer(
+            GL::Framebuffer::ColorAttachment(0), linearDepthAttachments, 0 /* level */, i /* layer */);
+        linearDepthFramebuffers[i].mapForDraw(
+            { { LinearDepthShader::LinearDepthOutput, GL::Framebuffer::ColorAttachment(0) } });
+        linearDepthFramebuffers[i].setLabel(Utility::format("Linear depth framebuffer {} (quarter-res)", i + 1));
+
+        CORRADE_INTERNAL_ASSERT(linearDepthFramebuffers[i].checkStatus(GL::FramebufferTarget::Draw) ==
+                                GL::Framebuffer::Status::Complete);
+    }
+
+    // the unused ones reference the previous attachments
+    for(size_t i = _frames; i < MAX_FRAMES; i++)
+    {
+        framebuffers[i] = GL::Framebuffer(NoCreate);
+        linearDepthFramebuffers[i] = GL::Framebuffer(NoCreate);
+    }
+
+    // sample locations are framebuffer state with ARB/NV_sample_locations
+    setSamplePositions();
+}
+
+void CheckerboardRenderer::setFrames(size_t frames)
+{
+    CORRADE_ASSERT(frames == 2 || frames == 4, "CheckerboardRenderer::setFrames(): frames must be 2 or 4", );
+
+    if(frames == _frames)
+        return;
+
+    _frames = frames;
+    createFrameAttachments();
+    setViewports();
+
+    // the layers were reallocated, nothing to reproject into
+    currentFrame = 0;
+    for(auto* shaders : { &reconstructionShaders, &computeReconstructionShaders })
+    {
+        for(ReconstructionShader& shader : *shaders)
+        {
+            if(shader.id())
+                shader.invalidateHistory();
+        }
+    }
+}
+
+void CheckerboardRenderer::setRenderScale(Float scale)
+{
+    CORRADE_ASSERT(scale > 0.0f && scale <= 1.0f, "CheckerboardRenderer::setRenderScale(): scale must be in (0, 1]", );
+
+    _renderScale = scale;
+
+    // multiple of two like the framebuffer size
+    const Vector2i renderSize =
+        Math::clamp(Vector2i(Math::round(Vector2(size) * scale * 0.5f)) * 2, Vector2i(2), size);
+    if(renderSize != _renderSize)
+    {
+        _renderSize = renderSize;
+        setViewports();
+    }
+}
+
+void CheckerboardRenderer::setViewports()
+{
+    const Range2Di viewport = { { 0, 0 }, _renderSize };
+    const Range2Di quarterViewport = { { 0, 0 }, _renderSize / 2 };
+
+    velocityFramebuffer.setViewport(viewport);
+    for(size_t i = 0; i < _frames; i++)
+    {
+        framebuffers[i].setViewport(quarterViewport);
+        linearDepthFramebuffers[i].setViewport(quarterViewport);
+    }
+
+    if(_renderSize != size && !scaledOutputFramebuffer.id())
+        createScaledOutput();
+    if(scaledOutputFramebuffer.id())
+        scaledOutputFramebuffer.setViewport(viewport);
+}
+
+void CheckerboardRenderer::createScaledOutput()
+{
+    scaledOutputColorAttachment = GL::Texture2D();
+    scaledOutputColorAttachment.setStorage(1, GL::TextureFormat::RGBA8, size);
+    scaledOutputColorAttachment.setLabel("Scaled output color texture");
+
+    scaledOutputFramebuffer = GL::Framebuffer({ { 0, 0 }, size });
+    scaledOutputFramebuffer.attachTexture(
+        GL::Framebuffer::ColorAttachment(0), scaledOutputColorAttachment, 0 /* level */);
+    scaledOutputFramebuffer.mapForDraw(
+        { { ReconstructionShader::ColorOutput, GL::Framebuffer::ColorAttachment(0) } });
+    scaledOutputFramebuffer.setLabel("Scaled output framebuffer");
+
+    CORRADE_INTERNAL_ASSERT(scaledOutputFramebuffer.checkStatus(GL::FramebufferTarget::Read) ==
+                            GL::Framebuffer::Status::Complete);
+    CORRADE_INTERNAL_ASSERT(scaledOutputFramebuffer.checkStatus(GL::FramebufferTarget::Draw) ==
+                            GL::Framebuffer::Status::Complete);
+}
+
+void CheckerboardRenderer::setSamplePositions()
+{
+    const GLsizei SAMPLE_COUNT = 2;
+    const Vector2 samplePositions[SAMPLE_COUNT] = { { 0.75f, 0.75f }, { 0.25f, 0.25f } };
+
+    // set explicit MSAA sample locations
+    // OpenGL does not specify them, so we have to do it manually using one of three extensions
+
+    // ARB extension is really only supported by Nvidia (Maxwell and later) and requires GL 4.5
+    bool ext_arb = GL::Context::current().isExtensionSupported<GL::Extensions::ARB::sample_locations>();
+    bool ext_nv = GL::Context::current().isExtensionSupported<GL::Extensions::NV::sample_locations>();
+    bool ext_amd = GL::Context::current().isExtensionSupported<GL::Extensions::AMD::sample_positions>();
+    // Haven't found an Intel extension although D3D12 support for it exists
+
+    if(!(ext_arb || ext_nv || ext_amd))
+    {
+        // none of the extensions are supported (also happens in RenderDoc which force-disables it)
+        // warn here instead of aborting because you might have the correct sample positions anyway (which we check below)
+        // the sample positions we request seem to be the default on Nvidia GPUs
+        Warning() << "No extension for setting sample positions found!";
+    }
+
+    for(size_t frame = 0; frame < _frames; frame++)
+    {
+        framebuffers[frame].bind();
+
+        if(ext_arb)
+        {
+            int supportedSampleCount = 0;
+            glGetIntegerv(GL_PROGRAMMABLE_SAMPLE_LOCATION_TABLE_SIZE_ARB, &supportedSampleCount);
+            CORRADE_INTERNAL_ASSERT(SAMPLE_COUNT <= supportedSampleCount);
+
+            glFramebufferParameteri(GL_FRAMEBUFFER, GL_FRAMEBUFFER_PROGRAMMABLE_SAMPLE_LOCATIONS_ARB, GL_TRUE);
+            glFramebufferSampleLocationsfvARB(GL_FRAMEBUFFER, 0, SAMPLE_COUNT, samplePositions[0].data());
+        }
+        else if(ext_nv)
+        {
+            int supportedSampleCount = 0;
+            glGetIntegerv(GL_PROGRAMMABLE_SAMPLE_LOCATION_TABLE_SIZE_NV, &supportedSampleCount);
+            CORRADE_INTERNAL_ASSERT(SAMPLE_COUNT <= supportedSampleCount);
+
+            glFramebufferParameteri(GL_FRAMEBUFFER, GL_FRAMEBUFFER_PROGRAMMABLE_SAMPLE_LOCATIONS_NV, GL_TRUE);
+            glFramebufferSampleLocationsfvNV(GL_FRAMEBUFFER, 0, SAMPLE_COUNT, samplePositions[0].data());
+        }
+        else if(ext_amd)
+        {
+            for(GLuint i = 0; i < SAMPLE_COUNT; i++)
+            {
+                glSetMultisamplefvAMD(GL_SAMPLE_POSITION, i, samplePositions[i].data());
+            }
+        }
+    }
+
+    // read back, report and check actual sample locations
+
+    bool mismatch = false;
+    Debug(Debug::Flag::NoSpace) << "MSAA " << SAMPLE_COUNT << "x sample positions:";
+    for(GLuint i = 0; i < SAMPLE_COUNT; i++)
+    {
+        Vector2 position;
+        // GL_SAMPLE_POSITION reads the default sample location with ARB/NV_sample_locations
+        GLenum name = ext_arb ? GL_PROGRAMMABLE_SAMPLE_LOCATION_ARB
+                              : (ext_nv ? GL_PROGRAMMABLE_SAMPLE_LOCATION_NV : GL_SAMPLE_POSITION);
+        glGetMultisamplefv(name, i, position.data());
+        Debug(Debug::Flag::NoSpace) << i << ": " << position;
+
+        // positions can be quantized, so only do a rough comparison
+        // we can query the quantization amount (SUBSAMPLE_DISTANCE_AMD and SAMPLE_LOCATION_SUBPIXEL_BITS_NV)
+        // but we're only interested in an acceptable absolute error anyway
+        constexpr float allowedError = 1.0f / 8.0f;
+        if((Math::abs(position - samplePositions[i]) > Vector2(allowedError)).any())
+        {
+            mismatch = true;
+        }
+    }
+
+    if(mismatch)
+        Error() << "Wrong sample positions, output will likely be incorrect!";
+
+    GL::defaultFramebuffer.bind();
+}
+
+ReconstructionShader& CheckerboardRenderer::reconstructionShader(bool compute, const Options::Reconstruction& options)
+{
+    const ReconstructionShader::Flags variant = ReconstructionShader::variant(options);
+    const size_t index = ReconstructionShader::variantIndex(variant);
+    ReconstructionShader& shader = compute ? computeReconstructionShaders[index] : reconstructionShaders[index];
+    if(!shader.id())
+    {
+        // loaded from ProgramCache after the first run, otherwise this stalls for the compile
+        ReconstructionShader::Flags flags = reconstructionFlags | variant;
+        if(compute)
+            flags |= ReconstructionShader::Flag::Compute;
+        shader = ReconstructionShader(flags);
+        shader.setLabel(Utility::format(
+            compute ? "Checkerboard resolve compute shader (variant {})" : "Checkerboard resolve shader (variant {})",
+            index));
+
+        // take over the camera history once, from the first other variant that exists
+        bool copied = false;
+        for(auto* shaders : { &reconstructionShaders, &computeReconstructionShaders })
+        {
+            for(const ReconstructionShader& other : *shaders)
+            {
+                if(!copied && other.id() && &other != &shader)
+                {
+                    shader.copyCameraInfo(other);
+                    copied = true;
+                }
+            }
+        }
+    }
+    return shader;
+}
+
+void CheckerboardRenderer::draw(Scene& scene, const Options& options)
+{
+    constexpr GL::Renderer::DepthFunction depthFunction = GL::Renderer::DepthFunction::LessOrEqual; // default: Less
+
+    GL::Renderer::enable(GL::Renderer::Feature::FaceCulling);
+    GL::Renderer::enable(GL::Renderer::Feature::DepthTest);
+    GL::Renderer::setDepthFunction(depthFunction);
+
+    GL::Renderer::disable(GL::Renderer::Feature::Blending);
+    GL::Renderer::setBlendEquation(GL::Renderer::BlendEquation::Add, GL::Renderer::BlendEquation::Add);
+    GL::Renderer::setBlendFunction(GL::Renderer::BlendFunction::SourceAlpha,
+                                   GL::Renderer::BlendFunction::OneMinusSourceAlpha);
+
+    setFrames(size_t(options.reconstruction.frames));
+
+    scene.streamingBuffer.beginFrame();
+
+    // single scene traversal for the velocity and quarter-res passes
+    scene.prepareInstances();
+
+    Containers::StaticArray<MAX_FRAMES, Matrix4> matrices;
+
+    const Matrix4 unjitteredProjection = scene.camera->projectionMatrix();
+    const bool fourFrames = _frames == 4;
+    if(!fourFrames)
+    {
+        // jitter viewport half a pixel to the right = one pixel in the full-res framebuffer
+        // = width of NDC divided by full-res pixel count
+        const float offset = 2.0f / _renderSize.x();
+        matrices[JITTERED_FRAME] = Matrix4::translation(Vector3::xAxis(offset)) * unjitteredProjection;
+        matrices[1 - JITTERED_FRAME] = unjitteredProjection;
+    }
+    else
+    {
+        // move the quarter-res pixel center from the corner between its quadrants onto one of them
+        // = half a full-res pixel in each direction
+        for(size_t frame = 0; frame < _frames; frame++)
+        {
+            const Int quadrant = FrameQuadrants[frame];
+            const Vector2 quadrantOffset = { Float(quadrant & 1), Float(quadrant >> 1) };
+            const Vector2 offset = (Vector2(0.5f) - quadrantOffset) * 2.0f / Vector2(_renderSize);
+            matrices[frame] = Matrix4::translation({ offset, 0.0f }) * unjitteredProjection;
+        }
+    }
+
+    // the four-frame jitter isn't a whole full-res pixel, the velocity depth blit couldn't pick a matching pixel
+    // render the velocity pass unjittered and let the blit pick the pixel under the jittered sample instead
+    const Matrix4& velocityProjection = fourFrames ? unjitteredProjection : matrices[currentFrame];
+    const Matrix4& oldVelocityProjection = fourFrames ? oldProjection : oldMatrices[currentFrame];
+
+    // fill velocity buffer
+
+    if(options.reconstruction.createVelocityBuffer)
+    {
+        GL::DebugGroup group(GL::DebugGroup::Source::Application, 0, "Velocity buffer");
+        GpuProfiler::Scope scope(profiler, "Velocity buffer");
+
+        velocityFramebuffer.bind();
+        velocityFramebuffer.clearColor(0, 0_rgbf);
+        velocityFramebuffer.clearDepth(1.0f);
+
+        // dynamic objects only
+        // camera velocity for static objects is calculated with reprojection in the checkerboard resolve pass
+        if(scene.meshAnimables.runningCount() > 0)
+        {
+            // offset depth for the depth blit, otherwise the depth test might fail in the quarter-res pass
+            // not entirely sure what causes this, could be floating point inaccuracy?
+            // slope bias allows an offset based on triangle depth gradient,
+            // without it we'd need to use a larger constant bias and pray it works
+            GL::Renderer::enable(GL::Renderer::Feature::PolygonOffsetFill);
+            GL::Renderer::setPolygonOffset(1 /* slope bias */, 1 /* constant bias */);
+
+            // use current frame's jitter
+            // this only matters because we blit the velocity depth buffer to reuse it for the quarter resolution pass
+            // without it, you can use either jittered or unjittered, as long as they match
+            scene.velocityShader.setProjectionMatrix(velocityProjection)
+                .setOldProjectionMatrix(oldVelocityProjection);
+
+            scene.drawQueue(RenderQueue::Pass::Velocity, RenderQueue::Layer::Opaque);
+
+            // transparent objects shouldn't write to the depth buffer if we blit and reuse it in the quarter-res scene pass
+            // without depth writes they have to be sorted back to front, the render queue sorts drawables and
+            // InstanceStore::drawOrder() sorts instances
+            GL::Renderer::setDepthMask(GL_FALSE);
+            scene.drawQueue(RenderQueue::Pass::Velocity, RenderQueue::Layer::Transparent);
+            GL::Renderer::setDepthMask(GL_TRUE);
+
+            GL::Renderer::disable(GL::Renderer::Feature::PolygonOffsetFill);
+
+            // velocity depth contains all opaque instances, cull the ones it hides from the quarter-res pass
+            // the depth is rendered with this frame's velocity projection so no reprojection is necessary
+            if(scene.occlusionCulling && hiZShader.id())
+            {
+                GL::DebugGroup group2(GL::DebugGroup::Source::Application, 0, "Occlusion culling");
+                GpuProfiler::Scope scope2(profiler, "Occlusion culling");
+
+                hiZShader.build(velocityDepthAttachment, hiZPyramid);
+
+                // the pyramid covers the whole texture, map NDC to the rendered part of it
+                // the rest was cleared to the far plane, so instances reaching into it are never culled
+                const Vector2 scale = Vector2(_renderSize) / Vector2(size);
+                const Matrix4 viewportTransformation =
+                    Matrix4::translation({ scale - Vector2(1.0f), 0.0f }) * Matrix4::scaling({ scale, 1.0f });
+                scene.occludeInstances(hiZPyramid, viewportTransformation * velocityProjection);
+            }
+        }
+    }
+
+    // render scene at quarter resolution
+
+    {
+        GL::DebugGroup group(GL::DebugGroup::Source::Application, 0, "Scene rendering (quarter-res)");
+        GpuProfiler::Scope scope(profiler, "Scene rendering (quarter-res)");
+
+        GL::Framebuffer& framebuffer = framebuffers[currentFrame];
+        framebuffer.bind();
+
+        // run fragment shader for each sample
+        // the four-frame cycle shades once per pixel: without multisampling it's rasterized at the
+        // (jittered) pixel center and written to both samples
+        if(fourFrames)
+        {
+            GL::Renderer::disable(GL::Renderer::Feature::Multisampling);
+        }
+        else
+        {
+            GL::Renderer::enable(GL::Renderer::Feature::SampleShading);
+            GL::Renderer::setMinSampleShading(1.0f);
+        }
+
+        // copy and reuse velocity depth buffer
+        if(options.reconstruction.createVelocityBuffer && options.reuseVelocityDepth)
+        {
+            GL::DebugGroup group2(GL::DebugGroup::Source::Application, 0, "Velocity depth blit");
+            GpuProfiler::Scope scope2(profiler, "Velocity depth blit");
+
+            GL::Renderer::setDepthFunction(
+                GL::Renderer::DepthFunction::Always); // fullscreen pass, always pass depth test
+            GL::Renderer::setColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE); // disable color writing
+
+            // blit to quarter res with max filter
+            depthBlitShader.bindDepth(velocityDepthAttachment)
+                .setQuadrant(fourFrames ? FrameQuadrants[currentFrame] : -1);
+            depthBlitShader.draw(fullscreenTriangle);
+
+            GL::Renderer::setColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+            GL::Renderer::setDepthFunction(depthFunction);
+
+            // implementations can choose to optimize storage by not writing actual depth
+            // values and reconstructing them during sampling at the default sample positions
+            // these commands force correct per-sample depth to be written to the depth buffer
+            if(glEvaluateDepthValuesARB)
+                glEvaluateDepthValuesARB();
+            else if(glResolveDepthValuesNV)
+                glResolveDepthValuesNV();
+        }
+        else
+        {
+            framebuffer.clearDepth(1.0f);
+        }
+
+        const Color4 clearColor = Color4::fromSrgb(0x772953_rgbf); // Ubuntu Canonical aubergine
+        framebuffer.clearColor(0, clearColor);
+
+        // use jittered camera if necessary
+        scene.camera->setProjectionMatrix(matrices[currentFrame]);
+
+        GL::Renderer::enable(GL::Renderer::Feature::Blending);
+
+        // opaque drawables front to back, then transparent ones back to front
+        scene.drawQueue(RenderQueue::Pass::Color, RenderQueue::Layer::Opaque);
+        scene.drawQueue(RenderQueue::Pass::Color, RenderQueue::Layer::Transparent);
+
+        GL::Renderer::disable(GL::Renderer::Feature::Blending);
+
+        GL::Renderer::disable(GL::Renderer::Feature::SampleShading);
+        GL::Renderer::enable(GL::Renderer::Feature::Multisampling);
+    }
+
+    // undo any jitter
+    scene.camera->setProjectionMatrix(unjitteredProjection);
+
+    // linearize depth once per sample, the resolve reads each one multiple times
+
+    {
+        GL::DebugGroup group(GL::DebugGroup::Source::Application, 1, "Depth linearization");
+        GpuProfiler::Scope scope(profiler, "Depth linearization");
+
+        linearDepthFramebuffers[currentFrame].bind();
+
+        GL::Renderer::disable(GL::Renderer::Feature::DepthTest);
+
+        linearDepthShader.bindDepth(depthAttachments)
+            .setLayer(currentFrame)
+            .setCameraPlanes(scene.cameraNear, scene.cameraFar);
+        linearDepthShader.draw(fullscreenTriangle);
+    }
+
+    // combine framebuffers
+
+    const bool scaled = _renderSize != size;
+
+    {
+        GL::DebugGroup group(GL::DebugGroup::Source::Application, 1, "Checkerboard resolve");
+        GpuProfiler::Scope scope(profiler, "Checkerboard resolve");
+
+        GL::Renderer::disable(GL::Renderer::Feature::DepthTest);
+
+        const bool compute = options.computeResolve && isComputeResolveSupported();
+        // below the output size, resolve at the render size and upscale afterwards
+        GL::Framebuffer& resolveFramebuffer = scaled ? scaledOutputFramebuffer : outputFramebuffer;
+        GL::Texture2D& resolveAttachment = scaled ? scaledOutputColorAttachment : outputColorAttachment;
+        ReconstructionShader& shader = reconstructionShader(compute, options.reconstruction);
+
+        // all programs keep track of the previous camera, so update the inactive ones as well
+        // otherwise switching between them reprojects with stale matrices
+        for(auto* shaders : { &reconstructionShaders, &computeReconstructionShaders })
+        {
+            for(ReconstructionShader& inactiveShader : *shaders)
+            {
+                if(inactiveShader.id() && &inactiveShader != &shader)
+                    inactiveShader.setCameraInfo(*scene.camera, _renderSize, scene.cameraNear, scene.cameraFar);
+            }
+        }
+
+        shader.bindColor(colorAttachments)
+            .bindLinearDepth(linearDepthAttachments)
+            .bindVelocity(velocityAttachment)
+            .setCurrentFrame(currentFrame)
+            .setCameraInfo(*scene.camera, _renderSize, scene.cameraNear, scene.cameraFar)
+            .setOptions(options.reconstruction)
+            .setBuffer(scene.streamingBuffer);
+
+        if(compute)
+        {
+            shader.bindOutput(resolveAttachment).dispatch(_renderSize);
+            // output is read by framebuffer blits and sampled in the UI
+            GL::Renderer::setMemoryBarrier(GL::Renderer::MemoryBarrier::Framebuffer |
+                                           GL::Renderer::MemoryBarrier::TextureFetch);
+        }
+        else
+        {
+            resolveFramebuffer.bind();
+            shader.draw(fullscreenTriangle);
+        }
+    }
+
+    if(scaled)
+    {
+        GL::DebugGroup group(GL::DebugGroup::Source::Application, 1, "Upscale");
+        GpuProfiler::Scope scope(profiler, "Upscale");
+
+        // bilinear, the resolve already reconstructed all the detail there is at this size
+        GL::Framebuffer::blit(scaledOutputFramebuffer,
+                              outputFramebuffer,
+                              scaledOutputFramebuffer.viewport(),
+                              outputFramebuffer.viewport(),
+                              GL::FramebufferBlit::Color,
+                              GL::FramebufferBlitFilter::Linear);
+    }
+
+    // housekeeping
+
+    scene.streamingBuffer.endFrame();
+
+    currentFrame = (currentFrame + 1) % _frames;
+    oldMatrices = matrices;
+    oldProjection = unjitteredProjection;
+}
@@ -0,0 +1,143 @@
+#pragma once
+
+#include "Options.h"
+#include "GpuProfiler.h"
+#include "Shaders/ReconstructionShader.h"
+#include "Shaders/ReconstructionOptions.h"
+#include "Shaders/DepthBlitShader.h"
+#include "Shaders/LinearDepthShader.h"
+#include "Shaders/HiZShader.h"
+#include <Magnum/GL/GL.h>
+#include <Magnum/GL/Framebuffer.h>
+#include <Magnum/GL/Texture.h>
+#include <Magnum/GL/MultisampleTexture.h>
+#include <Magnum/GL/TextureArray.h>
+#include <Magnum/GL/Mesh.h>
+#include <Magnum/Math/Matrix4.h>
+#include <Corrade/Containers/StaticArray.h>
+
+class Scene;
+
+// checkerboard rendering pipeline, independent of any windowing
+// each call to draw() renders the velocity pass, the quarter-res scene pass and
+// the checkerboard resolve into outputFramebuffer
+class CheckerboardRenderer
+{
+public:
+    explicit CheckerboardRenderer(Magnum::Vector2i size);
+
+    // Copying is not allowed
+    CheckerboardRenderer(const CheckerboardRenderer&) = delete;
+    CheckerboardRenderer& operator=(const CheckerboardRenderer&) = delete;
+
+    // adjust scene resources for quarter-res rendering
+    void prepareScene(Scene& scene);
+
+    // size is the full-res output size and the largest possible render size
+    void resizeFramebuffers(Magnum::Vector2i size);
+
+    // render a fraction of the output size in each dimension and upscale the resolved result to the output size
+    // the framebuffers keep their size, passes only render to a viewport inside them
+    void setRenderScale(Magnum::Float scale);
+
+    Magnum::Float renderScale() const
+    {
+        return _renderScale;
+    }
+
+    // full-res size the scene is currently rendered and resolved at
+    Magnum::Vector2i renderSize() const
+    {
+        return _renderSize;
+    }
+
+    // frame cycle length, 2 (checkerboard) or 4 (one sample per quarter-res pixel and frame)
+    // a different length discards the previous frames
+    void setFrames(size_t frames);
+
+    size_t frames() const
+    {
+        return _frames;
+    }
+
+    // Options::computeResolve falls back to the fragment shader if this is false
+    bool isComputeResolveSupported() const
+    {
+        return computeResolveSupported;
+    }
+
+    // measure each pass with the given profiler, nullptr disables it
+    // frames have to be started and ended by the caller
+    void setProfiler(GpuProfiler* profiler)
+    {
+        this->profiler = profiler;
+    }
+
+    // render one frame and advance to the next frame in the checkerboard cycle
+    // animation has to be stepped before calling this
+    void draw(Scene& scene, const Options& options);
+
+    // the longest frame cycle is MAX_FRAMES from ReconstructionOptions.h
+    // two-frame cycle only, the four-frame cycle jitters every frame
+    static constexpr size_t JITTERED_FRAME = 1;
+
+    // full-res resolved output
+    Magnum::GL::Framebuffer outputFramebuffer;
+    Magnum::GL::Texture2D outputColorAttachment;
+
+private:
+    void createFrameAttachments();
+    void setSamplePositions();
+    void setViewports();
+    void createScaledOutput();
+
+    // program variant for the given options, compiled on first use
+    ReconstructionShader& reconstructionShader(bool compute, const Options::Reconstruction& options);
+
+    GpuProfiler* profiler = nullptr;
+
+    // framebuffer texture size, always even
+    Magnum::Vector2i size;
+    Magnum::Float _renderScale = 1.0f;
+    Magnum::Vector2i _renderSize;
+
+    // resolve target when rendering below the output size, created on first use
+    Magnum::GL::Framebuffer scaledOutputFramebuffer;
+    Magnum::GL::Texture2D scaledOutputColorAttachment;
+
+    Magnum::GL::Mesh fullscreenTriangle;
+
+    Magnum::GL::Framebuffer velocityFramebuffer;
+    Magnum::GL::Texture2D velocityAttachment;
+    Magnum::GL::Texture2D velocityDepthAttachment;
+
+    // max depth pyramid of the velocity depth for occlusion culling
+    Magnum::GL::Texture2D hiZPyramid;
+
+    size_t _frames = 2;
+    size_t currentFrame = 0;
+    // projection matrices of the last frame cycle
+    Corrade::Containers::StaticArray<MAX_FRAMES, Magnum::Matrix4> oldMatrices;
+    // unjittered projection matrix of the last frame, the four-frame velocity pass isn't jittered
+    Magnum::Matrix4 oldProjection;
+
+    // quarter-size framebuffers (half width, half height), one per frame in the cycle
+    Magnum::GL::Framebuffer framebuffers[MAX_FRAMES];
+    Magnum::GL::MultisampleTexture2DArray colorAttachments;
+    Magnum::GL::MultisampleTexture2DArray depthAttachments;
+
+    // quarter-size linear view space depth, one channel per sample
+    Magnum::GL::Framebuffer linearDepthFramebuffers[MAX_FRAMES];
+    Magnum::GL::Texture2DArray linearDepthAttachments;
+
+    DepthBlitShader depthBlitShader;
+    LinearDepthShader linearDepthShader;
+    HiZShader hiZShader;
+    // flags shared by all resolve variants
+    ReconstructionShader::Flags reconstructionFlags;
+    bool computeResolveSupported = false;
+    // indexed by ReconstructionShader::variantIndex()
+    Corrade::Containers::StaticArray<ReconstructionShader::VariantCount, ReconstructionShader> reconstructionShaders;
+    Corrade::Containers::StaticArray<ReconstructionShader::VariantCount, ReconstructionShader>
+        computeReconstructionShaders;
+};
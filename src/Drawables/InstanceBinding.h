@@ -0,0 +1,24 @@
+#pragma once
+
+#include <Magnum/Magnum.h>
+
+// instance buffer the instanced attributes of a mesh were last set up with
+// shared by all drawables of a mesh, so a drawable only skips the setup if the mesh still points at its buffer
+struct InstanceBinding
+{
+    // StreamingBuffer or GpuInstances owning the buffer, nullptr before the first setup
+    const void* owner = nullptr;
+    // generation of the owner's buffer, changes whenever it's replaced
+    Magnum::UnsignedInt generation = 0;
+
+    bool isBound(const void* owner, Magnum::UnsignedInt generation) const
+    {
+        return this->owner == owner && this->generation == generation;
+    }
+
+    void bind(const void* owner, Magnum::UnsignedInt generation)
+    {
+        this->owner = owner;
+        this->generation = generation;
+    }
+};
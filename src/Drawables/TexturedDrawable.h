@@ -1,20 +1,28 @@
 #pragma once
 
-#include "Drawables/InstanceDrawable.h"
+#include "StreamingBuffer.h"
+#include "InstanceStore.h"
+#include "JobSystem.h"
+#include "GpuInstances.h"
+#include "RenderQueue.h"
+#include "Drawables/VelocityDrawable.h"
+#include "Drawables/InstanceBinding.h"
 #include <Magnum/SceneGraph/Drawable.h>
 #include <Magnum/SceneGraph/AbstractObject.h>
 #include <Magnum/SceneGraph/Camera.h>
 #include <Magnum/Shaders/PhongGL.h>
+#include <Magnum/Shaders/GenericGL.h>
 #include <Magnum/Trade/PhongMaterialData.h>
 #include <Magnum/GL/Mesh.h>
 #include <Magnum/GL/Buffer.h>
 #include <Magnum/GL/Texture.h>
+#include <Magnum/Math/Frustum.h>
+#include <Magnum/Math/Range.h>
 #include <Corrade/Containers/Array.h>
 #include <Corrade/Containers/ArrayView.h>
 #include <Corrade/Containers/GrowableArray.h>
 #include <Corrade/Containers/Pointer.h>
 #include <Corrade/Utility/Assert.h>
-//#include <algorithm>
 
 template<typename Transform>
 class TexturedDrawable : public Magnum::SceneGraph::Drawable3D
@@ -22,20 +30,27 @@ class TexturedDrawable : public Magnum::SceneGraph::Drawable3D
 public:
     typedef Magnum::SceneGraph::AbstractObject<Transform::Dimensions, typename Transform::Type> Object;
 
+    typedef InstanceStore::ColorInstance InstanceData;
+    typedef Corrade::Containers::Array<InstanceData> InstanceArray;
+
     explicit TexturedDrawable(
         Object& object,
         Magnum::Shaders::PhongGL& shader,
         Magnum::UnsignedInt meshId,
+        Magnum::UnsignedInt materialId,
         Magnum::GL::Mesh& mesh,
-        Magnum::GL::Buffer& instanceBuffer,
+        InstanceBinding& binding,
+        StreamingBuffer& streamingBuffer,
         Corrade::Containers::ArrayView<Corrade::Containers::Pointer<Magnum::GL::Texture2D>> textures,
         const Magnum::Trade::PhongMaterialData& material,
         Magnum::Float shininess) :
         Magnum::SceneGraph::Drawable3D(object),
         shader(shader),
         _meshId(meshId),
+        _materialId(materialId),
         _mesh(mesh),
-        instanceBuffer(instanceBuffer),
+        binding(binding),
+        streamingBuffer(streamingBuffer),
         material(material),
         shininess(shininess)
     {
@@ -59,67 +74,161 @@ public:
         return _meshId;
     }
 
-    InstanceDrawable<Transform>& addInstance(Object& object)
+    // drawables with the same material share textures
+    Magnum::UnsignedInt materialId() const
     {
-        // template is required so the compiler knows we don't mean less-than
-        InstanceDrawable<Transform>& instance = object.template addFeature<InstanceDrawable<Transform>>(instanceData);
-        instanceDrawables.add(instance);
-        return instance;
+        return _materialId;
     }
 
-    Magnum::SceneGraph::DrawableGroup3D& instances()
+    Magnum::Shaders::PhongGL& materialShader()
     {
-        return instanceDrawables;
+        return shader;
     }
 
-    static bool isCompatibleMaterial(const Magnum::Trade::PhongMaterialData& material,
-                                     const Magnum::Shaders::PhongGL& shader)
+    // anything to draw in layer this frame, valid after prepareInstances()
+    // transparent instances have color alpha < 1 and are drawn in the transparent layer, the rest in the opaque one
+    // GPU culling results never reach the CPU, all instances of the layer count then
+    bool hasInstances(RenderQueue::Layer layer) const
     {
-        const std::pair<Magnum::Shaders::PhongGL::Flag, Magnum::Trade::MaterialAttribute> combinations[] = {
-            { Magnum::Shaders::PhongGL::Flag::AmbientTexture, Magnum::Trade::MaterialAttribute::AmbientTexture },
-            { Magnum::Shaders::PhongGL::Flag::DiffuseTexture, Magnum::Trade::MaterialAttribute::DiffuseTexture },
-            // TODO make this more generic, this only works for the GLTF test meshes
-            { Magnum::Shaders::PhongGL::Flag::SpecularTexture,
-              Magnum::Trade::MaterialAttribute::SpecularGlossinessTexture },
-            { Magnum::Shaders::PhongGL::Flag::NormalTexture, Magnum::Trade::MaterialAttribute::NormalTexture }
-        };
+        if(useGpuInstances)
+            return layer == RenderQueue::Layer::Opaque ? store.transparentCount() < store.size()
+                                                       : store.transparentCount() > 0;
+        return layer == RenderQueue::Layer::Opaque ? opaqueInstanceCount > 0
+                                                   : instanceData.size() > opaqueInstanceCount;
+    }
 
-        for(const auto& combination : combinations)
+    // by default, there are no instances
+    InstanceStore& instances()
+    {
+        return store;
+    }
+
+    // velocity pass drawables for the instances' InstanceStore::Velocity, nullptr to skip
+    void setVelocityDrawables(VelocityDrawable<Transform>* opaque, VelocityDrawable<Transform>* transparent)
+    {
+        opaqueVelocityDrawable = opaque;
+        transparentVelocityDrawable = transparent;
+    }
+
+    // calculate instance transformations once per frame and pack them for the color and velocity passes
+    // only the visible instances are drawn, see InstanceStore::pack()
+    // transparent instances are sorted back to front, see InstanceStore::drawOrder()
+    void prepareInstances(Magnum::SceneGraph::Camera3D& camera,
+                          Corrade::Containers::ArrayView<const Magnum::UnsignedInt> visible,
+                          JobSystem* jobSystem = nullptr)
+    {
+        if(useGpuInstances)
         {
-            if((shader.flags() & combination.first) && !material.hasAttribute(combination.second))
-                return false;
+            // the store's old transformations are stale
+            useGpuInstances = false;
+            store.resetVelocity();
+            setVelocityGpuInstances(false);
         }
 
-        return true;
+        const Magnum::Matrix4 transformation = camera.cameraMatrix() * object().absoluteTransformationMatrix();
+        store.pack(transformation,
+                   store.drawOrder(transformation, visible, opaqueInstanceCount),
+                   instanceData,
+                   opaqueVelocityDrawable ? &opaqueVelocityDrawable->instances() : nullptr,
+                   transparentVelocityDrawable ? &transparentVelocityDrawable->instances() : nullptr,
+                   jobSystem);
     }
 
-private:
-    virtual void draw(const Magnum::Matrix4& /*transformationMatrix*/, Magnum::SceneGraph::Camera3D& camera) override
+    // cull and pack all instances on the GPU, see GpuInstances
+    // frustum is in view space, bounds are the local mesh bounds
+    void prepareInstancesGpu(Magnum::SceneGraph::Camera3D& camera,
+                             const Magnum::Frustum& frustum,
+                             const Magnum::Range3D& bounds,
+                             InstanceCullingShader& cullingShader)
     {
-        if(instanceDrawables.isEmpty())
-            return;
+        if(!gpuInstances)
+            gpuInstances.emplace();
 
-        /*
-        // sort objects back to front for correct alpha blending
-        // not needed currently since we add instances in our scene in the correct order and the camera position is static
-        std::vector<std::pair<std::reference_wrapper<SceneGraph::Drawable3D>, Matrix4>> drawableTransformations =
-            camera.drawableTransformations(instanceDrawables);
-        
-        std::sort(drawableTransformations.begin(),
-                  drawableTransformations.end(),
-                  [](const std::pair<std::reference_wrapper<SceneGraph::Drawable3D>, Matrix4>& a,
-                     const std::pair<std::reference_wrapper<SceneGraph::Drawable3D>, Matrix4>& b) {
-                      return a.second.translation().z() < b.second.translation().z();
-                  });
-        */
+        if(!useGpuInstances)
+        {
+            // the GPU's old transformations are stale
+            useGpuInstances = true;
+            gpuInstances->reset();
+            setVelocityGpuInstances(true);
+        }
 
+        const Magnum::Matrix4 transformation = camera.cameraMatrix() * object().absoluteTransformationMatrix();
+        gpuInstances->update(store, _mesh, bounds, transformation, frustum, streamingBuffer, cullingShader);
         Corrade::Containers::arrayResize(instanceData, 0);
-        camera.draw(instanceDrawables /*drawableTransformations*/);
+        opaqueInstanceCount = 0;
+    }
 
-        instanceBuffer.setData(instanceData, Magnum::GL::BufferUsage::DynamicDraw);
-        _mesh.setInstanceCount(instanceData.size());
+    // cull the instances packed by prepareInstancesGpu() against a max depth pyramid for the color pass
+    // projection is the one the depth was rendered with
+    void occludeInstancesGpu(const Magnum::Range3D& bounds,
+                             Magnum::GL::Texture2D& hiZ,
+                             const Magnum::Matrix4& projection,
+                             InstanceCullingShader& occlusionShader)
+    {
+        if(useGpuInstances)
+            gpuInstances->occlude(_mesh, bounds, hiZ, projection, streamingBuffer, occlusionShader);
+    }
+
+    // point the mesh's instanced attributes at streamed instance data
+    // the allocation must be aligned to sizeof(InstanceData)
+    // binding keeps track of the buffer the mesh's attributes were last set up with
+    static void bindInstanceBuffer(Magnum::GL::Mesh& mesh,
+                                   const StreamingBuffer& streamingBuffer,
+                                   const StreamingBuffer::Allocation& allocation,
+                                   InstanceBinding& binding)
+    {
+        const bool baseInstance = streamingBuffer.isBaseInstanceSupported();
+        if(!baseInstance || !binding.isBound(&streamingBuffer, allocation.generation))
+        {
+            mesh.addVertexBufferInstanced(*allocation.buffer,
+                                          1, // divisor
+                                          baseInstance ? 0 : allocation.offset,
+                                          Magnum::Shaders::GenericGL3D::TransformationMatrix(),
+                                          Magnum::Shaders::GenericGL3D::NormalMatrix(),
+                                          Magnum::Shaders::GenericGL3D::Color4());
+            binding.bind(&streamingBuffer, allocation.generation);
+        }
 
-        if(ambientTexture || diffuseTexture || specularTexture || normalTexture)
+        if(baseInstance)
+            mesh.setBaseInstance(allocation.offset / sizeof(InstanceData));
+    }
+
+    // draw the instances of one layer, same as drawing through a DrawableGroup without the transformation
+    // calculation and virtual call
+    // bindTextures = false skips binding the material textures, the previous draw must have used the same material
+    void render(Magnum::SceneGraph::Camera3D& camera, RenderQueue::Layer layer, bool bindTextures = true)
+    {
+        if(!hasInstances(layer))
+            return;
+
+        const bool opaque = layer == RenderQueue::Layer::Opaque;
+
+        // instance data comes from prepareInstances() or prepareInstancesGpu()
+        if(useGpuInstances)
+        {
+            if(!binding.isBound(gpuInstances.get(), gpuInstances->generation()))
+            {
+                _mesh.addVertexBufferInstanced(gpuInstances->colorBuffer(),
+                                               1, // divisor
+                                               0,
+                                               Magnum::Shaders::GenericGL3D::TransformationMatrix(),
+                                               Magnum::Shaders::GenericGL3D::NormalMatrix(),
+                                               Magnum::Shaders::GenericGL3D::Color4());
+                binding.bind(gpuInstances.get(), gpuInstances->generation());
+            }
+        }
+        else
+        {
+            // opaque instances come first, see InstanceStore::drawOrder()
+            const Corrade::Containers::ArrayView<const InstanceData> data =
+                opaque ? instanceData.prefix(opaqueInstanceCount)
+                       : instanceData.slice(opaqueInstanceCount, instanceData.size());
+            const StreamingBuffer::Allocation allocation = streamingBuffer.upload(data, sizeof(InstanceData));
+            bindInstanceBuffer(_mesh, streamingBuffer, allocation, binding);
+            _mesh.setInstanceCount(data.size());
+        }
+
+        if(bindTextures && (ambientTexture || diffuseTexture || specularTexture || normalTexture))
             shader.bindTextures(ambientTexture, diffuseTexture, specularTexture, normalTexture);
 
         shader
@@ -135,18 +244,72 @@ private:
             .setSpecularColor({ material.specularColor().rgb(), 0.0f })
             .setProjectionMatrix(camera.projectionMatrix());
 
-        shader.draw(_mesh);
+        // compacted opaque instances or the ordered transparent ones
+        if(useGpuInstances)
+            gpuInstances->draw(
+                shader, _mesh, opaque ? GpuInstances::ColorCommand : GpuInstances::OrderedColorCommand, 1);
+        else
+            shader.draw(_mesh);
+    }
+
+    static bool isCompatibleMaterial(const Magnum::Trade::PhongMaterialData& material,
+                                     const Magnum::Shaders::PhongGL& shader)
+    {
+        const std::pair<Magnum::Shaders::PhongGL::Flag, Magnum::Trade::MaterialAttribute> combinations[] = {
+            { Magnum::Shaders::PhongGL::Flag::AmbientTexture, Magnum::Trade::MaterialAttribute::AmbientTexture },
+            { Magnum::Shaders::PhongGL::Flag::DiffuseTexture, Magnum::Trade::MaterialAttribute::DiffuseTexture },
+            // TODO make this more generic, this only works for the GLTF test meshes
+            { Magnum::Shaders::PhongGL::Flag::SpecularTexture,
+              Magnum::Trade::MaterialAttribute::SpecularGlossinessTexture },
+            { Magnum::Shaders::PhongGL::Flag::NormalTexture, Magnum::Trade::MaterialAttribute::NormalTexture }
+        };
+
+        for(const auto& combination : combinations)
+        {
+            if((shader.flags() & combination.first) && !material.hasAttribute(combination.second))
+                return false;
+        }
+
+        return true;
+    }
+
+private:
+    void setVelocityGpuInstances(bool enabled)
+    {
+        if(opaqueVelocityDrawable)
+            opaqueVelocityDrawable->setGpuInstances(enabled ? gpuInstances.get() : nullptr,
+                                                    GpuInstances::VelocityCommand);
+        if(transparentVelocityDrawable)
+            transparentVelocityDrawable->setGpuInstances(enabled ? gpuInstances.get() : nullptr,
+                                                         GpuInstances::OrderedVelocityCommand);
+    }
+
+    virtual void draw(const Magnum::Matrix4& /*transformationMatrix*/, Magnum::SceneGraph::Camera3D& camera) override
+    {
+        render(camera, RenderQueue::Layer::Opaque);
+        render(camera, RenderQueue::Layer::Transparent);
     }
 
     Magnum::Shaders::PhongGL& shader;
     Magnum::UnsignedInt _meshId;
+    Magnum::UnsignedInt _materialId;
     Magnum::GL::Mesh& _mesh;
-    Magnum::GL::Buffer& instanceBuffer;
+    InstanceBinding& binding;
+    StreamingBuffer& streamingBuffer;
     const Magnum::Trade::PhongMaterialData& material;
     const Magnum::Float shininess;
 
     Magnum::GL::Texture2D *ambientTexture, *diffuseTexture, *specularTexture, *normalTexture;
 
-    Magnum::SceneGraph::DrawableGroup3D instanceDrawables;
-    typename InstanceDrawable<Transform>::InstanceArray instanceData;
+    InstanceStore store;
+    InstanceArray instanceData;
+    // instanceData starts with the opaque instances
+    size_t opaqueInstanceCount = 0;
+
+    VelocityDrawable<Transform>* opaqueVelocityDrawable = nullptr;
+    VelocityDrawable<Transform>* transparentVelocityDrawable = nullptr;
+
+    // created on first use
+    Corrade::Containers::Pointer<GpuInstances> gpuInstances;
+    bool useGpuInstances = false;
 };
@@ -1,28 +1,42 @@
 #pragma once
 
-#include "Drawables/VelocityInstanceDrawable.h"
+#include "StreamingBuffer.h"
+#include "InstanceStore.h"
+#include "GpuInstances.h"
+#include "Drawables/InstanceBinding.h"
 #include "Shaders/VelocityShader.h"
 #include <Magnum/SceneGraph/Drawable.h>
 #include <Magnum/SceneGraph/AbstractObject.h>
 #include <Magnum/SceneGraph/Camera.h>
+#include <Magnum/Math/Matrix4.h>
 #include <Magnum/GL/Mesh.h>
+#include <Magnum/GL/Buffer.h>
+#include <Corrade/Containers/Array.h>
+#include <Corrade/Containers/GrowableArray.h>
 
+// instance data is added by the TexturedDrawable of the same mesh, see Scene::prepareInstances()
 template<typename Transform>
 class VelocityDrawable : public Magnum::SceneGraph::Drawable3D
 {
 public:
     typedef Magnum::SceneGraph::AbstractObject<Transform::Dimensions, typename Transform::Type> Object;
 
+    typedef InstanceStore::VelocityInstance InstanceData;
+
+    typedef Corrade::Containers::Array<InstanceData> InstanceArray;
+
     explicit VelocityDrawable(Object& object,
                               VelocityShader& shader,
                               Magnum::UnsignedInt meshId,
                               Magnum::GL::Mesh& mesh,
-                              Magnum::GL::Buffer& instanceBuffer) :
+                              InstanceBinding& binding,
+                              StreamingBuffer& streamingBuffer) :
         Magnum::SceneGraph::Drawable3D(object),
         shader(shader),
         _meshId(meshId),
         _mesh(mesh),
-        instanceBuffer(instanceBuffer)
+        binding(binding),
+        streamingBuffer(streamingBuffer)
     {
     }
 
@@ -31,39 +45,97 @@ public:
         return _meshId;
     }
 
-    VelocityInstanceDrawable<Transform>& addInstance(Object& object)
+    // anything to draw this frame, valid after the instances were prepared
+    bool hasInstances() const
     {
-        VelocityInstanceDrawable<Transform>& instance =
-            object.template addFeature<VelocityInstanceDrawable<Transform>>(instanceData);
-        instanceDrawables.add(instance);
-        return instance;
+        return gpuInstances || !instanceData.isEmpty();
     }
 
-    Magnum::SceneGraph::DrawableGroup3D& instances()
+    void clearInstances()
     {
-        return instanceDrawables;
+        Corrade::Containers::arrayResize(instanceData, 0);
     }
 
-private:
-    virtual void draw(const Magnum::Matrix4& /* transformationMatrix */, Magnum::SceneGraph::Camera3D& camera) override
+    InstanceArray& instances()
+    {
+        return instanceData;
+    }
+
+    // draw command with the instance data written by the TexturedDrawable's GPU instances
+    // nullptr to draw instances()
+    void setGpuInstances(GpuInstances* instances, Magnum::UnsignedInt command)
+    {
+        gpuInstances = instances;
+        gpuCommand = command;
+    }
+
+    // point the mesh's instanced attributes at streamed instance data
+    // the allocation must be aligned to sizeof(InstanceData)
+    // binding keeps track of the buffer the mesh's attributes were last set up with
+    static void bindInstanceBuffer(Magnum::GL::Mesh& mesh,
+                                   const StreamingBuffer& streamingBuffer,
+                                   const StreamingBuffer::Allocation& allocation,
+                                   InstanceBinding& binding)
+    {
+        const bool baseInstance = streamingBuffer.isBaseInstanceSupported();
+        if(!baseInstance || !binding.isBound(&streamingBuffer, allocation.generation))
+        {
+            mesh.addVertexBufferInstanced(*allocation.buffer,
+                                          1, // divisor
+                                          baseInstance ? 0 : allocation.offset,
+                                          VelocityShader::TransformationMatrix(),
+                                          VelocityShader::OldTransformationMatrix());
+            binding.bind(&streamingBuffer, allocation.generation);
+        }
+
+        if(baseInstance)
+            mesh.setBaseInstance(allocation.offset / sizeof(InstanceData));
+    }
+
+    // same as drawing through a DrawableGroup, without the transformation calculation and virtual call
+    void render()
     {
-        if(instanceDrawables.isEmpty())
+        if(gpuInstances)
+        {
+            // opaque and transparent velocity drawables share the mesh and the buffer
+            if(!binding.isBound(gpuInstances, gpuInstances->generation()))
+            {
+                _mesh.addVertexBufferInstanced(gpuInstances->velocityBuffer(),
+                                               1, // divisor
+                                               0,
+                                               VelocityShader::TransformationMatrix(),
+                                               VelocityShader::OldTransformationMatrix());
+                binding.bind(gpuInstances, gpuInstances->generation());
+            }
+
+            gpuInstances->draw(shader, _mesh, gpuCommand, 1);
             return;
+        }
 
-        Corrade::Containers::arrayResize(instanceData, 0);
-        camera.draw(instanceDrawables);
+        if(instanceData.isEmpty())
+            return;
 
-        instanceBuffer.setData(instanceData, Magnum::GL::BufferUsage::DynamicDraw);
+        const StreamingBuffer::Allocation allocation = streamingBuffer.upload(instanceData, sizeof(InstanceData));
+        bindInstanceBuffer(_mesh, streamingBuffer, allocation, binding);
         _mesh.setInstanceCount(instanceData.size());
 
         shader.draw(_mesh);
     }
 
+private:
+    virtual void draw(const Magnum::Matrix4& /* transformationMatrix */, Magnum::SceneGraph::Camera3D& /* camera */) override
+    {
+        render();
+    }
+
     VelocityShader& shader;
     Magnum::UnsignedInt _meshId;
     Magnum::GL::Mesh& _mesh;
-    Magnum::GL::Buffer& instanceBuffer;
+    InstanceBinding& binding;
+    StreamingBuffer& streamingBuffer;
+
+    InstanceArray instanceData;
 
-    Magnum::SceneGraph::DrawableGroup3D instanceDrawables;
-    typename VelocityInstanceDrawable<Transform>::InstanceArray instanceData;
+    GpuInstances* gpuInstances = nullptr;
+    Magnum::UnsignedInt gpuCommand = 0;
 };
@@ -0,0 +1,71 @@
+#include "DynamicResolution.h"
+
+#include "GpuProfiler.h"
+#include <Magnum/Math/Functions.h>
+
+using namespace Magnum;
+
+namespace
+{
+// exponential moving average weight of the newest frame
+constexpr Double Smoothing = 0.2;
+// frames measured at a new scale before it's changed again
+constexpr size_t MinMeasuredFrames = 4;
+// only scale up if there's this much room left in the budget, otherwise the scale oscillates around the limit
+constexpr Double Headroom = 0.85;
+// largest scale increase at once, scaling down is never limited
+constexpr Float MaxIncrease = 4 * DynamicResolution::ScaleStep;
+} // namespace
+
+Float DynamicResolution::update(const GpuProfiler& profiler, const Options::DynamicResolution& options)
+{
+    const Float minScale = Math::clamp(options.minScale, ScaleStep, 1.0f);
+
+    if(!options.enabled || !profiler.isEnabled())
+    {
+        if(_scale != 1.0f)
+            setScale(1.0f, profiler);
+        return _scale;
+    }
+
+    // add finished frames to the average, oldest first
+    for(size_t i = 0; i < profiler.historyCount(); i++)
+    {
+        const GpuProfiler::FrameResult& result = profiler.historyFrame(i);
+        if(result.frame < scaleFrame || (hasLastFrame && result.frame <= lastFrame))
+            continue;
+
+        // nested passes are already part of their outer pass, excluded ones don't scale with the resolution
+        const Double time = profiler.renderTime(result);
+        _gpuTime = measuredFrames == 0 ? time : Math::lerp(_gpuTime, time, Smoothing);
+        measuredFrames++;
+        lastFrame = result.frame;
+        hasLastFrame = true;
+    }
+
+    Float scale = Math::clamp(_scale, minScale, 1.0f);
+    if(measuredFrames >= MinMeasuredFrames && _gpuTime > 0.0)
+    {
+        const Double budget = Double(options.frameBudget);
+        const Float ideal = _scale * Float(Math::sqrt(budget * Headroom / _gpuTime));
+        if(_gpuTime > budget)
+            scale = Math::min(Math::floor(ideal / ScaleStep) * ScaleStep, _scale - ScaleStep);
+        else if(_gpuTime < budget * Headroom * Headroom)
+            scale = Math::min(Math::floor(ideal / ScaleStep) * ScaleStep, _scale + MaxIncrease);
+        scale = Math::clamp(scale, minScale, 1.0f);
+    }
+
+    if(scale != _scale)
+        setScale(scale, profiler);
+
+    return _scale;
+}
+
+void DynamicResolution::setScale(Float scale, const GpuProfiler& profiler)
+{
+    _scale = scale;
+    // measurements of the old scale don't say anything about the new one
+    _gpuTime = 0.0;
+    measuredFrames = 0;
+    scaleFrame = profiler.currentFrame();
+}
@@ -0,0 +1,43 @@
+#pragma once
+
+#include "Options.h"
+#include <Magnum/Magnum.h>
+
+class GpuProfiler;
+
+// picks the render scale that keeps the measured GPU frame time within Options::DynamicResolution::frameBudget
+// GPU time is assumed to be roughly proportional to the pixel count, so the scale follows sqrt(budget / time).
+// profiler results arrive a few frames late, frames that were rendered before the last scale change are ignored
+class DynamicResolution
+{
+public:
+    // scales are multiples of this to avoid constantly changing the render size (and losing the reprojected frame)
+    static constexpr Magnum::Float ScaleStep = 1.0f / 32.0f;
+
+    // call once per frame after GpuProfiler::beginFrame(), returns the render scale for this frame
+    Magnum::Float update(const GpuProfiler& profiler, const Options::DynamicResolution& options);
+
+    Magnum::Float scale() const
+    {
+        return _scale;
+    }
+
+    // smoothed GPU frame time in milliseconds at the current scale, 0 if nothing was measured yet
+    Magnum::Double gpuTime() const
+    {
+        return _gpuTime;
+    }
+
+private:
+    void setScale(Magnum::Float scale, const GpuProfiler& profiler);
+
+    Magnum::Float _scale = 1.0f;
+    Magnum::Double _gpuTime = 0.0;
+    size_t measuredFrames = 0;
+
+    // first profiler frame rendered at the current scale
+    Magnum::UnsignedLong scaleFrame = 0;
+    // last profiler frame that was added to the average
+    Magnum::UnsignedLong lastFrame = 0;
+    bool hasLastFrame = false;
+};
@@ -0,0 +1,219 @@
+#include "FrameCapture.h"
+
+#include <Magnum/ImageView.h>
+#include <Magnum/PixelFormat.h>
+#include <Magnum/Math/Color.h>
+#include <Magnum/Math/Functions.h>
+#include <Magnum/Trade/AbstractImageConverter.h>
+#include <Corrade/Containers/GrowableArray.h>
+#include <Corrade/Containers/Optional.h>
+#include <Corrade/Containers/Pair.h>
+#include <Corrade/Containers/Pointer.h>
+#include <Corrade/PluginManager/Manager.h>
+#include <Corrade/Utility/Algorithms.h>
+#include <Corrade/Utility/Assert.h>
+#include <Corrade/Utility/Debug.h>
+#include <Corrade/Utility/Format.h>
+#include <Corrade/Utility/Path.h>
+#include <utility>
+
+using namespace Magnum;
+using namespace Corrade;
+using namespace Containers::Literals;
+
+FrameCapture::FrameCapture(Containers::StringView path, const Vector2i& size, Double frameRate) :
+    path(path), size(size), frameRate(frameRate), readback(size)
+{
+    y4m = path.hasSuffix(".y4m"_s);
+    frameSize = size.product() * 4;
+
+    const Containers::StringView directory = Utility::Path::split(path).first();
+    if(!directory.isEmpty() && !Utility::Path::make(directory))
+        Error() << "Can't create capture directory" << directory;
+
+    if(y4m)
+    {
+        stream.open(this->path.data(), std::ios::out | std::ios::binary | std::ios::trunc);
+        if(!stream.good())
+        {
+            Error() << "Can't open" << this->path << "for writing";
+            failed = true;
+        }
+    }
+
+    worker = std::thread(&FrameCapture::encode, this);
+}
+
+FrameCapture::~FrameCapture()
+{
+    finish();
+}
+
+void FrameCapture::capture(GL::Framebuffer& framebuffer)
+{
+    CORRADE_ASSERT(!finished, "FrameCapture::capture(): already finished", );
+
+    // hand off everything that's done, oldest first to keep the order
+    while(retire(false)) { }
+    if(readback.isFull())
+        retire(true);
+
+    readback.read(framebuffer);
+    captured++;
+}
+
+bool FrameCapture::finish()
+{
+    if(!finished)
+    {
+        finished = true;
+
+        while(retire(true)) { }
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            done = true;
+        }
+        condition.notify_all();
+    }
+
+    if(worker.joinable())
+        worker.join();
+
+    return !failed.load();
+}
+
+bool FrameCapture::retire(bool wait)
+{
+    if(!readback.acquire(wait))
+        return false;
+
+    Frame frame;
+    frame.index = readback.frame();
+
+    {
+        // wait for the worker if it's too far behind
+        std::unique_lock<std::mutex> lock(mutex);
+        condition.wait(lock, [this] { return queue.size() < MaxQueuedFrames; });
+        if(!freePixels.isEmpty())
+        {
+            frame.pixels = std::move(freePixels.back());
+            arrayRemoveSuffix(freePixels);
+        }
+    }
+
+    if(frame.pixels.size() != frameSize)
+        frame.pixels = Containers::Array<char>(NoInit, frameSize);
+
+    Utility::copy(readback.pixels(), Containers::arrayView(frame.pixels));
+    readback.release();
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        queue.push_back(std::move(frame));
+    }
+    condition.notify_all();
+
+    return true;
+}
+
+void FrameCapture::encode()
+{
+    // only used on this thread, plugin managers aren't thread-safe
+    PluginManager::Manager<Trade::AbstractImageConverter> manager;
+    Containers::Pointer<Trade::AbstractImageConverter> converter;
+    if(!y4m)
+    {
+        converter = manager.loadAndInstantiate("AnyImageConverter");
+        if(!converter)
+            failed = true;
+    }
+
+    for(;;)
+    {
+        Frame frame;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            condition.wait(lock, [this] { return !queue.empty() || done; });
+            if(queue.empty())
+                return;
+            frame = std::move(queue.front());
+            queue.pop_front();
+        }
+        // capture() might be waiting for room in the queue
+        condition.notify_all();
+
+        if(!failed.load(std::memory_order_relaxed))
+        {
+            if(y4m ? writeY4m(frame) : writeImage(*converter, frame))
+                written.fetch_add(1, std::memory_order_relaxed);
+            else
+                failed = true;
+        }
+
+        std::lock_guard<std::mutex> lock(mutex);
+        arrayAppend(freePixels, std::move(frame.pixels));
+    }
+}
+
+bool FrameCapture::writeImage(Trade::AbstractImageConverter& converter, const Frame& frame)
+{
+    const Containers::Pair<Containers::StringView, Containers::StringView> extension =
+        Utility::Path::splitExtension(path);
+    const Containers::String file =
+        Utility::format("{}{:.6}{}", extension.first(), UnsignedInt(frame.index), extension.second());
+
+    // GL rows are bottom to top, which is what Magnum images expect as well
+    if(extension.second() == ".exr"_s)
+    {
+        // EXR is linear and floating point, the output texture is sRGB-encoded
+        Containers::Array<Color4> linear{ NoInit, std::size_t(size.product()) };
+        const Containers::ArrayView<const Color4ub> pixels =
+            Containers::arrayCast<const Color4ub>(Containers::arrayView(frame.pixels));
+        for(std::size_t i = 0; i < linear.size(); i++)
+            linear[i] = Color4::fromSrgbAlpha(pixels[i]);
+        return converter.convertToFile(ImageView2D{ PixelFormat::RGBA32F, size, Containers::arrayView(linear) }, file);
+    }
+
+    return converter.convertToFile(ImageView2D{ PixelFormat::RGBA8Unorm, size, Containers::arrayView(frame.pixels) },
+                                   file);
+}
+
+bool FrameCapture::writeY4m(const Frame& frame)
+{
+    if(frame.index == 0)
+    {
+        // frame rate as a ratio with millisecond precision
+        stream << Utility::format("YUV4MPEG2 W{} H{} F{}:1000 Ip A1:1 C444\n",
+                                  size.x(),
+                                  size.y(),
+                                  UnsignedInt(Math::round(frameRate * 1000.0)));
+    }
+
+    // planar 4:4:4, BT.601 limited range which is what players assume without any color information
+    const std::size_t planeSize = size.product();
+    if(planes.size() != planeSize * 3)
+        planes = Containers::Array<char>(NoInit, planeSize * 3);
+
+    const Containers::ArrayView<const Color4ub> pixels =
+        Containers::arrayCast<const Color4ub>(Containers::arrayView(frame.pixels));
+    for(Int y = 0; y < size.y(); y++)
+    {
+        // Y4M rows are top to bottom
+        const Color4ub* row = pixels.data() + (size.y() - 1 - y) * size.x();
+        for(Int x = 0; x < size.x(); x++)
+        {
+            const Vector3 rgb = Vector3(row[x].rgb()) / 255.0f;
+            const std::size_t i = y * size.x() + x;
+            planes[i] = char(UnsignedByte(16.0f + Math::dot(rgb, Vector3(65.481f, 128.553f, 24.966f)) + 0.5f));
+            planes[planeSize + i] =
+                char(UnsignedByte(128.0f + Math::dot(rgb, Vector3(-37.797f, -74.203f, 112.0f)) + 0.5f));
+            planes[planeSize * 2 + i] =
+                char(UnsignedByte(128.0f + Math::dot(rgb, Vector3(112.0f, -93.786f, -18.214f)) + 0.5f));
+        }
+    }
+
+    stream << "FRAME\n";
+    stream.write(planes.data(), planes.size());
+    return stream.good();
+}
@@ -0,0 +1,99 @@
+#pragma once
+
+#include "FrameReadback.h"
+#include <Magnum/Magnum.h>
+#include <Magnum/GL/GL.h>
+#include <Magnum/Math/Vector2.h>
+#include <Magnum/Trade/Trade.h>
+#include <Corrade/Containers/Array.h>
+#include <Corrade/Containers/String.h>
+#include <Corrade/Containers/StringView.h>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <fstream>
+#include <mutex>
+#include <thread>
+
+// writes rendered frames to disk without stalling the render thread
+// frames are read back with FrameReadback, a worker thread converts and writes them in order.
+// if the worker falls more than MaxQueuedFrames behind, capture() waits for it.
+class FrameCapture
+{
+public:
+    // frames waiting for the worker
+    static constexpr size_t MaxQueuedFrames = 8;
+
+    // a path ending in .y4m writes a raw 4:4:4 YUV4MPEG2 stream, anything else an image sequence with a
+    // zero-padded frame number inserted before the extension (frame.png -> frame000000.png)
+    // images are converted with AnyImageConverter, the extension picks the format (e.g. .png or .exr)
+    // EXR frames are converted to linear RGBA32F. frameRate is only stored in Y4M streams.
+    explicit FrameCapture(Corrade::Containers::StringView path, const Magnum::Vector2i& size, Magnum::Double frameRate);
+    // calls finish()
+    ~FrameCapture();
+
+    // Copying is not allowed
+    FrameCapture(const FrameCapture&) = delete;
+    FrameCapture& operator=(const FrameCapture&) = delete;
+
+    // Moving is not allowed, the worker references this
+    FrameCapture(FrameCapture&&) = delete;
+    FrameCapture& operator=(FrameCapture&&) = delete;
+
+    // queue a readback of the first color attachment of framebuffer, must be RGBA8 and at least size large
+    void capture(Magnum::GL::Framebuffer& framebuffer);
+
+    // read back all pending frames and wait for the worker to write them
+    // returns false if any frame couldn't be written
+    bool finish();
+
+    size_t capturedFrames() const
+    {
+        return captured;
+    }
+
+    size_t writtenFrames() const
+    {
+        return written.load(std::memory_order_relaxed);
+    }
+
+private:
+    struct Frame
+    {
+        size_t index;
+        Corrade::Containers::Array<char> pixels;
+    };
+
+    // hand the oldest finished readback to the worker, with wait block until it's done
+    bool retire(bool wait);
+
+    void encode();
+    bool writeImage(Magnum::Trade::AbstractImageConverter& converter, const Frame& frame);
+    bool writeY4m(const Frame& frame);
+
+    Corrade::Containers::String path;
+    Magnum::Vector2i size;
+    Magnum::Double frameRate;
+    bool y4m;
+    size_t frameSize;
+
+    FrameReadback readback;
+    size_t captured = 0;
+    bool finished = false;
+
+    std::thread worker;
+    std::mutex mutex;
+    std::condition_variable condition;
+    // guarded by mutex
+    std::deque<Frame> queue;
+    // recycled pixel arrays, saves page faults on multi-megabyte allocations every frame
+    Corrade::Containers::Array<Corrade::Containers::Array<char>> freePixels;
+    bool done = false;
+
+    // worker only
+    std::ofstream stream;
+    Corrade::Containers::Array<char> planes;
+
+    std::atomic<size_t> written { 0 };
+    std::atomic<bool> failed { false };
+};
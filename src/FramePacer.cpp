@@ -0,0 +1,153 @@
+#include "FramePacer.h"
+
+#include "StreamingBuffer.h"
+#include <Magnum/GL/Context.h>
+#include <Magnum/GL/Extensions.h>
+#include <Magnum/Math/Functions.h>
+#include <Corrade/Utility/Assert.h>
+#include <thread>
+
+using namespace Magnum;
+using namespace Corrade;
+
+FramePacer::~FramePacer()
+{
+    destroyFences();
+}
+
+void FramePacer::setup(size_t historySize)
+{
+    CORRADE_ASSERT(historySize > 0, "FramePacer: history can't be 0", );
+
+    destroyFences();
+    pendingStart = pendingCount = 0;
+    hasLastFrameStart = false;
+
+    latencySupported = GL::Context::current().isExtensionSupported<GL::Extensions::ARB::timer_query>();
+    if(latencySupported)
+    {
+        for(PendingFrame& pending : pendingFrames)
+            pending.endQuery = GL::TimeQuery(GL::TimeQuery::Target::Timestamp);
+    }
+
+    history = Containers::Array<FrameResult>(historySize);
+    historyStart = historyCount = 0;
+}
+
+void FramePacer::beginFrame(size_t maxFramesInFlight, Double maxFrameRate)
+{
+    CORRADE_ASSERT(!history.isEmpty(), "FramePacer::beginFrame(): setup() wasn't called", );
+
+    if(maxFrameRate > 0.0)
+        limitFrameRate(maxFrameRate);
+    else
+        hasLastFrameStart = false;
+
+    // finished frames don't count, no matter the limit
+    while(pendingCount > 0 && retire(false)) { }
+
+    const Clock::time_point waitStart = Clock::now();
+    const size_t limit = maxFramesInFlight > 0 ? Math::min(maxFramesInFlight, MaxPendingFrames) : MaxPendingFrames;
+    while(pendingCount >= limit)
+        retire(true);
+    fenceWait = std::chrono::duration<Double, std::milli>(Clock::now() - waitStart).count();
+
+    // current GPU time, this doesn't wait for previous commands to finish
+    if(latencySupported)
+        glGetInteger64v(GL_TIMESTAMP, &submitTime);
+}
+
+void FramePacer::endFrame()
+{
+    CORRADE_INTERNAL_ASSERT(pendingCount < MaxPendingFrames);
+
+    PendingFrame& pending = pendingFrames[(pendingStart + pendingCount) % MaxPendingFrames];
+    pending.submitTime = submitTime;
+    pending.fenceWait = fenceWait;
+    if(latencySupported)
+        pending.endQuery.timestamp();
+    pending.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    pendingCount++;
+}
+
+Double FramePacer::averageLatency() const
+{
+    Double sum = 0.0;
+    for(size_t i = 0; i < historyCount; i++)
+        sum += history[(historyStart + i) % history.size()].latency;
+    return historyCount > 0 ? sum / historyCount : 0.0;
+}
+
+Double FramePacer::averageFenceWait() const
+{
+    Double sum = 0.0;
+    for(size_t i = 0; i < historyCount; i++)
+        sum += history[(historyStart + i) % history.size()].fenceWait;
+    return historyCount > 0 ? sum / historyCount : 0.0;
+}
+
+void FramePacer::limitFrameRate(Double maxFrameRate)
+{
+    const Clock::duration period =
+        std::chrono::duration_cast<Clock::duration>(std::chrono::duration<Double>(1.0 / maxFrameRate));
+
+    if(hasLastFrameStart)
+    {
+        const Clock::time_point target = lastFrameStart + period;
+
+        // sleep() overshoots by up to a scheduler tick, sleep until shortly before the target and spin the rest
+        constexpr std::chrono::milliseconds SpinTime{ 2 };
+        const Clock::time_point now = Clock::now();
+        if(target - now > SpinTime)
+            std::this_thread::sleep_for(target - now - SpinTime);
+        while(Clock::now() < target)
+            std::this_thread::yield();
+
+        // keep a steady rhythm, unless the frame took longer than the period
+        lastFrameStart = Clock::now() - target < period ? target : Clock::now();
+    }
+    else
+    {
+        lastFrameStart = Clock::now();
+        hasLastFrameStart = true;
+    }
+}
+
+bool FramePacer::retire(bool wait)
+{
+    PendingFrame& pending = pendingFrames[pendingStart];
+
+    if(!waitFence(pending.fence, wait))
+        return false;
+
+    // overwrite the oldest frame if the history is full
+    if(historyCount == history.size())
+    {
+        historyStart = (historyStart + 1) % history.size();
+        historyCount--;
+    }
+
+    FrameResult& frame = history[(historyStart + historyCount) % history.size()];
+    historyCount++;
+
+    // the fence came after the query, so its result is available now
+    frame.latency =
+        latencySupported ? Double(Long(pending.endQuery.result<UnsignedLong>()) - pending.submitTime) / 1.0e6 : 0.0;
+    frame.fenceWait = pending.fenceWait;
+
+    pendingStart = (pendingStart + 1) % MaxPendingFrames;
+    pendingCount--;
+    return true;
+}
+
+void FramePacer::destroyFences()
+{
+    for(PendingFrame& pending : pendingFrames)
+    {
+        if(pending.fence)
+        {
+            glDeleteSync(pending.fence);
+            pending.fence = nullptr;
+        }
+    }
+}
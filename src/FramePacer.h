@@ -0,0 +1,94 @@
+#pragma once
+
+#include <Magnum/Magnum.h>
+#include <Magnum/GL/OpenGL.h>
+#include <Magnum/GL/TimeQuery.h>
+#include <Corrade/Containers/Array.h>
+#include <chrono>
+
+// limits the number of frames queued on the GPU and optionally the frame rate
+// every frame ends with a fence, beginFrame() waits for the oldest fences until fewer than
+// maxFramesInFlight frames are pending. fewer frames in flight mean lower latency, but the GPU
+// can run idle while the CPU is working on the next frame.
+// with ARB_timer_query the time from the start of a frame on the CPU until the GPU finished it is measured
+class FramePacer
+{
+public:
+    // frames that are tracked at most, with no limit the oldest ones are dropped from the latency measurement
+    static constexpr size_t MaxPendingFrames = 16;
+
+    explicit FramePacer() = default;
+    ~FramePacer();
+
+    // Copying is not allowed
+    FramePacer(const FramePacer&) = delete;
+    FramePacer& operator=(const FramePacer&) = delete;
+
+    // requires a current GL context
+    // historySize is the number of finished frames the averages are calculated over
+    void setup(size_t historySize);
+
+    // sleep until the frame rate limit allows the next frame, then wait for the GPU until fewer than
+    // maxFramesInFlight frames are pending. 0 disables either limit
+    void beginFrame(size_t maxFramesInFlight, Magnum::Double maxFrameRate);
+    // call after the last command of the frame, including the buffer swap
+    void endFrame();
+
+    // false without ARB_timer_query, the limits work regardless
+    bool isLatencySupported() const
+    {
+        return latencySupported;
+    }
+
+    // frames submitted but not finished by the GPU, as of the last beginFrame()
+    size_t framesInFlight() const
+    {
+        return pendingCount;
+    }
+
+    // averages over the history in milliseconds
+    // CPU frame start to GPU frame end
+    Magnum::Double averageLatency() const;
+    // time beginFrame() blocked on fences, the frame rate limit isn't included
+    Magnum::Double averageFenceWait() const;
+
+private:
+    typedef std::chrono::steady_clock Clock;
+
+    struct PendingFrame
+    {
+        GLsync fence = nullptr;
+        // GPU timestamps of the frame start on the CPU and the frame end on the GPU
+        GLint64 submitTime = 0;
+        Magnum::GL::TimeQuery endQuery{ Magnum::NoCreate };
+        // how long beginFrame() blocked before this frame
+        Magnum::Double fenceWait = 0.0;
+    };
+
+    struct FrameResult
+    {
+        Magnum::Double latency = 0.0;
+        Magnum::Double fenceWait = 0.0;
+    };
+
+    void limitFrameRate(Magnum::Double maxFrameRate);
+    // wait for the oldest pending frame, or only check if it's done
+    bool retire(bool wait);
+    void destroyFences();
+
+    bool latencySupported = false;
+
+    PendingFrame pendingFrames[MaxPendingFrames];
+    size_t pendingStart = 0;
+    size_t pendingCount = 0;
+
+    Clock::time_point lastFrameStart;
+    bool hasLastFrameStart = false;
+    Magnum::Double fenceWait = 0.0;
+    GLint64 submitTime = 0;
+
+    // ring buffer of finished frames
+    Corrade::Containers::Array<FrameResult> history;
+    size_t historyStart = 0;
+    size_t historyCount = 0;
+};
@@ -0,0 +1,103 @@
+#include "FrameReadback.h"
+
+#include "StreamingBuffer.h"
+#include <Magnum/GL/Context.h>
+#include <Magnum/GL/Framebuffer.h>
+#include <Corrade/Utility/Assert.h>
+
+using namespace Magnum;
+using namespace Corrade;
+
+FrameReadback::FrameReadback(const Vector2i& size) : _size(size)
+{
+    CORRADE_ASSERT(size.product() > 0, "FrameReadback: size can't be empty", );
+
+    // RGBA8 rows are always 4-byte aligned, same as the default pack alignment
+    frameSize = size.product() * 4;
+
+    for(GL::Buffer& buffer : buffers)
+    {
+        buffer.setTargetHint(GL::Buffer::TargetHint::PixelPack);
+        buffer.setData({ nullptr, frameSize }, GL::BufferUsage::StreamRead);
+        buffer.setLabel("Frame readback buffer");
+    }
+}
+
+FrameReadback::~FrameReadback()
+{
+    for(GLsync& fence : fences)
+    {
+        if(fence)
+        {
+            glDeleteSync(fence);
+            fence = nullptr;
+        }
+    }
+}
+
+size_t FrameReadback::read(GL::Framebuffer& framebuffer)
+{
+    CORRADE_ASSERT(!isFull(), "FrameReadback::read(): no free buffer", 0);
+    CORRADE_ASSERT((framebuffer.viewport().max() >= _size).all(),
+                   "FrameReadback::read(): framebuffer is smaller than the readback size", 0);
+
+    const size_t slot = (pendingStart + _pendingCount) % BufferCount;
+
+    // Magnum's read() into a BufferImage reallocates the buffer every time, use GL directly
+    GL::Context& context = GL::Context::current();
+    context.resetState(GL::Context::State::EnterExternal);
+
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, framebuffer.id());
+    glReadBuffer(GL_COLOR_ATTACHMENT0);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, buffers[slot].id());
+    glPixelStorei(GL_PACK_ALIGNMENT, 4);
+    glPixelStorei(GL_PACK_ROW_LENGTH, 0);
+    glPixelStorei(GL_PACK_SKIP_ROWS, 0);
+    glPixelStorei(GL_PACK_SKIP_PIXELS, 0);
+    glReadPixels(0, 0, _size.x(), _size.y(), GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, 0);
+
+    context.resetState(GL::Context::State::ExitExternal);
+
+    fences[slot] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    _pendingCount++;
+    return readCount++;
+}
+
+bool FrameReadback::acquire(bool wait)
+{
+    CORRADE_ASSERT(!mapped, "FrameReadback::acquire(): previous frame wasn't released", false);
+    if(_pendingCount == 0)
+        return false;
+
+    if(!waitFence(fences[pendingStart], wait))
+        return false;
+
+    // the copy is done, mapping doesn't stall anymore
+    mapped = buffers[pendingStart].map(0, frameSize, GL::Buffer::MapFlag::Read);
+    CORRADE_INTERNAL_ASSERT(mapped);
+    return true;
+}
+
+Containers::ArrayView<const char> FrameReadback::pixels() const
+{
+    CORRADE_ASSERT(mapped, "FrameReadback::pixels(): no frame acquired", {});
+    return { mapped, frameSize };
+}
+
+size_t FrameReadback::frame() const
+{
+    CORRADE_ASSERT(mapped, "FrameReadback::frame(): no frame acquired", 0);
+    return readCount - _pendingCount;
+}
+
+void FrameReadback::release()
+{
+    CORRADE_ASSERT(mapped, "FrameReadback::release(): no frame acquired", );
+    buffers[pendingStart].unmap();
+    mapped = nullptr;
+
+    pendingStart = (pendingStart + 1) % BufferCount;
+    _pendingCount--;
+}
@@ -0,0 +1,65 @@
+#pragma once
+
+#include <Magnum/Magnum.h>
+#include <Magnum/GL/Buffer.h>
+#include <Magnum/GL/GL.h>
+#include <Magnum/GL/OpenGL.h>
+#include <Magnum/Math/Vector2.h>
+#include <Corrade/Containers/ArrayView.h>
+
+// reads back RGBA8 frames without stalling
+// each frame is copied into one of a ring of pixel pack buffers and followed by a fence, a buffer is only
+// mapped once its fence signaled. by then the GPU has long finished the copy.
+// rows are bottom to top and 4-byte aligned (= tightly packed)
+class FrameReadback
+{
+public:
+    // readbacks in flight, enough to cover the GPU running a few frames behind
+    static constexpr size_t BufferCount = 4;
+
+    explicit FrameReadback(const Magnum::Vector2i& size);
+    ~FrameReadback();
+
+    // Copying is not allowed
+    FrameReadback(const FrameReadback&) = delete;
+    FrameReadback& operator=(const FrameReadback&) = delete;
+
+    Magnum::Vector2i size() const
+    {
+        return _size;
+    }
+
+    size_t pendingCount() const
+    {
+        return _pendingCount;
+    }
+
+    bool isFull() const
+    {
+        return _pendingCount == BufferCount;
+    }
+
+    // queue a readback of the first color attachment of framebuffer, must be RGBA8 and at least size() large
+    // there has to be a free buffer, acquire() and release() the oldest one if isFull()
+    // returns the frame index passed to acquire() later, counting from 0
+    size_t read(Magnum::GL::Framebuffer& framebuffer);
+
+    // map the oldest pending frame if it's done, with wait block until it is
+    // on success pixels() and frame() are valid until release()
+    bool acquire(bool wait);
+    Corrade::Containers::ArrayView<const char> pixels() const;
+    size_t frame() const;
+    void release();
+
+private:
+    Magnum::Vector2i _size;
+    size_t frameSize;
+
+    Magnum::GL::Buffer buffers[BufferCount];
+    GLsync fences[BufferCount] = {};
+    size_t pendingStart = 0;
+    size_t _pendingCount = 0;
+    size_t readCount = 0;
+
+    const char* mapped = nullptr;
+};
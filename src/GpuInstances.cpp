@@ -0,0 +1,243 @@
+#include "GpuInstances.h"
+
+#include "Shaders/InstanceCullingShader.h"
+#include <Magnum/GL/Context.h>
+#include <Magnum/GL/Renderer.h>
+#include <Magnum/GL/OpenGL.h>
+#include <Corrade/Containers/Array.h>
+#include <Corrade/Containers/ArrayView.h>
+#include <Corrade/Containers/GrowableArray.h>
+#include <Corrade/Utility/Assert.h>
+
+using namespace Magnum;
+using namespace Corrade;
+
+namespace
+{
+
+// same as InstanceCullingShader.comp
+enum : UnsignedInt
+{
+    VelocityOpaque = 1,
+    VelocityTransparent = 2,
+    Ordered = 4
+};
+
+// std430 layout of the color output, 29 floats
+static_assert(sizeof(InstanceStore::ColorInstance) == 29 * sizeof(Float), "unexpected ColorInstance layout");
+static_assert(sizeof(InstanceStore::VelocityInstance) == 2 * sizeof(Matrix4), "unexpected VelocityInstance layout");
+
+}
+
+GpuInstances::GpuInstances(NoCreateT) :
+    staticInstances(NoCreate),
+    oldTransformations(NoCreate),
+    colorOutput(NoCreate),
+    velocityOutput(NoCreate),
+    commands(NoCreate),
+    orderedInstances(NoCreate)
+{
+}
+
+GpuInstances::GpuInstances()
+{
+    staticInstances.setLabel("GPU instances: static data");
+    oldTransformations.setLabel("GPU instances: old transformations");
+    colorOutput.setLabel("GPU instances: color output");
+    velocityOutput.setLabel("GPU instances: velocity output");
+    commands.setLabel("GPU instances: draw commands");
+    orderedInstances.setLabel("GPU instances: ordered instances");
+
+    commands.setData({ nullptr, CommandCount * sizeof(DrawElementsIndirectCommand) }, GL::BufferUsage::DynamicDraw);
+}
+
+void GpuInstances::allocate(const InstanceStore& store)
+{
+    const size_t count = store.size();
+    Containers::Array<StaticInstance> data(NoInit, count);
+
+    // assign output slots
+    // compacted instances only need space for the worst case of all of them being visible
+
+    UnsignedInt colorCount = 0;
+    UnsignedInt velocityCount = 0;
+    orderedColorCount = orderedVelocityCount = 0;
+    Containers::Array<UnsignedInt> orderedColorInstances;
+    Containers::Array<UnsignedInt> orderedVelocityInstances;
+    for(size_t i = 0; i < count; i++)
+    {
+        StaticInstance& instance = data[i];
+        instance.color = store.colors()[i];
+        instance.flags = 0;
+        instance.colorSlot = 0;
+        instance.velocitySlot = 0;
+        instance.padding = 0;
+
+        if(instance.color.a() < 1.0f)
+        {
+            instance.flags |= Ordered;
+            instance.colorSlot = orderedColorCount++;
+            Containers::arrayAppend(orderedColorInstances, UnsignedInt(i));
+        }
+        else
+            colorCount++;
+
+        const InstanceStore::Velocity velocity = store.velocities()[i];
+        if(velocity == InstanceStore::Velocity::Opaque)
+        {
+            instance.flags |= VelocityOpaque;
+            velocityCount++;
+        }
+        else if(velocity == InstanceStore::Velocity::Transparent)
+        {
+            instance.flags |= VelocityTransparent;
+            instance.velocitySlot = orderedVelocityCount++;
+            Containers::arrayAppend(orderedVelocityInstances, UnsignedInt(i));
+        }
+    }
+
+    orderedColorOffset = colorCount;
+    orderedVelocityOffset = velocityCount;
+
+    // zero-sized buffers can't be bound
+    const size_t colorSize = Math::max<size_t>(colorCount + orderedColorCount, 1);
+    const size_t velocitySize = Math::max<size_t>(velocityCount + orderedVelocityCount, 1);
+
+    // the shader sorts each ordered instance by comparing it to the others of the same range
+    Containers::Array<UnsignedInt> ordered;
+    Containers::arrayAppend(ordered, orderedColorInstances);
+    Containers::arrayAppend(ordered, orderedVelocityInstances);
+    // zero-sized buffers can't be bound
+    if(ordered.isEmpty())
+        Containers::arrayAppend(ordered, 0u);
+
+    staticInstances.setData(data, GL::BufferUsage::StaticDraw);
+    orderedInstances.setData(ordered, GL::BufferUsage::StaticDraw);
+    oldTransformations.setData({ nullptr, Math::max<size_t>(count, 1) * sizeof(Matrix4) }, GL::BufferUsage::DynamicCopy);
+    colorOutput.setData({ nullptr, colorSize * sizeof(InstanceStore::ColorInstance) }, GL::BufferUsage::DynamicCopy);
+    velocityOutput.setData({ nullptr, velocitySize * sizeof(InstanceStore::VelocityInstance) },
+                           GL::BufferUsage::DynamicCopy);
+
+    capacity = count;
+    hasOldTransformations = false;
+    _generation++;
+}
+
+void GpuInstances::update(const InstanceStore& store,
+                          GL::Mesh& mesh,
+                          const Range3D& bounds,
+                          const Matrix4& parentTransformation,
+                          const Frustum& frustum,
+                          StreamingBuffer& streamingBuffer,
+                          InstanceCullingShader& shader)
+{
+    // colors and velocity types are only uploaded when instances are added
+    if(_generation == 0 || store.size() != capacity)
+        allocate(store);
+
+    // reset instance counts of the compacted draws
+    const UnsignedInt count = UnsignedInt(mesh.count());
+    const Int baseVertex = mesh.baseVertex();
+    const DrawElementsIndirectCommand data[CommandCount] = {
+        { count, 0, 0, baseVertex, 0 },
+        { count, orderedColorCount, 0, baseVertex, orderedColorOffset },
+        { count, 0, 0, baseVertex, 0 },
+        { count, orderedVelocityCount, 0, baseVertex, orderedVelocityOffset }
+    };
+    commands.setSubData(0, Containers::arrayView(data));
+
+    transformationCount = UnsignedInt(store.size());
+    this->parentTransformation = parentTransformation;
+    this->frustum = frustum;
+
+    if(store.isEmpty())
+        return;
+
+    transformations = streamingBuffer.upload(store.transformations(), GL::Buffer::shaderStorageOffsetAlignment());
+    bindBuffers();
+
+    shader.setParentTransformation(parentTransformation)
+        .setFrustum(frustum)
+        .setBounds(bounds)
+        .setOrderedOffsets(orderedColorOffset, orderedVelocityOffset)
+        .setOrderedCounts(orderedColorCount, orderedVelocityCount)
+        .setHasOldTransformations(hasOldTransformations)
+        .dispatch(UnsignedInt(store.size()));
+
+    hasOldTransformations = true;
+
+    // outputs are read as vertex attributes and draw commands, old transformations by the next dispatch
+    GL::Renderer::setMemoryBarrier(GL::Renderer::MemoryBarrier::VertexAttributeArray |
+                                   GL::Renderer::MemoryBarrier::Command |
+                                   GL::Renderer::MemoryBarrier::ShaderStorage);
+}
+
+void GpuInstances::occlude(GL::Mesh& mesh,
+                           const Range3D& bounds,
+                           GL::Texture2D& hiZ,
+                           const Matrix4& projection,
+                           const StreamingBuffer& streamingBuffer,
+                           InstanceCullingShader& shader)
+{
+    CORRADE_ASSERT(shader.flags() & InstanceCullingShader::Flag::Occlusion,
+                   "GpuInstances::occlude(): shader requires Flag::Occlusion", );
+
+    // the transformations are gone, keep the frustum culled instances
+    if(transformationCount == 0 || transformations.generation != streamingBuffer.currentGeneration())
+        return;
+
+    // repack from scratch, ordered slots are all overwritten
+    const DrawElementsIndirectCommand command = { UnsignedInt(mesh.count()), 0, 0, mesh.baseVertex(), 0 };
+    commands.setSubData(ColorCommand * sizeof(DrawElementsIndirectCommand), { &command, 1 });
+
+    bindBuffers();
+
+    shader.setParentTransformation(parentTransformation)
+        .setFrustum(frustum)
+        .setBounds(bounds)
+        .setOrderedOffsets(orderedColorOffset, orderedVelocityOffset)
+        .setOrderedCounts(orderedColorCount, orderedVelocityCount)
+        .bindHiZ(hiZ)
+        .setProjectionMatrix(projection)
+        .dispatch(transformationCount);
+
+    GL::Renderer::setMemoryBarrier(GL::Renderer::MemoryBarrier::VertexAttributeArray |
+                                   GL::Renderer::MemoryBarrier::Command);
+}
+
+void GpuInstances::bindBuffers()
+{
+    transformations.buffer->bind(GL::Buffer::Target::ShaderStorage,
+                                 InstanceCullingShader::TransformationBuffer,
+                                 transformations.offset,
+                                 transformationCount * sizeof(Matrix4));
+    staticInstances.bind(GL::Buffer::Target::ShaderStorage, InstanceCullingShader::StaticInstanceBuffer);
+    oldTransformations.bind(GL::Buffer::Target::ShaderStorage, InstanceCullingShader::OldTransformationBuffer);
+    colorOutput.bind(GL::Buffer::Target::ShaderStorage, InstanceCullingShader::ColorOutputBuffer);
+    velocityOutput.bind(GL::Buffer::Target::ShaderStorage, InstanceCullingShader::VelocityOutputBuffer);
+    commands.bind(GL::Buffer::Target::ShaderStorage, InstanceCullingShader::CommandBuffer);
+    orderedInstances.bind(GL::Buffer::Target::ShaderStorage, InstanceCullingShader::OrderedInstanceBuffer);
+}
+
+void GpuInstances::draw(GL::AbstractShaderProgram& shader, GL::Mesh& mesh, UnsignedInt first, UnsignedInt count)
+{
+    CORRADE_ASSERT(first + count <= CommandCount, "GpuInstances::draw(): command out of range", );
+
+    // Magnum has no indirect draws, use GL directly
+    // the shader's uniforms and textures, and the mesh's attributes are already set up
+    GL::Context& context = GL::Context::current();
+    context.resetState(GL::Context::State::EnterExternal);
+
+    glUseProgram(shader.id());
+    glBindVertexArray(mesh.id());
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, commands.id());
+    glMultiDrawElementsIndirect(GLenum(mesh.primitive()),
+                                GLenum(mesh.indexType()),
+                                reinterpret_cast<const void*>(first * sizeof(DrawElementsIndirectCommand)),
+                                count,
+                                0 /* tightly packed */);
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+    glBindVertexArray(0);
+
+    context.resetState(GL::Context::State::ExitExternal);
+}
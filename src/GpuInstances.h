@@ -0,0 +1,144 @@
+#pragma once
+
+#include "InstanceStore.h"
+#include "StreamingBuffer.h"
+#include <Magnum/Magnum.h>
+#include <Magnum/GL/Buffer.h>
+#include <Magnum/GL/Mesh.h>
+#include <Magnum/GL/AbstractShaderProgram.h>
+#include <Magnum/Math/Matrix4.h>
+#include <Magnum/Math/Range.h>
+#include <Magnum/Math/Frustum.h>
+
+class InstanceCullingShader;
+
+// GPU-driven culling and drawing of the instances of one mesh
+// static instance data and last frame's transformations live on the GPU, only the instance transformations
+// are streamed every frame. a compute pass culls the instances and writes the instance data for
+// the color and velocity passes together with the draw commands, so CPU cost doesn't depend on instance count.
+// opaque instances are compacted, ordered ones (color alpha < 1 or transparent velocity) are sorted back to front
+// in a separate range after them so alpha blending still works
+class GpuInstances
+{
+public:
+    // draw commands, one multi-draw of Color + OrderedColor draws all instances of the color pass
+    enum Command : Magnum::UnsignedInt
+    {
+        ColorCommand = 0,
+        OrderedColorCommand,
+        VelocityCommand,
+        OrderedVelocityCommand,
+        CommandCount
+    };
+
+    explicit GpuInstances(Magnum::NoCreateT);
+    explicit GpuInstances();
+
+    // Copying is not allowed
+    GpuInstances(const GpuInstances&) = delete;
+    GpuInstances& operator=(const GpuInstances&) = delete;
+
+    GpuInstances(GpuInstances&&) noexcept = default;
+    GpuInstances& operator=(GpuInstances&&) noexcept = default;
+
+    // instance data for the instanced Shaders::GenericGL3D attributes (see InstanceStore::ColorInstance)
+    Magnum::GL::Buffer& colorBuffer()
+    {
+        return colorOutput;
+    }
+
+    // instance data for the instanced VelocityShader attributes (see InstanceStore::VelocityInstance)
+    Magnum::GL::Buffer& velocityBuffer()
+    {
+        return velocityOutput;
+    }
+
+    // changes whenever the output buffers are replaced, instanced attributes have to be set up again
+    Magnum::UnsignedInt generation() const
+    {
+        return _generation;
+    }
+
+    // forget last frame's transformations, the next update() outputs no velocity
+    void reset()
+    {
+        hasOldTransformations = false;
+    }
+
+    // cull and pack all instances of store on the GPU
+    // parentTransformation is the camera-relative transformation of the object the instances are relative to
+    // frustum is in view space, bounds are the local mesh bounds
+    void update(const InstanceStore& store,
+                Magnum::GL::Mesh& mesh,
+                const Magnum::Range3D& bounds,
+                const Magnum::Matrix4& parentTransformation,
+                const Magnum::Frustum& frustum,
+                StreamingBuffer& streamingBuffer,
+                InstanceCullingShader& shader);
+
+    // cull the color instances packed by update() against a max depth pyramid, see HiZShader
+    // projection is the one the depth was rendered with
+    // must be called in the same frame as update(), shader needs InstanceCullingShader::Flag::Occlusion
+    // does nothing if the streaming buffer was replaced since then
+    void occlude(Magnum::GL::Mesh& mesh,
+                 const Magnum::Range3D& bounds,
+                 Magnum::GL::Texture2D& hiZ,
+                 const Magnum::Matrix4& projection,
+                 const StreamingBuffer& streamingBuffer,
+                 InstanceCullingShader& shader);
+
+    // draw the commands [first, first + count) with glMultiDrawElementsIndirect
+    // the shader must be set up and the mesh's instanced attributes must point to the matching output buffer
+    void draw(Magnum::GL::AbstractShaderProgram& shader,
+              Magnum::GL::Mesh& mesh,
+              Magnum::UnsignedInt first,
+              Magnum::UnsignedInt count);
+
+private:
+    struct StaticInstance
+    {
+        Magnum::Color4 color;
+        Magnum::UnsignedInt flags;
+        Magnum::UnsignedInt colorSlot;
+        Magnum::UnsignedInt velocitySlot;
+        Magnum::UnsignedInt padding;
+    };
+
+    // layout defined by GL
+    struct DrawElementsIndirectCommand
+    {
+        Magnum::UnsignedInt count;
+        Magnum::UnsignedInt instanceCount;
+        Magnum::UnsignedInt firstIndex;
+        Magnum::Int baseVertex;
+        Magnum::UnsignedInt baseInstance;
+    };
+
+    void allocate(const InstanceStore& store);
+    void bindBuffers();
+
+    Magnum::GL::Buffer staticInstances;
+    Magnum::GL::Buffer oldTransformations;
+    Magnum::GL::Buffer colorOutput;
+    Magnum::GL::Buffer velocityOutput;
+    Magnum::GL::Buffer commands;
+    // instance index of each ordered color slot, then of each ordered velocity slot
+    Magnum::GL::Buffer orderedInstances;
+
+    size_t capacity = 0;
+    // ordered instances are stored after the compacted ones
+    Magnum::UnsignedInt orderedColorOffset = 0;
+    Magnum::UnsignedInt orderedColorCount = 0;
+    Magnum::UnsignedInt orderedVelocityOffset = 0;
+    Magnum::UnsignedInt orderedVelocityCount = 0;
+
+    bool hasOldTransformations = false;
+
+    // streamed transformations, parent transformation and frustum from the last update(), reused by occlude()
+    // the occlusion pass repacks from scratch, so it has to frustum cull again
+    StreamingBuffer::Allocation transformations;
+    Magnum::UnsignedInt transformationCount = 0;
+    Magnum::Matrix4 parentTransformation;
+    Magnum::Frustum frustum;
+    Magnum::UnsignedInt _generation = 0;
+};
@@ -0,0 +1,266 @@
+#include "GpuProfiler.h"
+
+#include <Magnum/GL/Context.h>
+#include <Magnum/GL/Extensions.h>
+#include <Corrade/Utility/Assert.h>
+#include <Corrade/Utility/Debug.h>
+#include <cstring>
+
+using namespace Magnum;
+using namespace Corrade;
+
+GpuProfiler::Scope::Scope(GpuProfiler* profiler, const char* name) :
+    profiler(profiler && profiler->inFrame ? profiler : nullptr), pass(MaxPasses)
+{
+    if(this->profiler)
+    {
+        pass = this->profiler->passIndex(name);
+        if(pass < MaxPasses)
+            this->profiler->beginPass(pass);
+    }
+}
+
+GpuProfiler::Scope::~Scope()
+{
+    if(profiler && pass < MaxPasses)
+        profiler->endPass(pass);
+}
+
+void GpuProfiler::setup(size_t historySize, size_t maxPendingFrames)
+{
+    CORRADE_ASSERT(historySize > 0 && maxPendingFrames > 0, "GpuProfiler: history and pending frames can't be 0", );
+
+    enabled = GL::Context::current().isExtensionSupported<GL::Extensions::ARB::timer_query>();
+    if(!enabled)
+    {
+        Warning() << "GpuProfiler: ARB_timer_query is not supported, per-pass timings are disabled";
+        return;
+    }
+
+    inFrame = false;
+    frameCounter = 0;
+    _passCount = 0;
+    openPasses = 0;
+    _droppedFrames = 0;
+
+    // queries are created on first use
+    pendingFrames = Containers::Array<PendingFrame>(maxPendingFrames);
+    for(PendingFrame& pending : pendingFrames)
+        pending.queries = Containers::Array<GL::TimeQuery>(DirectInit, MaxPasses * 2, NoCreate);
+    pendingStart = pendingCount = 0;
+
+    history = Containers::Array<FrameResult>(historySize);
+    historyStart = _historyCount = 0;
+}
+
+void GpuProfiler::beginFrame()
+{
+    if(!enabled)
+        return;
+
+    CORRADE_ASSERT(!inFrame, "GpuProfiler::beginFrame(): frame already started", );
+
+    poll(false);
+
+    // GPU is too far behind, give up on the oldest frame instead of stalling
+    if(pendingCount == pendingFrames.size())
+    {
+        pendingStart = (pendingStart + 1) % pendingFrames.size();
+        pendingCount--;
+        _droppedFrames++;
+    }
+
+    PendingFrame& pending = pendingFrames[(pendingStart + pendingCount) % pendingFrames.size()];
+    pending.frame = frameCounter;
+    for(bool& used : pending.used)
+        used = false;
+
+    inFrame = true;
+}
+
+void GpuProfiler::endFrame()
+{
+    if(!enabled)
+        return;
+
+    CORRADE_ASSERT(inFrame, "GpuProfiler::endFrame(): no frame started", );
+
+    pendingCount++;
+    frameCounter++;
+    inFrame = false;
+}
+
+void GpuProfiler::flush()
+{
+    if(!enabled)
+        return;
+
+    CORRADE_ASSERT(!inFrame, "GpuProfiler::flush(): can't flush in the middle of a frame", );
+
+    poll(true);
+}
+
+Double GpuProfiler::average(size_t pass) const
+{
+    CORRADE_ASSERT(pass < _passCount, "GpuProfiler::average(): pass index out of range", 0.0);
+
+    Double sum = 0.0;
+    size_t count = 0;
+    for(size_t i = 0; i < _historyCount; i++)
+    {
+        const Double duration = historyFrame(i).durations[pass];
+        if(duration >= 0.0)
+        {
+            sum += duration;
+            count++;
+        }
+    }
+    return count > 0 ? sum / count : 0.0;
+}
+
+void GpuProfiler::excludeFromRenderTime(const char* name)
+{
+    if(!enabled)
+        return;
+
+    const size_t pass = passIndex(name);
+    if(pass < MaxPasses)
+        excluded[pass] = true;
+}
+
+Double GpuProfiler::renderTime(const FrameResult& result) const
+{
+    Double time = 0.0;
+    for(size_t pass = 0; pass < _passCount; pass++)
+    {
+        if(result.durations[pass] >= 0.0 && !nested[pass] && !excluded[pass])
+            time += result.durations[pass];
+    }
+    return time;
+}
+
+const GpuProfiler::FrameResult& GpuProfiler::historyFrame(size_t i) const
+{
+    CORRADE_ASSERT(i < _historyCount, "GpuProfiler::historyFrame(): index out of range", history[0]);
+    return history[(historyStart + i) % history.size()];
+}
+
+void GpuProfiler::writeCsv(std::ostream& out) const
+{
+    out << "frame";
+    for(size_t pass = 0; pass < _passCount; pass++)
+        out << "," << passNames[pass];
+    out << "\n";
+
+    for(size_t i = 0; i < _historyCount; i++)
+    {
+        const FrameResult& result = historyFrame(i);
+        out << result.frame;
+        for(size_t pass = 0; pass < _passCount; pass++)
+        {
+            out << ",";
+            if(result.durations[pass] >= 0.0)
+                out << result.durations[pass];
+        }
+        out << "\n";
+    }
+}
+
+size_t GpuProfiler::passIndex(const char* name)
+{
+    for(size_t i = 0; i < _passCount; i++)
+    {
+        if(passNames[i] == name || std::strcmp(passNames[i], name) == 0)
+            return i;
+    }
+
+    if(_passCount == MaxPasses)
+    {
+        Warning() << "GpuProfiler: too many passes, ignoring" << name;
+        return MaxPasses;
+    }
+
+    passNames[_passCount] = name;
+    nested[_passCount] = false;
+    excluded[_passCount] = false;
+    return _passCount++;
+}
+
+void GpuProfiler::beginPass(size_t pass)
+{
+    PendingFrame& pending = pendingFrames[(pendingStart + pendingCount) % pendingFrames.size()];
+    GL::TimeQuery& query = pending.queries[pass * 2];
+    if(!query.id())
+        query = GL::TimeQuery(GL::TimeQuery::Target::Timestamp);
+    query.timestamp();
+    pending.used[pass] = true;
+
+    // passes always run in the same place, so this only has to be noticed once
+    if(openPasses > 0)
+        nested[pass] = true;
+    openPasses++;
+}
+
+void GpuProfiler::endPass(size_t pass)
+{
+    PendingFrame& pending = pendingFrames[(pendingStart + pendingCount) % pendingFrames.size()];
+    GL::TimeQuery& query = pending.queries[pass * 2 + 1];
+    if(!query.id())
+        query = GL::TimeQuery(GL::TimeQuery::Target::Timestamp);
+    query.timestamp();
+
+    openPasses--;
+}
+
+void GpuProfiler::poll(bool wait)
+{
+    while(pendingCount > 0)
+    {
+        PendingFrame& pending = pendingFrames[pendingStart];
+
+        if(!wait)
+        {
+            // results usually arrive in submission order, so we can stop at the first unfinished frame
+            bool available = true;
+            for(size_t pass = 0; pass < _passCount && available; pass++)
+            {
+                if(pending.used[pass])
+                    available = pending.queries[pass * 2 + 1].resultAvailable() &&
+                                pending.queries[pass * 2].resultAvailable();
+            }
+            if(!available)
+                break;
+        }
+
+        readResults(pending);
+
+        pendingStart = (pendingStart + 1) % pendingFrames.size();
+        pendingCount--;
+    }
+}
+
+void GpuProfiler::readResults(PendingFrame& pending)
+{
+    // overwrite the oldest frame if the history is full
+    if(_historyCount == history.size())
+    {
+        historyStart = (historyStart + 1) % history.size();
+        _historyCount--;
+    }
+
+    FrameResult& result = history[(historyStart + _historyCount) % history.size()];
+    _historyCount++;
+
+    result.frame = pending.frame;
+    for(size_t pass = 0; pass < MaxPasses; pass++)
+    {
+        if(pass < _passCount && pending.used[pass])
+        {
+            const UnsignedLong begin = pending.queries[pass * 2].result<UnsignedLong>();
+            const UnsignedLong end = pending.queries[pass * 2 + 1].result<UnsignedLong>();
+            result.durations[pass] = Double(end - begin) / 1.0e6;
+        }
+        else
+            result.durations[pass] = -1.0;
+    }
+}
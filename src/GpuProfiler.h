@@ -0,0 +1,150 @@
+#pragma once
+
+#include <Magnum/Magnum.h>
+#include <Magnum/GL/TimeQuery.h>
+#include <Corrade/Containers/Array.h>
+#include <ostream>
+
+// per-pass GPU timings using timestamp queries
+// results are polled at the start of each frame and only read once they're available,
+// so the CPU never waits for the GPU. frames that are still pending when
+// maxPendingFrames is exceeded are dropped.
+class GpuProfiler
+{
+public:
+    static constexpr size_t MaxPasses = 16;
+
+    // durations of a finished frame in milliseconds, negative if the pass didn't run
+    struct FrameResult
+    {
+        Magnum::UnsignedLong frame = 0;
+        Magnum::Double durations[MaxPasses];
+    };
+
+    // measures GPU time between construction and destruction
+    // each pass name should only be used once per frame, scopes can be nested
+    class Scope
+    {
+    public:
+        // profiler can be nullptr to skip measuring
+        explicit Scope(GpuProfiler* profiler, const char* name);
+        ~Scope();
+
+        Scope(const Scope&) = delete;
+        Scope& operator=(const Scope&) = delete;
+
+    private:
+        GpuProfiler* profiler;
+        size_t pass;
+    };
+
+    explicit GpuProfiler() = default;
+
+    // Copying is not allowed
+    GpuProfiler(const GpuProfiler&) = delete;
+    GpuProfiler& operator=(const GpuProfiler&) = delete;
+
+    // requires a current GL context
+    // historySize is the number of finished frames kept for averages and dumps
+    void setup(size_t historySize, size_t maxPendingFrames = 8);
+
+    // false if timer queries are not supported or setup() wasn't called
+    bool isEnabled() const
+    {
+        return enabled;
+    }
+
+    void beginFrame();
+    void endFrame();
+
+    // FrameResult::frame of the frame that's being recorded, or the next one outside of beginFrame()/endFrame()
+    Magnum::UnsignedLong currentFrame() const
+    {
+        return frameCounter;
+    }
+
+    // wait for all pending frames and read back their results
+    // this stalls, use it only when you're done rendering
+    void flush();
+
+    size_t passCount() const
+    {
+        return _passCount;
+    }
+
+    const char* passName(size_t pass) const
+    {
+        return passNames[pass];
+    }
+
+    // pass ran inside another pass, its duration is already part of the outer one
+    bool isNested(size_t pass) const
+    {
+        return nested[pass];
+    }
+
+    // don't count a pass towards renderTime(), e.g. UI that doesn't change with the render resolution
+    // call after setup()
+    void excludeFromRenderTime(const char* name);
+
+    // sum of all passes of a finished frame that aren't nested or excluded, in milliseconds
+    Magnum::Double renderTime(const FrameResult& result) const;
+
+    // average duration over the frame history in milliseconds
+    Magnum::Double average(size_t pass) const;
+
+    // finished frames, oldest first
+    size_t historyCount() const
+    {
+        return _historyCount;
+    }
+
+    const FrameResult& historyFrame(size_t i) const;
+
+    size_t droppedFrames() const
+    {
+        return _droppedFrames;
+    }
+
+    // one line per frame in the history, one column per pass
+    void writeCsv(std::ostream& out) const;
+
+private:
+    struct PendingFrame
+    {
+        Magnum::UnsignedLong frame = 0;
+        // begin and end timestamp for each pass
+        Corrade::Containers::Array<Magnum::GL::TimeQuery> queries;
+        bool used[MaxPasses];
+    };
+
+    size_t passIndex(const char* name);
+    void beginPass(size_t pass);
+    void endPass(size_t pass);
+
+    void poll(bool wait);
+    void readResults(PendingFrame& pending);
+
+    bool enabled = false;
+    bool inFrame = false;
+    Magnum::UnsignedLong frameCounter = 0;
+
+    const char* passNames[MaxPasses];
+    bool nested[MaxPasses];
+    bool excluded[MaxPasses];
+    size_t _passCount = 0;
+    // passes that began but didn't end yet in the current frame
+    size_t openPasses = 0;
+
+    // ring buffer of frames that were submitted, but not read back yet
+    Corrade::Containers::Array<PendingFrame> pendingFrames;
+    size_t pendingStart = 0;
+    size_t pendingCount = 0;
+
+    // ring buffer of finished frames
+    Corrade::Containers::Array<FrameResult> history;
+    size_t historyStart = 0;
+    size_t _historyCount = 0;
+
+    size_t _droppedFrames = 0;
+};
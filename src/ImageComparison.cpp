@@ -0,0 +1,397 @@
+#include "ImageComparison.h"
+
+#include "JobSystem.h"
+#include <Magnum/Math/Functions.h>
+#include <Corrade/Utility/Assert.h>
+#include <cmath>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define MOSAIIKKI_SSE2
+#include <emmintrin.h>
+#endif
+
+using namespace Magnum;
+using namespace Corrade;
+
+namespace
+{
+
+// SSIM window radius, 7x7 like scikit-image's default
+constexpr Int Radius = 3;
+constexpr Float WindowSize = (2 * Radius + 1) * (2 * Radius + 1);
+// stabilizing constants for a dynamic range of 1
+constexpr Float C1 = 0.01f * 0.01f;
+constexpr Float C2 = 0.03f * 0.03f;
+
+// FLIP color error remapping: errors are raised to qc, compressed above pc * max to the range [pt, 1]
+constexpr Float ColorExponent = 0.7f;
+constexpr Float ColorCutoff = 0.4f;
+constexpr Float ColorCutoffError = 0.95f;
+
+// rows per job
+constexpr size_t GrainSize = 16;
+
+struct Lab
+{
+    Float l, a, b;
+};
+
+Float labF(Float t)
+{
+    return t > 0.008856f ? std::cbrt(t) : 7.787f * t + 16.0f / 116.0f;
+}
+
+// linear sRGB to L*a*b* (D65 white point) with a and b scaled by 0.01 * L (Hunt effect, as in FLIP)
+Lab huntLab(Float r, Float g, Float b)
+{
+    const Float x = (0.4124f * r + 0.3576f * g + 0.1805f * b) / 0.9505f;
+    const Float y = 0.2126f * r + 0.7152f * g + 0.0722f * b;
+    const Float z = (0.0193f * r + 0.1192f * g + 0.9505f * b) / 1.0890f;
+    const Float fx = labF(x);
+    const Float fy = labF(y);
+    const Float fz = labF(z);
+    const Float l = 116.0f * fy - 16.0f;
+    return { l, 0.01f * l * 500.0f * (fx - fy), 0.01f * l * 200.0f * (fy - fz) };
+}
+
+Float hyab(const Lab& first, const Lab& second)
+{
+    const Float da = first.a - second.a;
+    const Float db = first.b - second.b;
+    return std::abs(first.l - second.l) + std::sqrt(da * da + db * db);
+}
+
+// BT.601 luma of sRGB-encoded values, what SSIM is usually computed on
+Float luma(const UnsignedByte* pixel)
+{
+    return (0.299f * pixel[0] + 0.587f * pixel[1] + 0.114f * pixel[2]) * (1.0f / 255.0f);
+}
+
+// window sums of x, y, x^2, y^2 and x * y
+Float ssim(Float sx, Float sy, Float sxx, Float syy, Float sxy)
+{
+    const Float mx = sx / WindowSize;
+    const Float my = sy / WindowSize;
+    const Float vx = sxx / WindowSize - mx * mx;
+    const Float vy = syy / WindowSize - my * my;
+    const Float cov = sxy / WindowSize - mx * my;
+    return ((2.0f * mx * my + C1) * (2.0f * cov + C2)) / ((mx * mx + my * my + C1) * (vx + vy + C2));
+}
+
+// Sobel gradient magnitude of three rows around x, scaled to [0, sqrt(2)] for values in [0, 1]
+Float edge(const Float* above, const Float* row, const Float* below, Int x)
+{
+    const Float gx =
+        (above[x + 1] + 2.0f * row[x + 1] + below[x + 1]) - (above[x - 1] + 2.0f * row[x - 1] + below[x - 1]);
+    const Float gy =
+        (below[x - 1] + 2.0f * below[x] + below[x + 1]) - (above[x - 1] + 2.0f * above[x] + above[x + 1]);
+    return 0.25f * std::sqrt(gx * gx + gy * gy);
+}
+
+// FLIP's feature difference, the edge strength difference normalized to [0, 1] and raised to qf = 0.5
+Float feature(Float imageEdge, Float referenceEdge)
+{
+    return std::sqrt(std::abs(imageEdge - referenceEdge) * (1.0f / Math::sqrt(2.0f)));
+}
+
+#ifdef MOSAIIKKI_SSE2
+__m128 edge4(const Float* above, const Float* row, const Float* below, Int x)
+{
+    const __m128 two4 = _mm_set1_ps(2.0f);
+    const __m128 aboveLeft = _mm_loadu_ps(above + x - 1);
+    const __m128 aboveRight = _mm_loadu_ps(above + x + 1);
+    const __m128 belowLeft = _mm_loadu_ps(below + x - 1);
+    const __m128 belowRight = _mm_loadu_ps(below + x + 1);
+
+    const __m128 gx = _mm_sub_ps(
+        _mm_add_ps(_mm_add_ps(aboveRight, belowRight), _mm_mul_ps(two4, _mm_loadu_ps(row + x + 1))),
+        _mm_add_ps(_mm_add_ps(aboveLeft, belowLeft), _mm_mul_ps(two4, _mm_loadu_ps(row + x - 1))));
+    const __m128 gy = _mm_sub_ps(
+        _mm_add_ps(_mm_add_ps(belowLeft, belowRight), _mm_mul_ps(two4, _mm_loadu_ps(below + x))),
+        _mm_add_ps(_mm_add_ps(aboveLeft, aboveRight), _mm_mul_ps(two4, _mm_loadu_ps(above + x))));
+    return _mm_mul_ps(_mm_set1_ps(0.25f), _mm_sqrt_ps(_mm_add_ps(_mm_mul_ps(gx, gx), _mm_mul_ps(gy, gy))));
+}
+
+Float horizontalSum(__m128 value)
+{
+    Float lanes[4];
+    _mm_storeu_ps(lanes, value);
+    return (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+}
+#endif
+
+}
+
+ImageComparison::ImageComparison(const Vector2i& size, JobSystem* jobSystem) : _size(size), jobSystem(jobSystem)
+{
+    CORRADE_ASSERT((size > Vector2i(2 * Radius)).all(), "ImageComparison: size must be larger than the SSIM window", );
+
+    for(Int i = 0; i < 256; i++)
+    {
+        const Float value = i / 255.0f;
+        linear[i] = value <= 0.04045f ? value / 12.92f : std::pow((value + 0.055f) / 1.055f, 2.4f);
+    }
+    maxColorError = std::pow(hyab(huntLab(0.0f, 1.0f, 0.0f), huntLab(0.0f, 0.0f, 1.0f)), ColorExponent);
+
+    const size_t pixels = size.product();
+    imageLuma = Containers::Array<Float>(NoInit, pixels);
+    referenceLuma = Containers::Array<Float>(NoInit, pixels);
+    colorError = Containers::Array<Float>(NoInit, pixels);
+
+    // border rows are never written
+    rowSquaredError = Containers::Array<UnsignedLong>(ValueInit, size.y());
+    rowSsim = Containers::Array<Double>(ValueInit, size.y());
+    rowFlip = Containers::Array<Double>(ValueInit, size.y());
+}
+
+ImageComparison::Result ImageComparison::compare(Containers::ArrayView<const char> image,
+                                                 Containers::ArrayView<const char> reference)
+{
+    const size_t pixels = _size.product();
+    CORRADE_ASSERT(image.size() == pixels * 4 && reference.size() == pixels * 4,
+                   "ImageComparison::compare(): expected" << pixels * 4 << "bytes per image", {});
+
+    // per-pixel terms first, the windows of the second pass need neighboring rows
+    const size_t rows = _size.y();
+    const size_t interiorRows = rows - 2 * Radius;
+    if(jobSystem)
+    {
+        jobSystem->parallelFor(rows, GrainSize, [&](size_t begin, size_t end) {
+            convertRows(image.data(), reference.data(), begin, end);
+        });
+        jobSystem->parallelFor(interiorRows, GrainSize, [&](size_t begin, size_t end) {
+            compareRows(begin + Radius, end + Radius);
+        });
+    }
+    else
+    {
+        convertRows(image.data(), reference.data(), 0, rows);
+        compareRows(Radius, Radius + interiorRows);
+    }
+
+    UnsignedLong squaredError = 0;
+    Double ssimSum = 0.0;
+    Double flipSum = 0.0;
+    for(size_t y = 0; y < rows; y++)
+    {
+        squaredError += rowSquaredError[y];
+        ssimSum += rowSsim[y];
+        flipSum += rowFlip[y];
+    }
+
+    Result result;
+    const Double meanSquaredError = Double(squaredError) / (Double(pixels) * 3.0 * 255.0 * 255.0);
+    result.psnr = meanSquaredError > 0.0 ? Math::min(-10.0 * std::log10(meanSquaredError), MaxPsnr) : MaxPsnr;
+    const Double interiorPixels = Double(_size.x() - 2 * Radius) * Double(interiorRows);
+    result.ssim = ssimSum / interiorPixels;
+    result.flip = flipSum / interiorPixels;
+    return result;
+}
+
+void ImageComparison::convertRows(const char* image, const char* reference, size_t begin, size_t end)
+{
+    const Int width = _size.x();
+    const Float cutoff = ColorCutoff * maxColorError;
+
+    for(size_t y = begin; y < end; y++)
+    {
+        const UnsignedByte* imageRow = reinterpret_cast<const UnsignedByte*>(image) + y * width * 4;
+        const UnsignedByte* referenceRow = reinterpret_cast<const UnsignedByte*>(reference) + y * width * 4;
+        Float* imageLumaRow = imageLuma.data() + y * width;
+        Float* referenceLumaRow = referenceLuma.data() + y * width;
+        Float* colorErrorRow = colorError.data() + y * width;
+
+        UnsignedLong squaredError = 0;
+        for(Int x = 0; x < width; x++)
+        {
+            const UnsignedByte* p = imageRow + x * 4;
+            const UnsignedByte* q = referenceRow + x * 4;
+
+            const Int dr = Int(p[0]) - Int(q[0]);
+            const Int dg = Int(p[1]) - Int(q[1]);
+            const Int db = Int(p[2]) - Int(q[2]);
+            squaredError += UnsignedLong(dr * dr + dg * dg + db * db);
+
+            imageLumaRow[x] = luma(p);
+            referenceLumaRow[x] = luma(q);
+
+            // most pixels match exactly in static parts of the image, skip the color conversion for those
+            if((dr | dg | db) == 0)
+            {
+                colorErrorRow[x] = 0.0f;
+                continue;
+            }
+
+            const Float error = std::pow(hyab(huntLab(linear[p[0]], linear[p[1]], linear[p[2]]),
+                                              huntLab(linear[q[0]], linear[q[1]], linear[q[2]])),
+                                         ColorExponent);
+            colorErrorRow[x] =
+                error < cutoff ? error * (ColorCutoffError / cutoff)
+                               : Math::min(ColorCutoffError + (error - cutoff) / (maxColorError - cutoff) *
+                                                                  (1.0f - ColorCutoffError),
+                                           1.0f);
+        }
+        rowSquaredError[y] = squaredError;
+    }
+}
+
+void ImageComparison::compareRows(size_t begin, size_t end)
+{
+    const Int width = _size.x();
+
+    // column sums of the SSIM window for the current row, then the feature term
+    Containers::Array<Float> scratch(NoInit, width * 6);
+    Float* sx = scratch.data();
+    Float* sy = sx + width;
+    Float* sxx = sy + width;
+    Float* syy = sxx + width;
+    Float* sxy = syy + width;
+    Float* features = sxy + width;
+
+    for(size_t y = begin; y < end; y++)
+    {
+        const Float* imageWindow = imageLuma.data() + (y - Radius) * width;
+        const Float* referenceWindow = referenceLuma.data() + (y - Radius) * width;
+
+        // vertical sums
+
+        Int x = 0;
+#ifdef MOSAIIKKI_SSE2
+        for(; x + 4 <= width; x += 4)
+        {
+            __m128 sx4 = _mm_setzero_ps();
+            __m128 sy4 = _mm_setzero_ps();
+            __m128 sxx4 = _mm_setzero_ps();
+            __m128 syy4 = _mm_setzero_ps();
+            __m128 sxy4 = _mm_setzero_ps();
+            for(Int row = 0; row <= 2 * Radius; row++)
+            {
+                const __m128 a = _mm_loadu_ps(imageWindow + row * width + x);
+                const __m128 b = _mm_loadu_ps(referenceWindow + row * width + x);
+                sx4 = _mm_add_ps(sx4, a);
+                sy4 = _mm_add_ps(sy4, b);
+                sxx4 = _mm_add_ps(sxx4, _mm_mul_ps(a, a));
+                syy4 = _mm_add_ps(syy4, _mm_mul_ps(b, b));
+                sxy4 = _mm_add_ps(sxy4, _mm_mul_ps(a, b));
+            }
+            _mm_storeu_ps(sx + x, sx4);
+            _mm_storeu_ps(sy + x, sy4);
+            _mm_storeu_ps(sxx + x, sxx4);
+            _mm_storeu_ps(syy + x, syy4);
+            _mm_storeu_ps(sxy + x, sxy4);
+        }
+#endif
+        for(; x < width; x++)
+        {
+            sx[x] = sy[x] = sxx[x] = syy[x] = sxy[x] = 0.0f;
+            for(Int row = 0; row <= 2 * Radius; row++)
+            {
+                const Float a = imageWindow[row * width + x];
+                const Float b = referenceWindow[row * width + x];
+                sx[x] += a;
+                sy[x] += b;
+                sxx[x] += a * a;
+                syy[x] += b * b;
+                sxy[x] += a * b;
+            }
+        }
+
+        // horizontal sums and SSIM
+
+        Double ssimSum = 0.0;
+        x = Radius;
+#ifdef MOSAIIKKI_SSE2
+        {
+            const __m128 inverseWindow4 = _mm_set1_ps(1.0f / WindowSize);
+            const __m128 c14 = _mm_set1_ps(C1);
+            const __m128 c24 = _mm_set1_ps(C2);
+            const __m128 two4 = _mm_set1_ps(2.0f);
+            __m128 ssim4 = _mm_setzero_ps();
+            for(; x + 4 <= width - Radius; x += 4)
+            {
+                __m128 sx4 = _mm_setzero_ps();
+                __m128 sy4 = _mm_setzero_ps();
+                __m128 sxx4 = _mm_setzero_ps();
+                __m128 syy4 = _mm_setzero_ps();
+                __m128 sxy4 = _mm_setzero_ps();
+                for(Int offset = -Radius; offset <= Radius; offset++)
+                {
+                    sx4 = _mm_add_ps(sx4, _mm_loadu_ps(sx + x + offset));
+                    sy4 = _mm_add_ps(sy4, _mm_loadu_ps(sy + x + offset));
+                    sxx4 = _mm_add_ps(sxx4, _mm_loadu_ps(sxx + x + offset));
+                    syy4 = _mm_add_ps(syy4, _mm_loadu_ps(syy + x + offset));
+                    sxy4 = _mm_add_ps(sxy4, _mm_loadu_ps(sxy + x + offset));
+                }
+
+                const __m128 mx = _mm_mul_ps(sx4, inverseWindow4);
+                const __m128 my = _mm_mul_ps(sy4, inverseWindow4);
+                const __m128 mxx = _mm_mul_ps(mx, mx);
+                const __m128 myy = _mm_mul_ps(my, my);
+                const __m128 mxy = _mm_mul_ps(mx, my);
+                const __m128 vx = _mm_sub_ps(_mm_mul_ps(sxx4, inverseWindow4), mxx);
+                const __m128 vy = _mm_sub_ps(_mm_mul_ps(syy4, inverseWindow4), myy);
+                const __m128 cov = _mm_sub_ps(_mm_mul_ps(sxy4, inverseWindow4), mxy);
+
+                const __m128 numerator =
+                    _mm_mul_ps(_mm_add_ps(_mm_mul_ps(two4, mxy), c14), _mm_add_ps(_mm_mul_ps(two4, cov), c24));
+                const __m128 denominator =
+                    _mm_mul_ps(_mm_add_ps(_mm_add_ps(mxx, myy), c14), _mm_add_ps(_mm_add_ps(vx, vy), c24));
+                ssim4 = _mm_add_ps(ssim4, _mm_div_ps(numerator, denominator));
+            }
+            ssimSum += horizontalSum(ssim4);
+        }
+#endif
+        for(; x < width - Radius; x++)
+        {
+            Float wx = 0.0f, wy = 0.0f, wxx = 0.0f, wyy = 0.0f, wxy = 0.0f;
+            for(Int offset = -Radius; offset <= Radius; offset++)
+            {
+                wx += sx[x + offset];
+                wy += sy[x + offset];
+                wxx += sxx[x + offset];
+                wyy += syy[x + offset];
+                wxy += sxy[x + offset];
+            }
+            ssimSum += ssim(wx, wy, wxx, wyy, wxy);
+        }
+        rowSsim[y] = ssimSum;
+
+        // feature term
+
+        const Float* imageAbove = imageLuma.data() + (y - 1) * width;
+        const Float* imageRow = imageAbove + width;
+        const Float* imageBelow = imageRow + width;
+        const Float* referenceAbove = referenceLuma.data() + (y - 1) * width;
+        const Float* referenceRow = referenceAbove + width;
+        const Float* referenceBelow = referenceRow + width;
+
+        x = Radius;
+#ifdef MOSAIIKKI_SSE2
+        {
+            const __m128 signMask4 = _mm_set1_ps(-0.0f);
+            const __m128 normalize4 = _mm_set1_ps(1.0f / Math::sqrt(2.0f));
+            for(; x + 4 <= width - Radius; x += 4)
+            {
+                const __m128 difference = _mm_sub_ps(edge4(imageAbove, imageRow, imageBelow, x),
+                                                     edge4(referenceAbove, referenceRow, referenceBelow, x));
+                _mm_storeu_ps(features + x,
+                              _mm_sqrt_ps(_mm_mul_ps(_mm_andnot_ps(signMask4, difference), normalize4)));
+            }
+        }
+#endif
+        for(; x < width - Radius; x++)
+            features[x] = feature(edge(imageAbove, imageRow, imageBelow, x),
+                                  edge(referenceAbove, referenceRow, referenceBelow, x));
+
+        // FLIP combines both as color^(1 - feature), SSE2 has no pow
+        // identical pixels have no error, pow(0, 0) would count them as the maximum for features of 1
+        const Float* colorErrorRow = colorError.data() + y * width;
+        Double flipSum = 0.0;
+        for(x = Radius; x < width - Radius; x++)
+        {
+            if(colorErrorRow[x] > 0.0f)
+                flipSum += std::pow(colorErrorRow[x], 1.0f - features[x]);
+        }
+        rowFlip[y] = flipSum;
+    }
+}
@@ -0,0 +1,69 @@
+#pragma once
+
+#include <Magnum/Magnum.h>
+#include <Magnum/Math/Vector2.h>
+#include <Corrade/Containers/Array.h>
+#include <Corrade/Containers/ArrayView.h>
+
+class JobSystem;
+
+// full-reference image quality metrics of RGBA8 frames (e.g. from FrameReadback) against a reference frame
+// - PSNR over the sRGB-encoded RGB channels
+// - SSIM of luma with 7x7 box windows
+// - a simplified FLIP: HyAB color difference in Hunt-adjusted L*a*b* with FLIP's error remapping,
+//   weighted by the difference in edge strength. there's no contrast sensitivity prefilter and no point detector,
+//   so values aren't comparable to the reference implementation, only between runs of this one
+// SSIM and FLIP skip a 3 pixel border. rows are processed in parallel, the kernels use SSE2 if available
+class ImageComparison
+{
+public:
+    struct Result
+    {
+        // dB, MaxPsnr for identical images
+        Magnum::Double psnr = 0.0;
+        // mean over all windows, 1 = identical
+        Magnum::Double ssim = 0.0;
+        // mean over all pixels, 0 = identical, 1 = maximum error
+        Magnum::Double flip = 0.0;
+    };
+
+    static constexpr Magnum::Double MaxPsnr = 100.0;
+
+    // jobSystem is optional, without it compare() runs on the calling thread only
+    explicit ImageComparison(const Magnum::Vector2i& size, JobSystem* jobSystem = nullptr);
+
+    // Copying is not allowed
+    ImageComparison(const ImageComparison&) = delete;
+    ImageComparison& operator=(const ImageComparison&) = delete;
+
+    Magnum::Vector2i size() const
+    {
+        return _size;
+    }
+
+    // both are tightly packed RGBA8 with the same row order, alpha is ignored
+    Result compare(Corrade::Containers::ArrayView<const char> image,
+                   Corrade::Containers::ArrayView<const char> reference);
+
+private:
+    void convertRows(const char* image, const char* reference, size_t begin, size_t end);
+    void compareRows(size_t begin, size_t end);
+
+    Magnum::Vector2i _size;
+    JobSystem* jobSystem;
+
+    // sRGB-encoded value to linear
+    Magnum::Float linear[256];
+    // FLIP color error of green vs. blue, the largest one between two colors
+    Magnum::Float maxColorError;
+
+    // one value per pixel
+    Corrade::Containers::Array<Magnum::Float> imageLuma;
+    Corrade::Containers::Array<Magnum::Float> referenceLuma;
+    Corrade::Containers::Array<Magnum::Float> colorError;
+
+    // one sum per row, added up in order so the results don't depend on the thread count
+    Corrade::Containers::Array<Magnum::UnsignedLong> rowSquaredError;
+    Corrade::Containers::Array<Magnum::Double> rowSsim;
+    Corrade::Containers::Array<Magnum::Double> rowFlip;
+};
@@ -0,0 +1,156 @@
+#include "InstanceStore.h"
+
+#include "JobSystem.h"
+#include "RadixSort.h"
+
+#include <Magnum/Math/Vector4.h>
+#include <Corrade/Containers/GrowableArray.h>
+#include <cstring>
+
+using namespace Magnum;
+using namespace Corrade;
+
+namespace
+{
+
+// unsigned integer with the same order as the float
+UnsignedInt sortableBits(Float value)
+{
+    UnsignedInt bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    return (bits & 0x80000000u) ? ~bits : bits | 0x80000000u;
+}
+
+}
+
+void InstanceStore::reserve(size_t capacity)
+{
+    Containers::arrayReserve(_transformations, capacity);
+    Containers::arrayReserve(_colors, capacity);
+    Containers::arrayReserve(_velocities, capacity);
+    Containers::arrayReserve(indices, capacity);
+    Containers::arrayReserve(oldTransformations, capacity);
+    Containers::arrayReserve(packedIn, capacity);
+}
+
+size_t InstanceStore::add(const Matrix4& transformation, const Color4& color, Velocity velocity)
+{
+    Containers::arrayAppend(_transformations, transformation);
+    Containers::arrayAppend(_colors, color);
+    Containers::arrayAppend(_velocities, velocity);
+    Containers::arrayAppend(indices, UnsignedInt(indices.size()));
+    Containers::arrayAppend(oldTransformations, Matrix4 { Math::IdentityInit });
+    Containers::arrayAppend(packedIn, 0u);
+    if(color.a() < 1.0f)
+        _transparentCount++;
+    return _transformations.size() - 1;
+}
+
+Containers::ArrayView<const UnsignedInt> InstanceStore::drawOrder(const Matrix4& parentTransformation,
+                                                                  Containers::ArrayView<const UnsignedInt> instances,
+                                                                  size_t& opaqueCount)
+{
+    opaqueCount = instances.size();
+    if(_transparentCount == 0)
+        return instances;
+
+    // growable arrays keep their capacity when shrinking, so this only allocates when the instance count grows
+    Containers::arrayResize(orderedInstances, NoInit, instances.size());
+    Containers::arrayResize(depthKeys, NoInit, instances.size());
+
+    // only view space z is needed
+    const Vector4 zRow = parentTransformation.row(2);
+
+    opaqueCount = 0;
+    size_t transparentCount = 0;
+    for(const UnsignedInt instance : instances)
+    {
+        if(_colors[instance].a() < 1.0f)
+        {
+            const Float z = Math::dot(zRow, Vector4(_transformations[instance].translation(), 1.0f));
+            // camera looks down -z, ascending z is back to front
+            depthKeys[transparentCount++] = { sortableBits(z), instance };
+        }
+        else
+            orderedInstances[opaqueCount++] = instance;
+    }
+
+    Containers::arrayResize(depthKeyScratch, NoInit, transparentCount);
+    radixSort(depthKeys.prefix(transparentCount), Containers::arrayView(depthKeyScratch), [](const DepthKey& key) {
+        return key.key;
+    });
+
+    for(size_t i = 0; i < transparentCount; i++)
+        orderedInstances[opaqueCount + i] = depthKeys[i].instance;
+
+    return orderedInstances;
+}
+
+void InstanceStore::pack(const Matrix4& parentTransformation,
+                         Containers::ArrayView<const UnsignedInt> instances,
+                         Containers::Array<ColorInstance>& colorData,
+                         Containers::Array<VelocityInstance>* opaqueVelocityData,
+                         Containers::Array<VelocityInstance>* transparentVelocityData,
+                         JobSystem* jobSystem)
+{
+    packCount++;
+
+    Containers::arrayResize(colorData, NoInit, instances.size());
+
+    // velocity data is compacted, count the instances first so every instance knows where to write
+    Containers::arrayResize(velocitySlots, NoInit, instances.size());
+    UnsignedInt opaqueCount = 0;
+    UnsignedInt transparentCount = 0;
+    for(size_t i = 0; i < instances.size(); i++)
+    {
+        const Velocity velocity = _velocities[instances[i]];
+        if(velocity == Velocity::Opaque)
+            velocitySlots[i] = opaqueCount++;
+        else if(velocity == Velocity::Transparent)
+            velocitySlots[i] = transparentCount++;
+    }
+
+    VelocityInstance* opaqueOutput = nullptr;
+    VelocityInstance* transparentOutput = nullptr;
+    if(opaqueVelocityData)
+    {
+        const size_t offset = opaqueVelocityData->size();
+        Containers::arrayResize(*opaqueVelocityData, NoInit, offset + opaqueCount);
+        opaqueOutput = opaqueVelocityData->data() + offset;
+    }
+    if(transparentVelocityData)
+    {
+        const size_t offset = transparentVelocityData->size();
+        Containers::arrayResize(*transparentVelocityData, NoInit, offset + transparentCount);
+        transparentOutput = transparentVelocityData->data() + offset;
+    }
+
+    auto packRange = [&](size_t begin, size_t end) {
+        for(size_t i = begin; i < end; i++)
+        {
+            const UnsignedInt instance = instances[i];
+            const Matrix4 transformation = parentTransformation * _transformations[instance];
+            colorData[i] = { transformation, transformation.normalMatrix(), _colors[instance] };
+
+            // no velocity on the first frame or if the instance wasn't packed (e.g. culled) last time
+            if(packedIn[instance] + 1 != packCount)
+                oldTransformations[instance] = transformation;
+
+            VelocityInstance* velocityOutput = nullptr;
+            if(_velocities[instance] == Velocity::Opaque)
+                velocityOutput = opaqueOutput;
+            else if(_velocities[instance] == Velocity::Transparent)
+                velocityOutput = transparentOutput;
+            if(velocityOutput)
+                velocityOutput[velocitySlots[i]] = { transformation, oldTransformations[instance] };
+
+            oldTransformations[instance] = transformation;
+            packedIn[instance] = packCount;
+        }
+    };
+
+    if(jobSystem)
+        jobSystem->parallelFor(instances.size(), GrainSize, packRange);
+    else
+        packRange(0, instances.size());
+}
@@ -0,0 +1,144 @@
+#pragma once
+
+#include <Magnum/Magnum.h>
+#include <Magnum/Math/Matrix4.h>
+#include <Magnum/Math/Matrix3.h>
+#include <Magnum/Math/Color.h>
+#include <Corrade/Containers/Array.h>
+#include <Corrade/Containers/ArrayView.h>
+
+class JobSystem;
+
+// structure-of-arrays storage for all instances of one mesh
+// replaces one scene graph object + features per instance, so adding and updating 100k+ instances is cheap
+// transformations are relative to the object of the owning drawable
+class InstanceStore
+{
+public:
+    // which velocity pass an instance is drawn in
+    enum class Velocity : Magnum::UnsignedByte
+    {
+        None,
+        Opaque,
+        // transparent instances don't write depth, see CheckerboardRenderer::draw()
+        Transparent
+    };
+
+    // instance data as the color and velocity shaders expect it
+    struct ColorInstance
+    {
+        Magnum::Matrix4 transformationMatrix;
+        Magnum::Matrix3 normalMatrix;
+        Magnum::Color4 color;
+    };
+
+    struct VelocityInstance
+    {
+        Magnum::Matrix4 transformationMatrix;
+        Magnum::Matrix4 oldTransformationMatrix;
+    };
+
+    size_t size() const
+    {
+        return _transformations.size();
+    }
+
+    bool isEmpty() const
+    {
+        return _transformations.isEmpty();
+    }
+
+    void reserve(size_t capacity);
+
+    // returns the index of the new instance
+    size_t add(const Magnum::Matrix4& transformation, const Magnum::Color4& color, Velocity velocity = Velocity::None);
+
+    Corrade::Containers::ArrayView<Magnum::Matrix4> transformations()
+    {
+        return _transformations;
+    }
+
+    Corrade::Containers::ArrayView<const Magnum::Matrix4> transformations() const
+    {
+        return _transformations;
+    }
+
+    Corrade::Containers::ArrayView<const Magnum::Color4> colors() const
+    {
+        return _colors;
+    }
+
+    Corrade::Containers::ArrayView<const Velocity> velocities() const
+    {
+        return _velocities;
+    }
+
+    // instances with color alpha < 1, colors can't change after add() so this is tracked there
+    size_t transparentCount() const
+    {
+        return _transparentCount;
+    }
+
+    // 0, 1, 2, ... size() - 1, for packing all instances
+    Corrade::Containers::ArrayView<const Magnum::UnsignedInt> all() const
+    {
+        return indices;
+    }
+
+    // order the given instances for blending: opaque ones (color alpha = 1) first in their original order,
+    // then transparent ones back to front by the view depth of their origin
+    // returns instances if there are no transparent instances, otherwise a view into storage that is reused,
+    // it's only valid until the next call
+    // opaqueCount is set to the number of opaque instances at the front
+    Corrade::Containers::ArrayView<const Magnum::UnsignedInt> drawOrder(
+        const Magnum::Matrix4& parentTransformation,
+        Corrade::Containers::ArrayView<const Magnum::UnsignedInt> instances,
+        size_t& opaqueCount);
+
+    // calculate this frame's instance data for the given instances, in that order
+    // parentTransformation is the owning object's transformation relative to the camera
+    // colorData is overwritten, velocity data is appended (nullptr to skip)
+    // remembers the transformations so the next call can output velocity data for them,
+    // instances that weren't packed in the previous call have no velocity
+    // packs on the calling thread if jobSystem is nullptr
+    void pack(const Magnum::Matrix4& parentTransformation,
+              Corrade::Containers::ArrayView<const Magnum::UnsignedInt> instances,
+              Corrade::Containers::Array<ColorInstance>& colorData,
+              Corrade::Containers::Array<VelocityInstance>* opaqueVelocityData,
+              Corrade::Containers::Array<VelocityInstance>* transparentVelocityData,
+              JobSystem* jobSystem = nullptr);
+
+    // forget the remembered transformations, the next pack() outputs no velocity
+    void resetVelocity()
+    {
+        packCount++;
+    }
+
+    // instances per job
+    static constexpr size_t GrainSize = 1024;
+
+private:
+    Corrade::Containers::Array<Magnum::Matrix4> _transformations;
+    Corrade::Containers::Array<Magnum::Color4> _colors;
+    Corrade::Containers::Array<Velocity> _velocities;
+    Corrade::Containers::Array<Magnum::UnsignedInt> indices;
+    size_t _transparentCount = 0;
+    // camera-relative transformations from the last pack() that included the instance
+    Corrade::Containers::Array<Magnum::Matrix4> oldTransformations;
+    // value of packCount when the instance was last packed, 0 = never
+    Corrade::Containers::Array<Magnum::UnsignedInt> packedIn;
+    Magnum::UnsignedInt packCount = 1;
+
+    // index into the velocity data for each packed instance, so packing doesn't depend on previous instances
+    Corrade::Containers::Array<Magnum::UnsignedInt> velocitySlots;
+
+    // drawOrder() storage, only grows
+    struct DepthKey
+    {
+        Magnum::UnsignedInt key;
+        Magnum::UnsignedInt instance;
+    };
+    Corrade::Containers::Array<DepthKey> depthKeys;
+    Corrade::Containers::Array<DepthKey> depthKeyScratch;
+    Corrade::Containers::Array<Magnum::UnsignedInt> orderedInstances;
+};
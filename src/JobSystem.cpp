@@ -0,0 +1,143 @@
+#include "JobSystem.h"
+
+#include <Corrade/Utility/Assert.h>
+
+using namespace Corrade;
+
+namespace
+{
+
+// which job system and queue the current thread belongs to
+// threads that aren't workers (e.g. the main thread) use queue 0
+thread_local const JobSystem* currentSystem = nullptr;
+thread_local size_t currentIndex = 0;
+
+}
+
+JobSystem::JobSystem(size_t threadCount)
+{
+    if(threadCount == 0)
+        threadCount = std::thread::hardware_concurrency();
+    if(threadCount == 0)
+        threadCount = 1;
+
+    queues = Containers::Array<Containers::Pointer<Queue>>(threadCount);
+    for(Containers::Pointer<Queue>& queue : queues)
+        queue.emplace();
+
+    workers = Containers::Array<std::thread>(threadCount - 1);
+    for(size_t i = 0; i < workers.size(); i++)
+        workers[i] = std::thread(&JobSystem::workerMain, this, i + 1);
+}
+
+JobSystem::~JobSystem()
+{
+    {
+        std::lock_guard<std::mutex> lock(sleepMutex);
+        stopping = true;
+    }
+    wakeUp.notify_all();
+
+    for(std::thread& worker : workers)
+        worker.join();
+}
+
+void JobSystem::run(size_t count, size_t grainSize, JobFunction function, void* data)
+{
+    CORRADE_ASSERT(grainSize > 0, "JobSystem::parallelFor(): grain size can't be 0", );
+
+    const size_t chunks = (count + grainSize - 1) / grainSize;
+    std::atomic<size_t> remaining { chunks };
+
+    const size_t queue = currentQueue();
+    {
+        std::lock_guard<std::mutex> lock(queues[queue]->mutex);
+        // the back is popped first, push in reverse so the calling thread starts at the beginning
+        for(size_t chunk = chunks; chunk > 0; chunk--)
+        {
+            const size_t begin = (chunk - 1) * grainSize;
+            const size_t end = begin + grainSize < count ? begin + grainSize : count;
+            queues[queue]->jobs.push_back({ function, data, begin, end, &remaining });
+        }
+    }
+
+    queuedJobs.fetch_add(chunks);
+    {
+        // makes sure no worker is between checking queuedJobs and going to sleep
+        std::lock_guard<std::mutex> lock(sleepMutex);
+    }
+    wakeUp.notify_all();
+
+    // help out until our jobs are done, this may run unrelated jobs from nested calls
+    while(remaining.load(std::memory_order_acquire) > 0)
+    {
+        Job job;
+        if(pop(queue, job) || steal(queue, job))
+            execute(job);
+        else
+            std::this_thread::yield();
+    }
+}
+
+size_t JobSystem::currentQueue() const
+{
+    return currentSystem == this ? currentIndex : 0;
+}
+
+bool JobSystem::pop(size_t queue, Job& job)
+{
+    Queue& own = *queues[queue];
+    std::lock_guard<std::mutex> lock(own.mutex);
+    if(own.jobs.empty())
+        return false;
+
+    job = own.jobs.back();
+    own.jobs.pop_back();
+    queuedJobs.fetch_sub(1);
+    return true;
+}
+
+bool JobSystem::steal(size_t thief, Job& job)
+{
+    for(size_t i = 1; i < queues.size(); i++)
+    {
+        Queue& victim = *queues[(thief + i) % queues.size()];
+        std::unique_lock<std::mutex> lock(victim.mutex, std::try_to_lock);
+        if(!lock.owns_lock() || victim.jobs.empty())
+            continue;
+
+        job = victim.jobs.front();
+        victim.jobs.pop_front();
+        queuedJobs.fetch_sub(1);
+        return true;
+    }
+
+    return false;
+}
+
+void JobSystem::execute(const Job& job)
+{
+    job.function(job.data, job.begin, job.end);
+    job.remaining->fetch_sub(1, std::memory_order_release);
+}
+
+void JobSystem::workerMain(size_t queue)
+{
+    currentSystem = this;
+    currentIndex = queue;
+
+    while(true)
+    {
+        Job job;
+        if(pop(queue, job) || steal(queue, job))
+        {
+            execute(job);
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lock(sleepMutex);
+        wakeUp.wait(lock, [this]() { return stopping || queuedJobs.load() > 0; });
+        if(stopping)
+            return;
+    }
+}
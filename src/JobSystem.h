@@ -0,0 +1,95 @@
+#pragma once
+
+#include <Corrade/Containers/Array.h>
+#include <Corrade/Containers/Pointer.h>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+
+// work-stealing thread pool for per-frame CPU work
+// every thread has its own job queue, jobs are pushed to and popped from the back of the own queue
+// and idle threads steal from the front of the others
+// meant for data-parallel loops over plain arrays, nothing in here may touch GL
+class JobSystem
+{
+public:
+    // threadCount includes the thread calling parallelFor(), 0 = one per hardware thread
+    explicit JobSystem(size_t threadCount = 0);
+    ~JobSystem();
+
+    // Copying is not allowed
+    JobSystem(const JobSystem&) = delete;
+    JobSystem& operator=(const JobSystem&) = delete;
+
+    // Moving is not allowed, workers reference this
+    JobSystem(JobSystem&&) = delete;
+    JobSystem& operator=(JobSystem&&) = delete;
+
+    size_t threadCount() const
+    {
+        return queues.size();
+    }
+
+    // split [0, count) into chunks of at most grainSize and call function(begin, end) for each, in parallel
+    // blocks until all chunks are done, the calling thread works on them in the meantime
+    // can be nested, e.g. called from inside another parallelFor()
+    template<typename Function> void parallelFor(size_t count, size_t grainSize, Function&& function)
+    {
+        typedef typename std::remove_reference<Function>::type FunctionType;
+
+        if(count == 0)
+            return;
+        if(threadCount() == 1 || count <= grainSize)
+        {
+            function(size_t(0), count);
+            return;
+        }
+
+        run(
+            count,
+            grainSize,
+            [](void* data, size_t begin, size_t end) { (*static_cast<FunctionType*>(data))(begin, end); },
+            const_cast<void*>(static_cast<const void*>(&function)));
+    }
+
+private:
+    typedef void (*JobFunction)(void* data, size_t begin, size_t end);
+
+    struct Job
+    {
+        JobFunction function;
+        void* data;
+        size_t begin;
+        size_t end;
+        std::atomic<size_t>* remaining;
+    };
+
+    struct Queue
+    {
+        std::mutex mutex;
+        std::deque<Job> jobs;
+    };
+
+    void run(size_t count, size_t grainSize, JobFunction function, void* data);
+
+    // index of the calling thread's queue
+    size_t currentQueue() const;
+    bool pop(size_t queue, Job& job);
+    bool steal(size_t thief, Job& job);
+    void execute(const Job& job);
+
+    void workerMain(size_t queue);
+
+    Corrade::Containers::Array<Corrade::Containers::Pointer<Queue>> queues;
+    Corrade::Containers::Array<std::thread> workers;
+
+    // jobs in all queues, idle workers sleep while this is 0
+    std::atomic<size_t> queuedJobs { 0 };
+    bool stopping = false;
+    std::mutex sleepMutex;
+    std::condition_variable wakeUp;
+};
@@ -2,17 +2,15 @@
 
 #include "Scene.h"
 #include "Feature.h"
+#include "Shaders/ProgramCache.h"
 #include <Magnum/GL/Version.h>
 #include <Magnum/GL/Context.h>
-#include <Magnum/GL/Extensions.h>
 #include <Magnum/GL/DebugOutput.h>
 #include <Magnum/GL/DefaultFramebuffer.h>
-#include <Magnum/GL/TextureFormat.h>
 #include <Magnum/GL/Renderer.h>
-#include <Magnum/MeshTools/FullScreenTriangle.h>
 #include <Magnum/Math/Color.h>
+#include <Magnum/Math/Functions.h>
 #include <Magnum/ImGuiIntegration/Widgets.h>
-#include <Corrade/Containers/StaticArray.h>
 #include <Corrade/Utility/Arguments.h>
 #include <Corrade/Utility/Format.h>
 
@@ -25,18 +23,7 @@ const char* Mosaiikki::NAME = "mosaiikki";
 
 Mosaiikki::Mosaiikki(const Arguments& arguments) :
     ImGuiApplication(arguments, NoCreate),
-    logFile(std::string(NAME) + ".log", std::fstream::out | std::fstream::trunc),
-    fullscreenTriangle(NoCreate),
-    velocityFramebuffer(NoCreate),
-    velocityAttachment(NoCreate),
-    velocityDepthAttachment(NoCreate),
-    framebuffers { GL::Framebuffer(NoCreate), GL::Framebuffer(NoCreate) },
-    colorAttachments(NoCreate),
-    depthAttachments(NoCreate),
-    depthBlitShader(NoCreate),
-    outputFramebuffer(NoCreate),
-    outputColorAttachment(NoCreate),
-    reconstructionShader(NoCreate)
+    logFile(std::string(NAME) + ".log", std::fstream::out | std::fstream::trunc)
 {
     // Redirect log to file
 
@@ -71,16 +58,14 @@ Mosaiikki::Mosaiikki(const Arguments& arguments) :
     setSwapInterval(0); // disable v-sync
 #endif
 
-    MAGNUM_ASSERT_GL_EXTENSION_SUPPORTED(GL::Extensions::ARB::explicit_attrib_location); // core in 3.3
-    MAGNUM_ASSERT_GL_EXTENSION_SUPPORTED(GL::Extensions::ARB::sample_shading);           // core in 4.0
-    MAGNUM_ASSERT_GL_EXTENSION_SUPPORTED(GL::Extensions::ARB::texture_multisample);      // core in 3.2
-    MAGNUM_ASSERT_GL_EXTENSION_SUPPORTED(GL::Extensions::ARB::uniform_buffer_object);    // core in 3.1
-
-    GL::Renderer::enable(GL::Renderer::Feature::Multisampling);
+    ProgramCache::setupParallelCompile();
 
     // Debug output
 
     profiler.setup(DebugTools::FrameProfilerGL::Value::FrameTime | DebugTools::FrameProfilerGL::Value::GpuDuration, 60);
+    passProfiler.setup(60);
+    passProfiler.excludeFromRenderTime("imgui");
+    framePacer.setup(60);
 
 #ifdef CORRADE_IS_DEBUG_BUILD
     GL::Renderer::enable(GL::Renderer::Feature::DebugOutput);
@@ -106,215 +91,32 @@ Mosaiikki::Mosaiikki(const Arguments& arguments) :
     Containers::ArrayView<const char> font = rs.getRaw("fonts/Roboto-Regular.ttf");
     setFont(font.data(), font.size(), 15.0f);
 
-    // Framebuffers
-
-    resizeFramebuffers(framebufferSize());
-
-    setSamplePositions();
+    // Checkerboard rendering
 
-    // Shaders
-
-    depthBlitShader = DepthBlitShader();
-    depthBlitShader.setLabel("Depth blit shader");
-
-    ReconstructionShader::Flags reconstructionFlags = ReconstructionShader::Flags()
-#ifdef CORRADE_IS_DEBUG_BUILD
-                                                      | ReconstructionShader::Flag::Debug
-#endif
-        ;
-    reconstructionShader = ReconstructionShader(reconstructionFlags);
-    reconstructionShader.setLabel("Checkerboard resolve shader");
+    renderer.emplace(framebufferSize());
+    renderer->setProfiler(&passProfiler);
 
     // Scene
 
     scene.emplace();
-
-    for(Containers::Pointer<GL::Texture2D>& texture : scene->textures)
-    {
-        if(texture)
-        {
-            // LOD calculation is something roughly equivalent to: log2(max(len(dFdx(uv)), len(dFdy(uv)))
-            // halving the rendering width/height doubles the derivate length
-            // after upsampling, textures would become blurry compared to full-resolution rendering
-            // so offset LOD to lower mip level to full resolution equivalent (log2(sqrt(2)) = 0.5)
-            texture->setLodBias(-0.5f);
-        }
-    }
-
-    scene->camera->setViewport(framebufferSize());
-    updateProjectionMatrix(*scene->camera);
-
-    CORRADE_INTERNAL_CONSTEXPR_ASSERT(GLVersion >= GL::Version::GL300);
-    fullscreenTriangle = MeshTools::fullScreenTriangle(GLVersion);
+    renderer->prepareScene(*scene);
+    scene->setViewport(framebufferSize());
 
     timeline.start();
 }
 
-void Mosaiikki::updateProjectionMatrix(Magnum::SceneGraph::Camera3D& cam)
-{
-    //constexpr Rad hFOV_4by3 = 90.0_degf;
-    //Rad vFOV = Math::atan(Math::tan(hFOV_4by3 * 0.5f) / (4.0f / 3.0f)) * 2.0f;
-    constexpr Rad vFOV = 73.74_degf;
-
-    float aspectRatio = Vector2(cam.viewport()).aspectRatio();
-    Rad hFOV = Math::atan(Math::tan(vFOV * 0.5f) * aspectRatio) * 2.0f;
-    cam.setProjectionMatrix(Matrix4::perspectiveProjection(hFOV, aspectRatio, scene->cameraNear, scene->cameraFar));
-}
-
-void Mosaiikki::resizeFramebuffers(Vector2i size)
-{
-    // make texture dimensions multiple of two
-    size += size % 2;
-
-    // xy = velocity, z = mask for dynamic objects
-    velocityAttachment = GL::Texture2D();
-    velocityAttachment.setStorage(1, GL::TextureFormat::RGBA16F, size);
-    velocityAttachment.setLabel("Velocity texture");
-    velocityDepthAttachment = GL::Texture2D();
-    velocityDepthAttachment.setStorage(1, GL::TextureFormat::DepthComponent24, size);
-    velocityDepthAttachment.setLabel("Velocity depth texture");
-
-    velocityFramebuffer = GL::Framebuffer({ { 0, 0 }, size });
-    velocityFramebuffer.attachTexture(GL::Framebuffer::ColorAttachment(0), velocityAttachment, 0 /* level */);
-    velocityFramebuffer.attachTexture(GL::Framebuffer::BufferAttachment::Depth, velocityDepthAttachment, 0 /* level */);
-    velocityFramebuffer.mapForDraw({ { VelocityShader::VelocityOutput, GL::Framebuffer::ColorAttachment(0) } });
-    velocityFramebuffer.setLabel("Velocity framebuffer");
-
-    CORRADE_INTERNAL_ASSERT(velocityFramebuffer.checkStatus(GL::FramebufferTarget::Read) ==
-                            GL::Framebuffer::Status::Complete);
-    CORRADE_INTERNAL_ASSERT(velocityFramebuffer.checkStatus(GL::FramebufferTarget::Draw) ==
-                            GL::Framebuffer::Status::Complete);
-
-    const Vector2i quarterSize = size / 2;
-    const Vector3i arraySize = { quarterSize, FRAMES };
-
-    colorAttachments = GL::MultisampleTexture2DArray();
-    colorAttachments.setStorage(2, GL::TextureFormat::RGBA8, arraySize, GL::MultisampleTextureSampleLocations::Fixed);
-    colorAttachments.setLabel("Color texture array (quarter-res 2x MSAA)");
-    depthAttachments = GL::MultisampleTexture2DArray();
-    depthAttachments.setStorage(
-        2, GL::TextureFormat::DepthComponent24, arraySize, GL::MultisampleTextureSampleLocations::Fixed);
-    depthAttachments.setLabel("Depth texture array (quarter-res 2x MSAA)");
-
-    for(size_t i = 0; i < FRAMES; i++)
-    {
-        framebuffers[i] = GL::Framebuffer({ { 0, 0 }, quarterSize });
-        framebuffers[i].attachTextureLayer(GL::Framebuffer::ColorAttachment(0), colorAttachments, i /* layer */);
-        framebuffers[i].attachTextureLayer(GL::Framebuffer::BufferAttachment::Depth, depthAttachments, i /* layer */);
-        framebuffers[i].mapForDraw({ { Shaders::GenericGL3D::ColorOutput, GL::Framebuffer::ColorAttachment(0) } });
-        framebuffers[i].setLabel(Utility::format("Framebuffer {} (quarter-res)", i + 1));
-
-        CORRADE_INTERNAL_ASSERT(framebuffers[i].checkStatus(GL::FramebufferTarget::Read) ==
-                                GL::Framebuffer::Status::Complete);
-        CORRADE_INTERNAL_ASSERT(framebuffers[i].checkStatus(GL::FramebufferTarget::Draw) ==
-                                GL::Framebuffer::Status::Complete);
-    }
-
-    outputColorAttachment = GL::Texture2D();
-    outputColorAttachment.setStorage(1, GL::TextureFormat::RGBA8, size);
-    // filter and wrapping for zoomed GUI debug output
-    outputColorAttachment.setMagnificationFilter(SamplerFilter::Nearest);
-    outputColorAttachment.setWrapping({ GL::SamplerWrapping::ClampToBorder, GL::SamplerWrapping::ClampToBorder });
-    outputColorAttachment.setBorderColor(0x000000_rgbf);
-    outputColorAttachment.setLabel("Output color texture");
-
-    outputFramebuffer = GL::Framebuffer({ { 0, 0 }, size });
-    outputFramebuffer.attachTexture(GL::Framebuffer::ColorAttachment(0), outputColorAttachment, 0 /* level */);
-    // no depth buffer needed
-    outputFramebuffer.mapForDraw({ { ReconstructionShader::ColorOutput, GL::Framebuffer::ColorAttachment(0) } });
-    outputFramebuffer.setLabel("Output framebuffer");
-
-    CORRADE_INTERNAL_ASSERT(outputFramebuffer.checkStatus(GL::FramebufferTarget::Read) ==
-                            GL::Framebuffer::Status::Complete);
-    CORRADE_INTERNAL_ASSERT(outputFramebuffer.checkStatus(GL::FramebufferTarget::Draw) ==
-                            GL::Framebuffer::Status::Complete);
-}
-
-void Mosaiikki::setSamplePositions()
+void Mosaiikki::drawEvent()
 {
-    const GLsizei SAMPLE_COUNT = 2;
-    const Vector2 samplePositions[SAMPLE_COUNT] = { { 0.75f, 0.75f }, { 0.25f, 0.25f } };
-
-    // set explicit MSAA sample locations
-    // OpenGL does not specify them, so we have to do it manually using one of three extensions
-
-    // ARB extension is really only supported by Nvidia (Maxwell and later) and requires GL 4.5
-    bool ext_arb = GL::Context::current().isExtensionSupported<GL::Extensions::ARB::sample_locations>();
-    bool ext_nv = GL::Context::current().isExtensionSupported<GL::Extensions::NV::sample_locations>();
-    bool ext_amd = GL::Context::current().isExtensionSupported<GL::Extensions::AMD::sample_positions>();
-    // Haven't found an Intel extension although D3D12 support for it exists
-
-    if(!(ext_arb || ext_nv || ext_amd))
-    {
-        // none of the extensions are supported (also happens in RenderDoc which force-disables it)
-        // warn here instead of aborting because you might have the correct sample positions anyway (which we check below)
-        // the sample positions we request seem to be the default on Nvidia GPUs
-        Warning() << "No extension for setting sample positions found!";
-    }
-
-    for(size_t frame = 0; frame < FRAMES; frame++)
-    {
-        framebuffers[frame].bind();
-
-        if(ext_arb)
-        {
-            int supportedSampleCount = 0;
-            glGetIntegerv(GL_PROGRAMMABLE_SAMPLE_LOCATION_TABLE_SIZE_ARB, &supportedSampleCount);
-            CORRADE_INTERNAL_ASSERT(SAMPLE_COUNT <= supportedSampleCount);
-
-            glFramebufferParameteri(GL_FRAMEBUFFER, GL_FRAMEBUFFER_PROGRAMMABLE_SAMPLE_LOCATIONS_ARB, GL_TRUE);
-            glFramebufferSampleLocationsfvARB(GL_FRAMEBUFFER, 0, SAMPLE_COUNT, samplePositions[0].data());
-        }
-        else if(ext_nv)
-        {
-            int supportedSampleCount = 0;
-            glGetIntegerv(GL_PROGRAMMABLE_SAMPLE_LOCATION_TABLE_SIZE_NV, &supportedSampleCount);
-            CORRADE_INTERNAL_ASSERT(SAMPLE_COUNT <= supportedSampleCount);
-
-            glFramebufferParameteri(GL_FRAMEBUFFER, GL_FRAMEBUFFER_PROGRAMMABLE_SAMPLE_LOCATIONS_NV, GL_TRUE);
-            glFramebufferSampleLocationsfvNV(GL_FRAMEBUFFER, 0, SAMPLE_COUNT, samplePositions[0].data());
-        }
-        else if(ext_amd)
-        {
-            for(GLuint i = 0; i < SAMPLE_COUNT; i++)
-            {
-                glSetMultisamplefvAMD(GL_SAMPLE_POSITION, i, samplePositions[i].data());
-            }
-        }
-    }
-
-    // read back, report and check actual sample locations
+    framePacer.beginFrame(Math::max(options.framePacing.maxFramesInFlight, 0), options.framePacing.frameRateLimit);
 
-    bool mismatch = false;
-    Debug(Debug::Flag::NoSpace) << "MSAA " << SAMPLE_COUNT << "x sample positions:";
-    for(GLuint i = 0; i < SAMPLE_COUNT; i++)
-    {
-        Vector2 position;
-        // GL_SAMPLE_POSITION reads the default sample location with ARB/NV_sample_locations
-        GLenum name = ext_arb ? GL_PROGRAMMABLE_SAMPLE_LOCATION_ARB
-                              : (ext_nv ? GL_PROGRAMMABLE_SAMPLE_LOCATION_NV : GL_SAMPLE_POSITION);
-        glGetMultisamplefv(name, i, position.data());
-        Debug(Debug::Flag::NoSpace) << i << ": " << position;
-
-        // positions can be quantized, so only do a rough comparison
-        // we can query the quantization amount (SUBSAMPLE_DISTANCE_AMD and SAMPLE_LOCATION_SUBPIXEL_BITS_NV)
-        // but we're only interested in an acceptable absolute error anyway
-        constexpr float allowedError = 1.0f / 8.0f;
-        if((Math::abs(position - samplePositions[i]) > Vector2(allowedError)).any())
-        {
-            mismatch = true;
-        }
-    }
+    profiler.beginFrame();
+    passProfiler.beginFrame();
 
-    if(mismatch)
-        Error() << "Wrong sample positions, output will likely be incorrect!";
+    FrameRenderer& frameRenderer = frameRenderers[passProfiler.currentFrame() % Containers::arraySize(frameRenderers)];
+    frameRenderer = FrameRenderer::None;
 
-    GL::defaultFramebuffer.bind();
-}
-
-void Mosaiikki::drawEvent()
-{
-    profiler.beginFrame();
+    // keeps loading while paused, drawables show up on the next rendered frame
+    scene->streamScene();
 
     if(!paused || advanceOneFrame)
     {
@@ -323,157 +125,30 @@ void Mosaiikki::drawEvent()
         scene->meshAnimables.step(timeline.previousFrameTime(), timeline.previousFrameDuration());
         scene->cameraAnimables.step(timeline.previousFrameTime(), timeline.previousFrameDuration());
 
-        constexpr GL::Renderer::DepthFunction depthFunction = GL::Renderer::DepthFunction::LessOrEqual; // default: Less
-
-        GL::Renderer::enable(GL::Renderer::Feature::FaceCulling);
-        GL::Renderer::enable(GL::Renderer::Feature::DepthTest);
-        GL::Renderer::setDepthFunction(depthFunction);
-
-        GL::Renderer::disable(GL::Renderer::Feature::Blending);
-        GL::Renderer::setBlendEquation(GL::Renderer::BlendEquation::Add, GL::Renderer::BlendEquation::Add);
-        GL::Renderer::setBlendFunction(GL::Renderer::BlendFunction::SourceAlpha,
-                                       GL::Renderer::BlendFunction::OneMinusSourceAlpha);
-
-        static Containers::StaticArray<FRAMES, Matrix4> oldMatrices = { Matrix4(Math::IdentityInit),
-                                                                        Matrix4(Math::IdentityInit) };
-        Containers::StaticArray<FRAMES, Matrix4> matrices;
-
-        // jitter viewport half a pixel to the right = one pixel in the full-res framebuffer
-        // = width of NDC divided by full-res pixel count
-        const Matrix4 unjitteredProjection = scene->camera->projectionMatrix();
-        const float offset = 2.0f / scene->camera->viewport().x();
-        matrices[JITTERED_FRAME] = Matrix4::translation(Vector3::xAxis(offset)) * unjitteredProjection;
-        matrices[1 - JITTERED_FRAME] = unjitteredProjection;
-
-        // fill velocity buffer
-
-        if(options.reconstruction.createVelocityBuffer)
+        frameRenderer = options.native.enabled ? FrameRenderer::Native : FrameRenderer::Checkerboard;
+        if(options.native.enabled)
         {
-            GL::DebugGroup group(GL::DebugGroup::Source::Application, 0, "Velocity buffer");
-
-            velocityFramebuffer.bind();
-            velocityFramebuffer.clearColor(0, 0_rgbf);
-            velocityFramebuffer.clearDepth(1.0f);
-
-            // dynamic objects only
-            // camera velocity for static objects is calculated with reprojection in the checkerboard resolve pass
-            if(scene->meshAnimables.runningCount() > 0)
+            if(!nativeRenderer)
             {
-                // offset depth for the depth blit, otherwise the depth test might fail in the quarter-res pass
-                // not entirely sure what causes this, could be floating point inaccuracy?
-                // slope bias allows an offset based on triangle depth gradient,
-                // without it we'd need to use a larger constant bias and pray it works
-                GL::Renderer::enable(GL::Renderer::Feature::PolygonOffsetFill);
-                GL::Renderer::setPolygonOffset(1 /* slope bias */, 1 /* constant bias */);
-
-                // use current frame's jitter
-                // this only matters because we blit the velocity depth buffer to reuse it for the quarter resolution pass
-                // without it, you can use either jittered or unjittered, as long as they match
-                scene->velocityShader.setProjectionMatrix(matrices[currentFrame])
-                    .setOldProjectionMatrix(oldMatrices[currentFrame]);
-
-                scene->camera->draw(scene->velocityDrawables);
-
-                // transparent objects shouldn't write to the depth buffer if we blit and reuse it in the quarter-res scene pass
-                // TODO without depth writes they now have to be properly sorted back to front
-                // we kinda do this during scene creation, which works because the camera position is static
-                // for the opaque velocity drawables, we could sort front to back to reduce overdraw
-                // should we do the same for the normal renderables? it'll be a bit annoying to duplicate the
-                // Renderables added in loadScene :<
-                GL::Renderer::setDepthMask(GL_FALSE);
-                scene->camera->draw(scene->transparentVelocityDrawables);
-                GL::Renderer::setDepthMask(GL_TRUE);
-
-                GL::Renderer::disable(GL::Renderer::Feature::PolygonOffsetFill);
+                nativeRenderer.emplace(framebufferSize());
+                nativeRenderer->setProfiler(&passProfiler);
             }
+            nativeRenderer->draw(*scene, options);
         }
-
-        // render scene at quarter resolution
-
+        else
         {
-            GL::DebugGroup group(GL::DebugGroup::Source::Application, 0, "Scene rendering (quarter-res)");
-
-            GL::Framebuffer& framebuffer = framebuffers[currentFrame];
-            framebuffer.bind();
-
-            // run fragment shader for each sample
-            GL::Renderer::enable(GL::Renderer::Feature::SampleShading);
-            GL::Renderer::setMinSampleShading(1.0f);
-
-            // copy and reuse velocity depth buffer
-            if(options.reconstruction.createVelocityBuffer && options.reuseVelocityDepth)
-            {
-                GL::DebugGroup group2(GL::DebugGroup::Source::Application, 0, "Velocity depth blit");
-
-                GL::Renderer::setDepthFunction(
-                    GL::Renderer::DepthFunction::Always); // fullscreen pass, always pass depth test
-                GL::Renderer::setColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE); // disable color writing
-
-                // blit to quarter res with max filter
-                depthBlitShader.bindDepth(velocityDepthAttachment);
-                depthBlitShader.draw(fullscreenTriangle);
-
-                GL::Renderer::setColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
-                GL::Renderer::setDepthFunction(depthFunction);
-
-                // implementations can choose to optimize storage by not writing actual depth
-                // values and reconstructing them during sampling at the default sample positions
-                // these commands force correct per-sample depth to be written to the depth buffer
-                if(glEvaluateDepthValuesARB)
-                    glEvaluateDepthValuesARB();
-                else if(glResolveDepthValuesNV)
-                    glResolveDepthValuesNV();
-            }
-            else
-            {
-                framebuffer.clearDepth(1.0f);
-            }
-
-            const Color4 clearColor = Color4::fromSrgb(0x772953_rgbf); // Ubuntu Canonical aubergine
-            framebuffer.clearColor(0, clearColor);
-
-            // use jittered camera if necessary
-            scene->camera->setProjectionMatrix(matrices[currentFrame]);
-
-            GL::Renderer::enable(GL::Renderer::Feature::Blending);
-
-            scene->camera->draw(scene->drawables);
-
-            GL::Renderer::disable(GL::Renderer::Feature::Blending);
-
-            GL::Renderer::disable(GL::Renderer::Feature::SampleShading);
+            renderer->setRenderScale(dynamicResolution.update(passProfiler, options.dynamicResolution));
+            renderer->draw(*scene, options);
         }
 
-        // undo any jitter
-        scene->camera->setProjectionMatrix(unjitteredProjection);
-
-        // combine framebuffers
-
-        {
-            GL::DebugGroup group(GL::DebugGroup::Source::Application, 1, "Checkerboard resolve");
-
-            outputFramebuffer.bind();
-
-            GL::Renderer::disable(GL::Renderer::Feature::DepthTest);
-
-            reconstructionShader.bindColor(colorAttachments)
-                .bindDepth(depthAttachments)
-                .bindVelocity(velocityAttachment)
-                .setCurrentFrame(currentFrame)
-                .setCameraInfo(*scene->camera, scene->cameraNear, scene->cameraFar)
-                .setOptions(options.reconstruction)
-                .setBuffer();
-            reconstructionShader.draw(fullscreenTriangle);
-        }
-
-        // housekeeping
-
-        currentFrame = (currentFrame + 1) % FRAMES;
-        oldMatrices = matrices;
+        if(sharedOutput)
+            sharedOutput->output(outputFramebuffer(), &passProfiler);
     }
 
-    GL::Framebuffer::blit(
-        outputFramebuffer, GL::defaultFramebuffer, GL::defaultFramebuffer.viewport(), GL::FramebufferBlit::Color);
+    GL::Framebuffer::blit(outputFramebuffer(),
+                          GL::defaultFramebuffer,
+                          GL::defaultFramebuffer.viewport(),
+                          GL::FramebufferBlit::Color);
 
     // render UI
 
@@ -481,14 +156,18 @@ void Mosaiikki::drawEvent()
 
     {
         GL::DebugGroup group(GL::DebugGroup::Source::Application, 2, "imgui");
+        GpuProfiler::Scope scope(&passProfiler, "imgui");
 
         ImGuiApplication::drawEvent();
     }
 
     timeline.nextFrame();
+    passProfiler.endFrame();
     profiler.endFrame();
 
     swapBuffers();
+    // after the swap so the fence covers presenting as well
+    framePacer.endFrame();
     redraw();
 }
 
@@ -496,9 +175,50 @@ void Mosaiikki::viewportEvent(ViewportEvent& event)
 {
     ImGuiApplication::viewportEvent(event);
 
-    resizeFramebuffers(event.framebufferSize());
-    scene->camera->setViewport(event.framebufferSize());
-    updateProjectionMatrix(*scene->camera);
+    renderer->resizeFramebuffers(event.framebufferSize());
+    if(nativeRenderer)
+        nativeRenderer->resizeFramebuffers(event.framebufferSize());
+    scene->setViewport(event.framebufferSize());
+
+    // the ring has a fixed frame size, consumers see the state change and reopen it
+    if(sharedOutput)
+    {
+        sharedOutput = nullptr;
+        sharedOutput.emplace(MOSAIIKKI_SHM_NAME, event.framebufferSize());
+        if(!sharedOutput->isOpen())
+            sharedOutput = nullptr;
+    }
+}
+
+GL::Framebuffer& Mosaiikki::outputFramebuffer()
+{
+    return options.native.enabled && nativeRenderer ? nativeRenderer->outputFramebuffer : renderer->outputFramebuffer;
+}
+
+GL::Texture2D& Mosaiikki::outputColorAttachment()
+{
+    return options.native.enabled && nativeRenderer ? nativeRenderer->outputColorAttachment
+                                                    : renderer->outputColorAttachment;
+}
+
+Double Mosaiikki::renderGpuTime(FrameRenderer frameRenderer)
+{
+    Double sum = 0.0;
+    size_t count = 0;
+    for(size_t i = 0; i < passProfiler.historyCount(); i++)
+    {
+        const GpuProfiler::FrameResult& result = passProfiler.historyFrame(i);
+        if(frameRenderers[result.frame % Containers::arraySize(frameRenderers)] != frameRenderer)
+            continue;
+
+        // without nested passes, checkerboarding nests some of its passes and native rendering doesn't
+        sum += passProfiler.renderTime(result);
+        count++;
+    }
+
+    if(count > 0)
+        lastGpuTimes[UnsignedByte(frameRenderer)] = sum / count;
+    return lastGpuTimes[UnsignedByte(frameRenderer)];
 }
 
 void Mosaiikki::keyReleaseEvent(KeyEvent& event)
@@ -544,9 +264,61 @@ void Mosaiikki::buildUI()
     {
         ImGui::Checkbox("Animated objects", &options.scene.animatedObjects);
         ImGui::Checkbox("Animated camera", &options.scene.animatedCamera);
+        ImGui::BeginDisabled(options.scene.gpuCulling && scene->isGpuCullingSupported());
+        ImGui::Checkbox("Frustum culling", &options.scene.frustumCulling);
+        ImGui::EndDisabled();
+
+        ImGui::BeginDisabled(!scene->isGpuCullingSupported());
+        ImGui::Checkbox("GPU culling", &options.scene.gpuCulling);
+        if(ImGui::IsItemHovered(ImGuiHoveredFlags_AllowWhenDisabled))
+            ImGui::SetTooltip(
+                "Frustum cull and pack instances in a compute shader and draw them with multi-draw indirect.\n"
+                "Always culls, requires OpenGL 4.3.");
+        ImGui::EndDisabled();
+
+        ImGui::BeginDisabled(!(options.scene.gpuCulling && scene->isGpuCullingSupported() &&
+                               options.reconstruction.createVelocityBuffer));
+        ImGui::Checkbox("Occlusion culling", &options.scene.occlusionCulling);
+        if(ImGui::IsItemHovered(ImGuiHoveredFlags_AllowWhenDisabled))
+            ImGui::SetTooltip(
+                "Skip instances in the quarter-res pass that are hidden behind the velocity pass depth.\n"
+                "Requires GPU culling and the velocity buffer.");
+        ImGui::EndDisabled();
+
+        ImGui::Separator();
+
+        ImGui::Checkbox("Native rendering", &options.native.enabled);
+        if(ImGui::IsItemHovered())
+            ImGui::SetTooltip(
+                "Render at full resolution without checkerboarding, as a baseline for quality and cost.\n"
+                "The stats window shows the GPU time of both renderers.");
+        ImGui::BeginDisabled(!options.native.enabled);
+        static const char* const samplesOptions[] = { "Off", "2x", "4x", "8x" };
+        int samplesIndex = 0;
+        while(samplesIndex + 1 < int(Containers::arraySize(samplesOptions)) &&
+              (2 << samplesIndex) <= options.native.samples)
+            samplesIndex++;
+        ImGui::SetNextItemWidth(ImGui::GetWindowWidth() * 0.5f);
+        if(ImGui::Combo("MSAA", &samplesIndex, samplesOptions, Containers::arraySize(samplesOptions)))
+            options.native.samples = 1 << samplesIndex;
+        ImGui::EndDisabled();
 
         ImGui::Separator();
 
+        // checkerboard options
+        ImGui::BeginDisabled(options.native.enabled);
+
+        static const char* const frameCycleOptions[] = { "2 frames", "4 frames" };
+        int frameCycleIndex = options.reconstruction.frames == 4 ? 1 : 0;
+        ImGui::SetNextItemWidth(ImGui::GetWindowWidth() * 0.5f);
+        if(ImGui::Combo("Frame cycle", &frameCycleIndex, frameCycleOptions, Containers::arraySize(frameCycleOptions)))
+            options.reconstruction.frames = frameCycleIndex == 1 ? 4 : 2;
+        if(ImGui::IsItemHovered(ImGuiHoveredFlags_AllowWhenDisabled))
+            ImGui::SetTooltip(
+                "2 frames: checkerboard, shades half of the full-res pixels per frame.\n"
+                "4 frames: shades one pixel in each 2x2 block per frame with a rotating jitter and reprojects the\n"
+                "other three from the previous frames. Quarter the shading cost, more ghosting and flicker in motion.");
+
         ImGui::Checkbox("Create velocity buffer", &options.reconstruction.createVelocityBuffer);
         if(ImGui::IsItemHovered())
             ImGui::SetTooltip(
@@ -577,10 +349,74 @@ void Mosaiikki::buildUI()
                 "When blending pixel neighbor horizontal/vertical axes, weight their contribution by how small the color difference is.\n"
                 "This greatly reduces checkerboard artifacts at sharp edges.");
 
+        ImGui::BeginDisabled(!renderer->isComputeResolveSupported());
+        ImGui::Checkbox("Compute shader resolve", &options.computeResolve);
+        if(ImGui::IsItemHovered(ImGuiHoveredFlags_AllowWhenDisabled))
+            ImGui::SetTooltip(
+                "Resolve with a compute shader that caches quarter-res tiles in shared memory instead of a fullscreen pass.\n"
+                "Requires OpenGL 4.3.");
+        ImGui::EndDisabled();
+
+        ImGui::Separator();
+
+        ImGui::BeginDisabled(!passProfiler.isEnabled());
+        ImGui::Checkbox("Dynamic resolution", &options.dynamicResolution.enabled);
+        if(ImGui::IsItemHovered(ImGuiHoveredFlags_AllowWhenDisabled))
+            ImGui::SetTooltip(
+                "Scale the render size to keep the measured GPU frame time within the budget, the resolved image is upscaled to the window size.\n"
+                "Requires ARB_timer_query.");
+        ImGui::EndDisabled();
+
+        ImGui::BeginDisabled(!(options.dynamicResolution.enabled && passProfiler.isEnabled()));
+        ImGui::SetNextItemWidth(ImGui::GetWindowWidth() / 2.0f);
+        ImGui::SliderFloat("GPU budget", &options.dynamicResolution.frameBudget, 1.0f, 50.0f, "%.1f ms");
+        ImGui::SetNextItemWidth(ImGui::GetWindowWidth() / 2.0f);
+        ImGui::SliderFloat("Minimum scale", &options.dynamicResolution.minScale, 0.25f, 1.0f, "%.2f");
+        if(ImGui::IsItemHovered())
+            ImGui::SetTooltip("Smallest render size relative to the window size in each dimension");
+        ImGui::EndDisabled();
+
+        ImGui::EndDisabled();
+
+        ImGui::Separator();
+
+        ImGui::SetNextItemWidth(ImGui::GetWindowWidth() / 2.0f);
+        ImGui::SliderInt("Frames in flight", &options.framePacing.maxFramesInFlight, 0, 4);
+        if(ImGui::IsItemHovered())
+            ImGui::SetTooltip(
+                "Maximum number of frames queued on the GPU before the CPU waits for the oldest one, 0 is unlimited.\n"
+                "Fewer frames lower the latency, but the GPU can run idle while the next frame is prepared.");
+        ImGui::SetNextItemWidth(ImGui::GetWindowWidth() / 2.0f);
+        ImGui::SliderFloat("Frame rate limit", &options.framePacing.frameRateLimit, 0.0f, 240.0f, "%.0f fps");
+        if(ImGui::IsItemHovered())
+            ImGui::SetTooltip("0 is unlimited");
+
+        ImGui::Separator();
+
+        ImGui::BeginDisabled(!SharedMemoryOutput::isSupported());
+        bool sharedOutputEnabled = sharedOutput != nullptr;
+        if(ImGui::Checkbox("Shared memory output", &sharedOutputEnabled))
+        {
+            if(sharedOutputEnabled)
+            {
+                sharedOutput.emplace(MOSAIIKKI_SHM_NAME, framebufferSize());
+                if(!sharedOutput->isOpen())
+                    sharedOutput = nullptr;
+            }
+            else
+                sharedOutput = nullptr;
+        }
+        if(ImGui::IsItemHovered(ImGuiHoveredFlags_AllowWhenDisabled))
+            ImGui::SetTooltip("Publish resolved frames to the POSIX shared memory object " MOSAIIKKI_SHM_NAME
+                              ", see SharedMemoryFormat.h for the layout.\n"
+                              "Requires a POSIX system.");
+        ImGui::EndDisabled();
+
 #ifdef CORRADE_IS_DEBUG_BUILD
 
         ImGui::Separator();
 
+        // with a four-frame cycle these are the first two frames
         static const char* const debugSamplesOptions[] = { "Combined", "Even", "Odd (jittered)" };
         ImGui::SetNextItemWidth(ImGui::GetWindowWidth() * 0.5f);
         ImGui::Combo("Show samples",
@@ -646,6 +482,71 @@ void Mosaiikki::buildUI()
         "Stats", nullptr, ImGuiWindowFlags_NoTitleBar | ImGuiWindowFlags_AlwaysAutoResize | ImGuiWindowFlags_NoMove);
     {
         ImGui::Text("%s", profiler.statistics().c_str());
+        if(scene->isLoading())
+            ImGui::Text("Loading scene...");
+        if(scene->gpuCulling)
+            ImGui::Text("Instances: %zu (culled on the GPU)", scene->visibleInstanceCount);
+        else
+            ImGui::Text("Instances: %zu visible, %zu culled", scene->visibleInstanceCount, scene->culledInstanceCount);
+
+        if(passProfiler.isEnabled() && passProfiler.passCount() > 0)
+        {
+            if(ImGui::BeginTable("Passes", 2, ImGuiTableFlags_SizingFixedFit))
+            {
+                ImGui::TableSetupColumn("Pass");
+                ImGui::TableSetupColumn("GPU (ms)");
+                ImGui::TableHeadersRow();
+                for(size_t i = 0; i < passProfiler.passCount(); i++)
+                {
+                    ImGui::TableNextRow();
+                    ImGui::TableNextColumn();
+                    ImGui::Text("%s", passProfiler.passName(i));
+                    ImGui::TableNextColumn();
+                    ImGui::Text("%.3f", passProfiler.average(i));
+                }
+                ImGui::EndTable();
+            }
+
+            if(ImGui::Button("Save pass timings"))
+            {
+                const std::string filename = std::string(NAME) + "-passes.csv";
+                std::ofstream file(filename, std::ios::out | std::ios::trunc);
+                passProfiler.writeCsv(file);
+                if(file.good())
+                    Debug() << "Pass timings written to" << filename.c_str();
+                else
+                    Error() << "Can't write pass timings to" << filename.c_str();
+            }
+        }
+
+        if(framePacer.isLatencySupported())
+            ImGui::Text("Latency: %.2f ms, %zu frames in flight",
+                        framePacer.averageLatency(),
+                        framePacer.framesInFlight());
+        ImGui::Text("Fence wait: %.2f ms", framePacer.averageFenceWait());
+        if(sharedOutput)
+            ImGui::Text("Shared memory: %zu frames published", sharedOutput->publishedFrames());
+
+        if(passProfiler.isEnabled())
+        {
+            const Double checkerboardTime = renderGpuTime(FrameRenderer::Checkerboard);
+            const Double nativeTime = renderGpuTime(FrameRenderer::Native);
+            if(nativeTime > 0.0 && checkerboardTime > 0.0)
+                ImGui::Text("Rendering: checkerboard %.2f ms, native %.2f ms (%.0f%%)",
+                            checkerboardTime,
+                            nativeTime,
+                            checkerboardTime / nativeTime * 100.0);
+        }
+
+        if(options.dynamicResolution.enabled && passProfiler.isEnabled() && !options.native.enabled)
+        {
+            const Vector2i renderSize = renderer->renderSize();
+            ImGui::Text("Render size: %dx%d (%.0f%%)",
+                        renderSize.x(),
+                        renderSize.y(),
+                        renderer->renderScale() * 100.0f);
+        }
+
         if(paused)
             ImGui::TextColored(ImVec4(Color4::yellow()), "PAUSED");
 
@@ -665,7 +566,7 @@ void Mosaiikki::buildUI()
             Vector2 uv = (Vector2(ImGui::GetMousePos()) + Vector2(0.5f)) / screenSize;
             uv.y() = 1.0f - uv.y();
             const Range2D range = Range2D::fromCenter(uv, imageSize / screenSize / zoom * 0.5f);
-            ImGuiIntegration::image(outputColorAttachment, imageSize, range);
+            ImGuiIntegration::image(outputColorAttachment(), imageSize, range);
 
             ImGui::SetMouseCursor(ImGuiMouseCursor_None);
 
@@ -675,15 +576,5 @@ void Mosaiikki::buildUI()
         ImGui::End();
     }
 
-    for(size_t i = 0; i < scene->meshAnimables.size(); i++)
-    {
-        scene->meshAnimables[i].setState(options.scene.animatedObjects ? SceneGraph::AnimationState::Running
-                                                                       : SceneGraph::AnimationState::Paused);
-    }
-
-    for(size_t i = 0; i < scene->cameraAnimables.size(); i++)
-    {
-        scene->cameraAnimables[0].setState(options.scene.animatedCamera ? SceneGraph::AnimationState::Running
-                                                                        : SceneGraph::AnimationState::Paused);
-    }
+    scene->applyOptions(options.scene);
 }
@@ -3,14 +3,13 @@
 #include "ImGuiApplication.h"
 #include "Options.h"
 #include "Scene.h"
-#include "Shaders/ReconstructionShader.h"
-#include "Shaders/DepthBlitShader.h"
+#include "CheckerboardRenderer.h"
+#include "NativeRenderer.h"
+#include "GpuProfiler.h"
+#include "DynamicResolution.h"
+#include "FramePacer.h"
+#include "SharedMemoryOutput.h"
 #include <Magnum/Timeline.h>
-#include <Magnum/GL/GL.h>
-#include <Magnum/GL/Framebuffer.h>
-#include <Magnum/GL/Texture.h>
-#include <Magnum/GL/MultisampleTexture.h>
-#include <Magnum/GL/Renderbuffer.h>
 #include <Magnum/DebugTools/FrameProfiler.h>
 #include <Magnum/Math/Color.h>
 #include <Corrade/Utility/Debug.h>
@@ -30,9 +29,19 @@ private:
     virtual void keyReleaseEvent(KeyEvent& event) override;
     virtual void buildUI() override;
 
-    void updateProjectionMatrix(Magnum::SceneGraph::Camera3D& camera);
-    void resizeFramebuffers(Magnum::Vector2i frameBufferSize);
-    void setSamplePositions();
+    // output of the renderer used for the last frame
+    Magnum::GL::Framebuffer& outputFramebuffer();
+    Magnum::GL::Texture2D& outputColorAttachment();
+    enum class FrameRenderer : Magnum::UnsignedByte
+    {
+        None, // paused
+        Checkerboard,
+        Native
+    };
+
+    // average GPU time of the rendering passes over the frame history, without the UI
+    // keeps the last value of a renderer while the other one is active, 0 if it never ran
+    Magnum::Double renderGpuTime(FrameRenderer frameRenderer);
 
     // debug output
 
@@ -45,13 +54,15 @@ private:
     Corrade::Containers::Pointer<Corrade::Utility::Error> _error;
 
     Magnum::DebugTools::FrameProfilerGL profiler;
+    // per-pass GPU times
+    GpuProfiler passProfiler;
+    // frames in flight, frame rate limit and latency
+    FramePacer framePacer;
 
     // scene
 
     Corrade::Containers::Pointer<Scene> scene;
 
-    Magnum::GL::Mesh fullscreenTriangle;
-
     Magnum::Timeline timeline;
 
     bool paused = false;
@@ -61,25 +72,18 @@ private:
 
     // checkerboard rendering
 
-    Magnum::GL::Framebuffer velocityFramebuffer;
-    Magnum::GL::Texture2D velocityAttachment;
-    Magnum::GL::Texture2D velocityDepthAttachment;
-
-    static constexpr size_t FRAMES = 2;
-    static constexpr size_t JITTERED_FRAME = 1;
-    size_t currentFrame = 0;
-
-    // quarter-size framebuffers (half width, half height)
-    Magnum::GL::Framebuffer framebuffers[FRAMES];
-    Magnum::GL::MultisampleTexture2DArray colorAttachments;
-    Magnum::GL::MultisampleTexture2DArray depthAttachments;
-
-    DepthBlitShader depthBlitShader;
+    Corrade::Containers::Pointer<CheckerboardRenderer> renderer;
+    DynamicResolution dynamicResolution;
 
-    Magnum::GL::Framebuffer outputFramebuffer;
-    Magnum::GL::Texture2D outputColorAttachment;
+    // native full-res rendering, created when it's first enabled
+    Corrade::Containers::Pointer<NativeRenderer> nativeRenderer;
+    // renderer of each profiler frame, indexed by frame % size
+    // has to cover the profiler history and the frames still pending
+    FrameRenderer frameRenderers[128] = {};
+    Magnum::Double lastGpuTimes[3] = {};
 
-    ReconstructionShader reconstructionShader;
+    // resolved frames for other processes, nullptr if disabled
+    Corrade::Containers::Pointer<SharedMemoryOutput> sharedOutput;
 
     Options options;
 };
@@ -0,0 +1,658 @@
+#include "MosaiikkiBenchmark.h"
+
+#include "Shaders/ProgramCache.h"
+#include <Magnum/GL/Context.h>
+#include <Magnum/GL/Extensions.h>
+#include <Magnum/GL/Renderer.h>
+#include <Magnum/GL/TimeQuery.h>
+#include <Magnum/Math/ConfigurationValue.h>
+#include <Corrade/Containers/Array.h>
+#include <Corrade/Containers/GrowableArray.h>
+#include <Corrade/Containers/StringView.h>
+#include <Corrade/Containers/StringStl.h>
+#include <Corrade/Utility/Arguments.h>
+#include <Corrade/Utility/Debug.h>
+#include <Corrade/Utility/DebugStl.h>
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+
+using namespace Magnum;
+using namespace Corrade;
+
+const char* MosaiikkiBenchmark::NAME = "mosaiikki-benchmark";
+
+namespace
+{
+struct Statistics
+{
+    Double mean = 0.0;
+    Double min = 0.0;
+    Double max = 0.0;
+    Double median = 0.0;
+    Double p95 = 0.0;
+};
+
+Statistics calculateStatistics(Containers::ArrayView<const Double> values)
+{
+    Statistics result;
+    if(values.isEmpty())
+        return result;
+
+    Containers::Array<Double> sorted(NoInit, values.size());
+    std::copy(values.begin(), values.end(), sorted.begin());
+    std::sort(sorted.begin(), sorted.end());
+
+    Double sum = 0.0;
+    for(Double value : sorted)
+        sum += value;
+
+    result.mean = sum / sorted.size();
+    result.min = sorted.front();
+    result.max = sorted.back();
+    result.median = sorted[sorted.size() / 2];
+    result.p95 = sorted[std::min(sorted.size() - 1, size_t(sorted.size() * 0.95))];
+    return result;
+}
+
+std::string jsonString(Containers::StringView string)
+{
+    std::string result = "\"";
+    for(char c : string)
+    {
+        if(c == '"' || c == '\\')
+            result += '\\';
+        result += c;
+    }
+    result += '"';
+    return result;
+}
+
+void writeStatistics(std::ostream& out, Containers::StringView name, const Statistics& statistics, bool last = false)
+{
+    out << "    " << jsonString(name) << ": { "
+        << "\"mean\": " << statistics.mean << ", "
+        << "\"min\": " << statistics.min << ", "
+        << "\"max\": " << statistics.max << ", "
+        << "\"median\": " << statistics.median << ", "
+        << "\"p95\": " << statistics.p95 << " }" << (last ? "\n" : ",\n");
+}
+
+// drop negative values of frames where a pass wasn't measured
+Containers::Array<Double> validTimes(Containers::ArrayView<const Double> values)
+{
+    Containers::Array<Double> result;
+    for(Double value : values)
+    {
+        if(value >= 0.0)
+            arrayAppend(result, value);
+    }
+    return result;
+}
+
+Containers::Array<Double> scaleValues(Containers::ArrayView<const Float> scales)
+{
+    Containers::Array<Double> result(NoInit, scales.size());
+    for(size_t i = 0; i < scales.size(); i++)
+        result[i] = scales[i];
+    return result;
+}
+
+Containers::Array<Double> qualityValues(Containers::ArrayView<const ImageComparison::Result> results,
+                                        Double ImageComparison::Result::*metric)
+{
+    Containers::Array<Double> result(NoInit, results.size());
+    for(size_t i = 0; i < results.size(); i++)
+        result[i] = results[i].*metric;
+    return result;
+}
+} // namespace
+
+MosaiikkiBenchmark::MosaiikkiBenchmark(const Arguments& arguments) :
+    Platform::WindowlessApplication(arguments, NoCreate)
+{
+    // Command line
+
+    Utility::Arguments args;
+    args.addOption("frames", "600")
+        .setHelp("frames", "number of measured frames", "N")
+        .addOption("warmup", "60")
+        .setHelp("warmup", "number of frames rendered before measuring", "N")
+        .addOption("size", "1920 1080")
+        .setHelp("size", "framebuffer size, odd dimensions are rounded up", "\"X Y\"")
+        .addOption("timestep", "0.0166667")
+        .setHelp("timestep", "animation time step per frame in seconds", "SECONDS")
+        .addOption('o', "output", "mosaiikki-benchmark.json")
+        .setHelp("output", "JSON file to write timings to", "FILE")
+        .addOption("passes-csv", "")
+        .setHelp("passes-csv", "CSV file to write per-pass GPU timings to", "FILE")
+        .addOption("capture", "")
+        .setHelp("capture",
+                 "write measured frames to an image sequence (numbered before the extension, e.g. frames/frame.png) "
+                 "or a .y4m stream",
+                 "PATH")
+        .addBooleanOption("quality")
+        .setHelp("quality",
+                 "compare measured frames against native full-res rendering (PSNR, SSIM and a simplified FLIP), "
+                 "the reference is rendered after each measured frame, so no throughput is reported")
+        .addOption("quality-csv", "")
+        .setHelp("quality-csv", "CSV file to append a quality vs. GPU time summary of this run to, implies --quality",
+                 "FILE")
+        .addBooleanOption("static-objects")
+        .setHelp("static-objects", "don't animate objects")
+        .addBooleanOption("static-camera")
+        .setHelp("static-camera", "don't animate the camera")
+        .addBooleanOption("no-culling")
+        .setHelp("no-culling", "draw all instances without frustum culling")
+        .addBooleanOption("gpu-culling")
+        .setHelp("gpu-culling", "cull instances in a compute shader and draw them indirectly (requires GL 4.3)")
+        .addBooleanOption("no-occlusion-culling")
+        .setHelp("no-occlusion-culling", "don't occlusion cull against the velocity pass depth with GPU culling")
+        .addBooleanOption("no-velocity-buffer")
+        .setHelp("no-velocity-buffer", "reproject using the depth buffer instead of a velocity buffer")
+        .addBooleanOption("no-reuse-velocity-depth")
+        .setHelp("no-reuse-velocity-depth", "don't re-use the velocity pass depth for the quarter-res pass")
+        .addBooleanOption("assume-occlusion")
+        .setHelp("assume-occlusion", "always assume occlusion for pixels that moved")
+        .addOption("depth-tolerance", "0.01")
+        .setHelp("depth-tolerance", "view space depth difference before assuming occlusion", "DEPTH")
+        .addBooleanOption("no-differential-blending")
+        .setHelp("no-differential-blending", "average neighbors without differential blending")
+        .addOption("frame-cycle", "2")
+        .setHelp("frame-cycle", "frames until every full-res pixel is shaded, 2 (checkerboard) or 4", "N")
+        .addBooleanOption("compute-resolve")
+        .setHelp("compute-resolve", "resolve with the compute shader (requires GL 4.3)")
+        .addOption("frame-budget", "")
+        .setHelp("frame-budget", "scale the render size to keep GPU frame times within this budget", "MS")
+        .addOption("min-scale", "0.5")
+        .setHelp("min-scale", "smallest render scale with --frame-budget", "SCALE")
+        .addBooleanOption("native")
+        .setHelp("native", "render natively at full resolution without checkerboarding, as a baseline")
+        .addOption("msaa", "1")
+        .setHelp("msaa", "MSAA sample count of native rendering and the --quality reference", "N")
+        .addSkippedPrefix("magnum", "engine-specific options")
+        .setGlobalHelp("Headless benchmark of the checkerboard rendering pipeline.")
+        .parse(arguments.argc, arguments.argv);
+
+    // the checkerboard renderer rounds up to even sizes, native rendering, capture and the readbacks have to match
+    const Vector2i requestedSize = args.value<Vector2i>("size");
+    size = requestedSize + requestedSize % 2;
+    if(size != requestedSize)
+        Warning() << "Rounding --size up to even dimensions" << size;
+    frames = args.value<UnsignedInt>("frames");
+    warmupFrames = args.value<UnsignedInt>("warmup");
+    timestep = args.value<Float>("timestep");
+    outputFile = args.value<std::string>("output");
+    passesFile = args.value<std::string>("passes-csv");
+    captureFile = args.value<std::string>("capture");
+    qualityFile = args.value<std::string>("quality-csv");
+    quality = args.isSet("quality") || !qualityFile.empty();
+
+    options.scene.animatedObjects = !args.isSet("static-objects");
+    options.scene.animatedCamera = !args.isSet("static-camera");
+    options.scene.frustumCulling = !args.isSet("no-culling");
+    options.scene.gpuCulling = args.isSet("gpu-culling");
+    options.scene.occlusionCulling = !args.isSet("no-occlusion-culling");
+    options.reconstruction.createVelocityBuffer = !args.isSet("no-velocity-buffer");
+    options.reuseVelocityDepth = !args.isSet("no-reuse-velocity-depth");
+    options.reconstruction.assumeOcclusion = args.isSet("assume-occlusion");
+    options.reconstruction.depthTolerance = args.value<Float>("depth-tolerance");
+    options.reconstruction.differentialBlending = !args.isSet("no-differential-blending");
+    options.reconstruction.frames = args.value<Int>("frame-cycle");
+    options.computeResolve = args.isSet("compute-resolve");
+    options.dynamicResolution.enabled = !args.value<std::string>("frame-budget").empty();
+    if(options.dynamicResolution.enabled)
+        options.dynamicResolution.frameBudget = args.value<Float>("frame-budget");
+    options.dynamicResolution.minScale = args.value<Float>("min-scale");
+    options.native.enabled = args.isSet("native");
+    options.native.samples = args.value<Int>("msaa");
+
+    if(options.reconstruction.frames != 2 && options.reconstruction.frames != 4)
+    {
+        Warning() << "Frame cycle must be 2 or 4, using 2";
+        options.reconstruction.frames = 2;
+    }
+    if(options.native.enabled && quality)
+    {
+        Warning() << "--quality compares against native rendering, ignoring it with --native";
+        quality = false;
+        qualityFile.clear();
+    }
+    if(options.native.enabled && options.dynamicResolution.enabled)
+    {
+        Warning() << "Dynamic resolution only applies to checkerboard rendering, ignoring --frame-budget with --native";
+        options.dynamicResolution.enabled = false;
+    }
+
+    // GL context
+
+    createContext();
+
+    MAGNUM_ASSERT_GL_EXTENSION_SUPPORTED(GL::Extensions::ARB::timer_query); // core in 3.3
+
+    ProgramCache::setupParallelCompile();
+
+    // Checkerboard rendering
+
+    renderer.emplace(size);
+
+    if(options.computeResolve && !renderer->isComputeResolveSupported())
+    {
+        Warning() << "Compute resolve requires OpenGL 4.3, falling back to the fragment shader";
+        options.computeResolve = false;
+    }
+
+    // keep every frame, results are only read at the end
+    passProfiler.setup(warmupFrames + frames, 16);
+    renderer->setProfiler(&passProfiler);
+
+    // Scene
+
+    scene.emplace();
+    renderer->prepareScene(*scene);
+    scene->setViewport(size);
+    // measure rendering only, not the scene streaming in
+    scene->finishLoading();
+
+    if(options.scene.gpuCulling && !scene->isGpuCullingSupported())
+    {
+        Warning() << "GPU culling requires OpenGL 4.3, falling back to CPU culling";
+        options.scene.gpuCulling = false;
+    }
+
+    scene->applyOptions(options.scene);
+
+    // Native rendering
+
+    if(options.native.enabled || quality)
+    {
+        nativeRenderer.emplace(size);
+        // the --quality reference isn't part of the measured frame
+        if(options.native.enabled)
+            nativeRenderer->setProfiler(&passProfiler);
+        nativeRenderer->setSamples(options.native.samples);
+        if(nativeRenderer->samples() != options.native.samples)
+        {
+            Warning() << "MSAA with" << options.native.samples << "samples is not supported, using"
+                      << nativeRenderer->samples();
+            options.native.samples = nativeRenderer->samples();
+        }
+    }
+
+    // Quality measurement
+
+    if(quality)
+    {
+        readback.emplace(size);
+        referenceReadback.emplace(size);
+        comparison.emplace(size, scene->jobSystem.get());
+        referenceQueries = Containers::Array<GL::TimeQuery>(DirectInit, frames, GL::TimeQuery::Target::TimeElapsed);
+        referenceGpuTimes = Containers::Array<Double>(ValueInit, frames);
+        qualityResults = Containers::Array<ImageComparison::Result>(ValueInit, frames);
+    }
+}
+
+int MosaiikkiBenchmark::exec()
+{
+    typedef std::chrono::high_resolution_clock Clock;
+
+    if(frames == 0)
+    {
+        Error() << "Nothing to measure, --frames must be at least 1";
+        return 1;
+    }
+
+    Debug() << "Renderer:" << GL::Context::current().rendererString();
+    Debug() << "Rendering" << warmupFrames << "warmup frames and" << frames << "measured frames at" << size
+            << (options.native.enabled ? "natively" : "with checkerboarding");
+
+    Containers::Array<GL::TimeQuery> queries(DirectInit, frames, GL::TimeQuery::Target::TimeElapsed);
+    Containers::Array<Double> cpuTimes(ValueInit, frames);
+    Containers::Array<Double> gpuTimes(ValueInit, frames);
+    Containers::Array<Float> renderScales(ValueInit, frames);
+
+    Containers::Pointer<FrameCapture> capture;
+    if(!captureFile.empty())
+        capture.emplace(captureFile, size, 1.0 / timestep);
+
+    Float time = 0.0f;
+    Clock::time_point start = Clock::now();
+
+    for(size_t i = 0; i < warmupFrames + frames; i++)
+    {
+        const bool measured = i >= warmupFrames;
+        const size_t frame = i - warmupFrames;
+
+        if(i == warmupFrames)
+        {
+            // don't let queued warmup frames count towards the measured wall time
+            GL::Renderer::finish();
+            start = Clock::now();
+        }
+
+        const Clock::time_point frameStart = Clock::now();
+
+        scene->meshAnimables.step(time, timestep);
+        scene->cameraAnimables.step(time, timestep);
+
+        if(measured)
+            queries[frame].begin();
+        passProfiler.beginFrame();
+
+        GL::Framebuffer* output;
+        if(options.native.enabled)
+        {
+            if(measured)
+                renderScales[frame] = 1.0f;
+
+            nativeRenderer->draw(*scene, options);
+            output = &nativeRenderer->outputFramebuffer;
+        }
+        else
+        {
+            renderer->setRenderScale(dynamicResolution.update(passProfiler, options.dynamicResolution));
+            if(measured)
+                renderScales[frame] = renderer->renderScale();
+
+            renderer->draw(*scene, options);
+            output = &renderer->outputFramebuffer;
+        }
+
+        if(measured && capture)
+            capture->capture(*output);
+
+        passProfiler.endFrame();
+        if(measured)
+        {
+            queries[frame].end();
+            cpuTimes[frame] = std::chrono::duration<Double, std::milli>(Clock::now() - frameStart).count();
+        }
+
+        if(measured && quality)
+            renderReference(frame);
+
+        time += timestep;
+    }
+
+    GL::Renderer::finish();
+    const Double wallTime = std::chrono::duration<Double>(Clock::now() - start).count();
+
+    if(quality)
+    {
+        while(compareFrame(true)) { }
+    }
+
+    if(capture)
+    {
+        // rendering is done, the rest is the encoder catching up
+        const bool captured = capture->finish();
+        const Double captureTime = std::chrono::duration<Double>(Clock::now() - start).count();
+        Debug() << "Captured" << capture->writtenFrames() << "frames to" << captureFile.c_str() << "at"
+                << capture->writtenFrames() / captureTime << "fps";
+        if(!captured)
+        {
+            Error() << "Frame capture failed";
+            return 1;
+        }
+    }
+
+    // all queries are done after glFinish, reading them doesn't stall
+    for(size_t i = 0; i < frames; i++)
+        gpuTimes[i] = Double(queries[i].result<UnsignedLong>()) / 1.0e6;
+    for(size_t i = 0; i < referenceQueries.size(); i++)
+        referenceGpuTimes[i] = Double(referenceQueries[i].result<UnsignedLong>()) / 1.0e6;
+    passProfiler.flush();
+
+    if(passProfiler.droppedFrames() > 0)
+        Warning() << "Per-pass timings of" << passProfiler.droppedFrames() << "frames were dropped";
+
+    const Statistics cpu = calculateStatistics(cpuTimes);
+    const Statistics gpu = calculateStatistics(gpuTimes);
+    Debug() << "CPU frame time (ms): mean" << cpu.mean << "median" << cpu.median << "p95" << cpu.p95;
+    Debug() << "GPU frame time (ms): mean" << gpu.mean << "median" << gpu.median << "p95" << gpu.p95;
+    // the wall time includes the reference renders and readbacks, it says nothing about the measured pipeline
+    if(quality)
+        Debug() << "Throughput: not measured with --quality";
+    else
+        Debug() << "Throughput:" << frames / wallTime << "fps";
+
+    // per-pass times of measured frames, negative if the pass didn't run or the frame was dropped
+    const size_t passCount = passProfiler.passCount();
+    Containers::Array<Double> passTimes(DirectInit, passCount * frames, -1.0);
+    for(size_t i = 0; i < passProfiler.historyCount(); i++)
+    {
+        const GpuProfiler::FrameResult& result = passProfiler.historyFrame(i);
+        if(result.frame < warmupFrames)
+            continue;
+        for(size_t pass = 0; pass < passCount; pass++)
+            passTimes[pass * frames + result.frame - warmupFrames] = result.durations[pass];
+    }
+
+    for(size_t pass = 0; pass < passCount; pass++)
+    {
+        const Containers::Array<Double> times = validTimes(passTimes.slice(pass * frames, (pass + 1) * frames));
+        const Statistics statistics = calculateStatistics(times);
+        Debug() << passProfiler.passName(pass) << "(ms): mean" << statistics.mean << "median" << statistics.median
+                << "p95" << statistics.p95;
+    }
+
+    if(!passesFile.empty())
+    {
+        std::ofstream file(passesFile, std::ios::out | std::ios::trunc);
+        passProfiler.writeCsv(file);
+        if(!file.good())
+        {
+            Error() << "Can't write pass timings to" << passesFile.c_str();
+            return 1;
+        }
+    }
+
+    if(options.dynamicResolution.enabled)
+    {
+        const Statistics scale = calculateStatistics(scaleValues(renderScales));
+        Debug() << "Render scale: mean" << scale.mean << "min" << scale.min << "max" << scale.max;
+    }
+
+    if(quality)
+    {
+        const Statistics native = calculateStatistics(referenceGpuTimes);
+        const Statistics psnr = calculateStatistics(qualityValues(qualityResults, &ImageComparison::Result::psnr));
+        const Statistics ssim = calculateStatistics(qualityValues(qualityResults, &ImageComparison::Result::ssim));
+        const Statistics flip = calculateStatistics(qualityValues(qualityResults, &ImageComparison::Result::flip));
+        Debug() << "Native GPU frame time (ms): mean" << native.mean << "median" << native.median << "p95"
+                << native.p95;
+        Debug() << "PSNR (dB): mean" << psnr.mean << "min" << psnr.min;
+        Debug() << "SSIM: mean" << ssim.mean << "min" << ssim.min;
+        Debug() << "FLIP: mean" << flip.mean << "max" << flip.max;
+
+        if(!qualityFile.empty())
+        {
+            if(!appendQualityCsv(gpuTimes, renderScales))
+            {
+                Error() << "Can't write quality summary to" << qualityFile.c_str();
+                return 1;
+            }
+            Debug() << "Quality summary appended to" << qualityFile.c_str();
+        }
+    }
+
+    if(!writeResults(cpuTimes, gpuTimes, passTimes, renderScales, wallTime))
+        return 1;
+
+    Debug() << "Results written to" << outputFile.c_str();
+    return 0;
+}
+
+void MosaiikkiBenchmark::renderReference(size_t frame)
+{
+    while(compareFrame(false)) { }
+    if(readback->isFull())
+        compareFrame(true);
+
+    readback->read(renderer->outputFramebuffer);
+
+    // same animation state as the checkerboard frame that was just submitted
+    referenceQueries[frame].begin();
+    nativeRenderer->draw(*scene, options);
+    referenceQueries[frame].end();
+
+    referenceReadback->read(nativeRenderer->outputFramebuffer);
+}
+
+bool MosaiikkiBenchmark::compareFrame(bool wait)
+{
+    // the reference is read back last, once it's done the checkerboard frame is as well
+    if(!referenceReadback->acquire(wait))
+        return false;
+    CORRADE_INTERNAL_ASSERT_OUTPUT(readback->acquire(true));
+    CORRADE_INTERNAL_ASSERT(readback->frame() == referenceReadback->frame());
+
+    qualityResults[readback->frame()] = comparison->compare(readback->pixels(), referenceReadback->pixels());
+
+    readback->release();
+    referenceReadback->release();
+    return true;
+}
+
+bool MosaiikkiBenchmark::appendQualityCsv(Containers::ArrayView<const Double> gpuTimes,
+                                          Containers::ArrayView<const Float> renderScales) const
+{
+    // header only for a new file
+    const bool empty = std::ifstream(qualityFile, std::ios::in | std::ios::ate).tellg() <= 0;
+
+    std::ofstream file(qualityFile, std::ios::out | std::ios::app);
+    if(!file.good())
+        return false;
+
+    if(empty)
+        file << "width,height,createVelocityBuffer,reuseVelocityDepth,assumeOcclusion,depthTolerance,"
+                "differentialBlending,frameCycle,computeResolve,dynamicResolution,renderScale,msaaSamples,"
+                "gpu,nativeGpu,gpuRatio,psnr,psnrMin,ssim,ssimMin,flip,flipMax\n";
+
+    const Statistics gpu = calculateStatistics(gpuTimes);
+    const Statistics native = calculateStatistics(referenceGpuTimes);
+    const Statistics scale = calculateStatistics(scaleValues(renderScales));
+    const Statistics psnr = calculateStatistics(qualityValues(qualityResults, &ImageComparison::Result::psnr));
+    const Statistics ssim = calculateStatistics(qualityValues(qualityResults, &ImageComparison::Result::ssim));
+    const Statistics flip = calculateStatistics(qualityValues(qualityResults, &ImageComparison::Result::flip));
+
+    // GPU times are means in milliseconds
+    file << std::fixed << std::setprecision(4);
+    file << size.x() << "," << size.y() << "," << options.reconstruction.createVelocityBuffer << ","
+         << options.reuseVelocityDepth << "," << options.reconstruction.assumeOcclusion << ","
+         << options.reconstruction.depthTolerance << "," << options.reconstruction.differentialBlending << ","
+         << options.reconstruction.frames << "," << options.computeResolve << ","
+         << options.dynamicResolution.enabled << "," << scale.mean << "," << options.native.samples << ","
+         << gpu.mean << "," << native.mean << "," << (native.mean > 0.0 ? gpu.mean / native.mean : 0.0) << ","
+         << psnr.mean << "," << psnr.min << "," << ssim.mean << "," << ssim.min << "," << flip.mean << ","
+         << flip.max << "\n";
+
+    return file.good();
+}
+
+bool MosaiikkiBenchmark::writeResults(Containers::ArrayView<const Double> cpuTimes,
+                                      Containers::ArrayView<const Double> gpuTimes,
+                                      Containers::ArrayView<const Double> passTimes,
+                                      Containers::ArrayView<const Float> renderScales,
+                                      Double wallTime) const
+{
+    std::ofstream file(outputFile, std::ios::out | std::ios::trunc);
+    if(!file.good())
+    {
+        Error() << "Can't open" << outputFile.c_str() << "for writing";
+        return false;
+    }
+
+    GL::Context& context = GL::Context::current();
+
+    file << std::fixed << std::setprecision(4);
+    file << "{\n";
+    file << "  \"application\": " << jsonString(NAME) << ",\n";
+    file << "  \"renderer\": " << jsonString(context.rendererString()) << ",\n";
+    file << "  \"vendor\": " << jsonString(context.vendorString()) << ",\n";
+    file << "  \"version\": " << jsonString(context.versionString()) << ",\n";
+    file << "  \"size\": [" << size.x() << ", " << size.y() << "],\n";
+    file << "  \"frames\": " << frames << ",\n";
+    file << "  \"warmupFrames\": " << warmupFrames << ",\n";
+    file << "  \"timestep\": " << timestep << ",\n";
+
+    file << "  \"options\": {\n";
+    file << "    \"animatedObjects\": " << (options.scene.animatedObjects ? "true" : "false") << ",\n";
+    file << "    \"animatedCamera\": " << (options.scene.animatedCamera ? "true" : "false") << ",\n";
+    file << "    \"frustumCulling\": " << (options.scene.frustumCulling ? "true" : "false") << ",\n";
+    file << "    \"gpuCulling\": " << (options.scene.gpuCulling ? "true" : "false") << ",\n";
+    file << "    \"occlusionCulling\": " << (options.scene.occlusionCulling ? "true" : "false") << ",\n";
+    file << "    \"reuseVelocityDepth\": " << (options.reuseVelocityDepth ? "true" : "false") << ",\n";
+    file << "    \"computeResolve\": " << (options.computeResolve ? "true" : "false") << ",\n";
+    file << "    \"createVelocityBuffer\": " << (options.reconstruction.createVelocityBuffer ? "true" : "false")
+         << ",\n";
+    file << "    \"assumeOcclusion\": " << (options.reconstruction.assumeOcclusion ? "true" : "false") << ",\n";
+    file << "    \"depthTolerance\": " << options.reconstruction.depthTolerance << ",\n";
+    file << "    \"differentialBlending\": " << (options.reconstruction.differentialBlending ? "true" : "false")
+         << ",\n";
+    file << "    \"frameCycle\": " << options.reconstruction.frames << ",\n";
+    file << "    \"dynamicResolution\": " << (options.dynamicResolution.enabled ? "true" : "false") << ",\n";
+    file << "    \"frameBudget\": " << options.dynamicResolution.frameBudget << ",\n";
+    file << "    \"minScale\": " << options.dynamicResolution.minScale << ",\n";
+    file << "    \"native\": " << (options.native.enabled ? "true" : "false") << ",\n";
+    file << "    \"msaaSamples\": " << options.native.samples << ",\n";
+    file << "    \"quality\": " << (quality ? "true" : "false") << "\n";
+    file << "  },\n";
+
+    file << "  \"aggregate\": {\n";
+    file << "    \"wallTime\": " << wallTime << ",\n";
+    if(quality)
+        file << "    \"fps\": null,\n";
+    else
+        file << "    \"fps\": " << frames / wallTime << ",\n";
+    writeStatistics(file, "cpu", calculateStatistics(cpuTimes));
+    writeStatistics(file, "gpu", calculateStatistics(gpuTimes));
+    writeStatistics(file, "renderScale", calculateStatistics(scaleValues(renderScales)));
+    if(quality)
+    {
+        writeStatistics(file, "nativeGpu", calculateStatistics(referenceGpuTimes));
+        writeStatistics(
+            file, "psnr", calculateStatistics(qualityValues(qualityResults, &ImageComparison::Result::psnr)));
+        writeStatistics(
+            file, "ssim", calculateStatistics(qualityValues(qualityResults, &ImageComparison::Result::ssim)));
+        writeStatistics(
+            file, "flip", calculateStatistics(qualityValues(qualityResults, &ImageComparison::Result::flip)));
+    }
+    file << "    \"passes\": {\n";
+    for(size_t pass = 0; pass < passProfiler.passCount(); pass++)
+    {
+        const Containers::Array<Double> times = validTimes(passTimes.slice(pass * frames, (pass + 1) * frames));
+        file << "  ";
+        writeStatistics(file, passProfiler.passName(pass), calculateStatistics(times),
+                        pass + 1 == passProfiler.passCount());
+    }
+    file << "    }\n";
+    file << "  },\n";
+
+    // times in milliseconds
+    file << "  \"perFrame\": [\n";
+    for(size_t i = 0; i < frames; i++)
+    {
+        file << "    { \"cpu\": " << cpuTimes[i] << ", \"gpu\": " << gpuTimes[i] << ", \"renderScale\": "
+             << renderScales[i];
+        if(quality)
+            file << ", \"nativeGpu\": " << referenceGpuTimes[i] << ", \"psnr\": " << qualityResults[i].psnr
+                 << ", \"ssim\": " << qualityResults[i].ssim << ", \"flip\": " << qualityResults[i].flip;
+        file << ", \"passes\": {";
+        bool first = true;
+        for(size_t pass = 0; pass < passProfiler.passCount(); pass++)
+        {
+            const Double time = passTimes[pass * frames + i];
+            if(time < 0.0)
+                continue;
+            file << (first ? " " : ", ") << jsonString(passProfiler.passName(pass)) << ": " << time;
+            first = false;
+        }
+        file << " } }" << (i + 1 < frames ? ",\n" : "\n");
+    }
+    file << "  ]\n";
+    file << "}\n";
+
+    return file.good();
+}
@@ -0,0 +1,88 @@
+#pragma once
+
+#include "Options.h"
+#include "Scene.h"
+#include "CheckerboardRenderer.h"
+#include "GpuProfiler.h"
+#include "DynamicResolution.h"
+#include "FrameCapture.h"
+#include "FrameReadback.h"
+#include "NativeRenderer.h"
+#include "ImageComparison.h"
+#include <Magnum/GL/TimeQuery.h>
+#include <Corrade/Containers/Array.h>
+#include <Corrade/Containers/ArrayView.h>
+#include <Corrade/Containers/Pointer.h>
+#include <string>
+
+#ifdef CORRADE_TARGET_APPLE
+#include <Magnum/Platform/WindowlessCglApplication.h>
+#elif defined(CORRADE_TARGET_WINDOWS)
+#include <Magnum/Platform/WindowlessWglApplication.h>
+#else
+#include <Magnum/Platform/WindowlessEglApplication.h>
+#endif
+
+// headless benchmark
+// renders a fixed number of frames with the checkerboard pipeline into an offscreen framebuffer
+// and writes per-frame and aggregate timings to a JSON file
+// with --quality, every measured frame is also rendered natively at full resolution
+// and the checkerboard output is compared against it
+class MosaiikkiBenchmark : public Magnum::Platform::WindowlessApplication
+{
+public:
+    explicit MosaiikkiBenchmark(const Arguments& arguments);
+
+    virtual int exec() override;
+
+    static const char* NAME;
+
+private:
+    // render the native reference of the current animation state and queue both outputs for readback
+    void renderReference(size_t frame);
+    // compare the oldest frame whose readbacks finished, with wait block until there is one
+    // returns false if no frame is pending
+    bool compareFrame(bool wait);
+    // one row per run, so multiple runs with different options build a table
+    bool appendQualityCsv(Corrade::Containers::ArrayView<const Magnum::Double> gpuTimes,
+                          Corrade::Containers::ArrayView<const Magnum::Float> renderScales) const;
+
+    // per-frame times in milliseconds, wall time in seconds
+    bool writeResults(Corrade::Containers::ArrayView<const Magnum::Double> cpuTimes,
+                      Corrade::Containers::ArrayView<const Magnum::Double> gpuTimes,
+                      // pass-major, negative if not measured
+                      Corrade::Containers::ArrayView<const Magnum::Double> passTimes,
+                      Corrade::Containers::ArrayView<const Magnum::Float> renderScales,
+                      Magnum::Double wallTime) const;
+
+    Corrade::Containers::Pointer<Scene> scene;
+    Corrade::Containers::Pointer<CheckerboardRenderer> renderer;
+    GpuProfiler passProfiler;
+    DynamicResolution dynamicResolution;
+
+    Options options;
+
+    Magnum::Vector2i size;
+    size_t frames = 0;
+    size_t warmupFrames = 0;
+    // fixed animation time step in seconds, makes runs reproducible
+    Magnum::Float timestep = 0.0f;
+    std::string outputFile;
+    // optional CSV with per-pass GPU times
+    std::string passesFile;
+    // optional image sequence or Y4M stream of the measured frames
+    std::string captureFile;
+
+    // image quality against native rendering
+    bool quality = false;
+    // optional CSV the quality and GPU time summary is appended to
+    std::string qualityFile;
+    Corrade::Containers::Pointer<NativeRenderer> nativeRenderer;
+    Corrade::Containers::Pointer<FrameReadback> readback;
+    Corrade::Containers::Pointer<FrameReadback> referenceReadback;
+    Corrade::Containers::Pointer<ImageComparison> comparison;
+    // per measured frame, GPU times in milliseconds
+    Corrade::Containers::Array<Magnum::GL::TimeQuery> referenceQueries;
+    Corrade::Containers::Array<Magnum::Double> referenceGpuTimes;
+    Corrade::Containers::Array<ImageComparison::Result> qualityResults;
+};
@@ -0,0 +1,165 @@
+#include "NativeRenderer.h"
+
+#include "Scene.h"
+#include <Magnum/GL/DebugOutput.h>
+#include <Magnum/GL/RenderbufferFormat.h>
+#include <Magnum/GL/TextureFormat.h>
+#include <Magnum/GL/Renderer.h>
+#include <Magnum/Math/Color.h>
+#include <Magnum/Shaders/GenericGL.h>
+#include <Magnum/Math/Functions.h>
+#include <Corrade/Utility/Assert.h>
+#include <Corrade/Utility/Format.h>
+#include <Corrade/Containers/String.h>
+
+using namespace Magnum;
+using namespace Corrade;
+using namespace Magnum::Math::Literals;
+
+namespace
+{
+void setLodBias(Scene& scene, Float bias)
+{
+    for(Containers::Pointer<GL::Texture2D>& texture : scene.textures)
+    {
+        if(texture)
+            texture->setLodBias(bias);
+    }
+}
+} // namespace
+
+NativeRenderer::NativeRenderer(Vector2i size) :
+    outputFramebuffer(NoCreate),
+    outputColorAttachment(NoCreate),
+    depthAttachment(NoCreate),
+    multisampleFramebuffer(NoCreate),
+    multisampleColorAttachment(NoCreate),
+    multisampleDepthAttachment(NoCreate)
+{
+    resizeFramebuffers(size);
+}
+
+void NativeRenderer::resizeFramebuffers(Vector2i size)
+{
+    this->size = size;
+
+    outputColorAttachment = GL::Texture2D();
+    outputColorAttachment.setStorage(1, GL::TextureFormat::RGBA8, size);
+    // filter and wrapping for zoomed GUI debug output
+    outputColorAttachment.setMagnificationFilter(SamplerFilter::Nearest);
+    outputColorAttachment.setWrapping({ GL::SamplerWrapping::ClampToBorder, GL::SamplerWrapping::ClampToBorder });
+    outputColorAttachment.setBorderColor(0x000000_rgbf);
+    outputColorAttachment.setLabel("Native output color texture");
+
+    // never sampled
+    depthAttachment = GL::Renderbuffer();
+    depthAttachment.setStorage(GL::RenderbufferFormat::DepthComponent24, size);
+    depthAttachment.setLabel("Native depth renderbuffer");
+
+    outputFramebuffer = GL::Framebuffer({ { 0, 0 }, size });
+    outputFramebuffer.attachTexture(GL::Framebuffer::ColorAttachment(0), outputColorAttachment, 0 /* level */);
+    outputFramebuffer.attachRenderbuffer(GL::Framebuffer::BufferAttachment::Depth, depthAttachment);
+    outputFramebuffer.mapForDraw({ { Shaders::GenericGL3D::ColorOutput, GL::Framebuffer::ColorAttachment(0) } });
+    outputFramebuffer.setLabel("Native output framebuffer");
+
+    CORRADE_INTERNAL_ASSERT(outputFramebuffer.checkStatus(GL::FramebufferTarget::Read) ==
+                            GL::Framebuffer::Status::Complete);
+    CORRADE_INTERNAL_ASSERT(outputFramebuffer.checkStatus(GL::FramebufferTarget::Draw) ==
+                            GL::Framebuffer::Status::Complete);
+
+    if(_samples > 1)
+        createMultisampleFramebuffer();
+}
+
+void NativeRenderer::setSamples(Int samples)
+{
+    samples = Math::clamp(samples, 1, GL::Renderbuffer::maxSamples());
+    if(samples == _samples)
+        return;
+
+    _samples = samples;
+    if(_samples > 1)
+        createMultisampleFramebuffer();
+    else
+    {
+        multisampleFramebuffer = GL::Framebuffer(NoCreate);
+        multisampleColorAttachment = GL::Renderbuffer(NoCreate);
+        multisampleDepthAttachment = GL::Renderbuffer(NoCreate);
+    }
+}
+
+void NativeRenderer::createMultisampleFramebuffer()
+{
+    multisampleColorAttachment = GL::Renderbuffer();
+    multisampleColorAttachment.setStorageMultisample(_samples, GL::RenderbufferFormat::RGBA8, size);
+    multisampleColorAttachment.setLabel(Utility::format("Native color renderbuffer ({}x MSAA)", _samples));
+    multisampleDepthAttachment = GL::Renderbuffer();
+    multisampleDepthAttachment.setStorageMultisample(_samples, GL::RenderbufferFormat::DepthComponent24, size);
+    multisampleDepthAttachment.setLabel(Utility::format("Native depth renderbuffer ({}x MSAA)", _samples));
+
+    multisampleFramebuffer = GL::Framebuffer({ { 0, 0 }, size });
+    multisampleFramebuffer.attachRenderbuffer(GL::Framebuffer::ColorAttachment(0), multisampleColorAttachment);
+    multisampleFramebuffer.attachRenderbuffer(GL::Framebuffer::BufferAttachment::Depth, multisampleDepthAttachment);
+    multisampleFramebuffer.mapForDraw(
+        { { Shaders::GenericGL3D::ColorOutput, GL::Framebuffer::ColorAttachment(0) } });
+    multisampleFramebuffer.setLabel("Native framebuffer (MSAA)");
+
+    CORRADE_INTERNAL_ASSERT(multisampleFramebuffer.checkStatus(GL::FramebufferTarget::Read) ==
+                            GL::Framebuffer::Status::Complete);
+    CORRADE_INTERNAL_ASSERT(multisampleFramebuffer.checkStatus(GL::FramebufferTarget::Draw) ==
+                            GL::Framebuffer::Status::Complete);
+}
+
+void NativeRenderer::draw(Scene& scene, const Options& options)
+{
+    setSamples(options.native.samples);
+
+    GL::Renderer::enable(GL::Renderer::Feature::FaceCulling);
+    GL::Renderer::enable(GL::Renderer::Feature::DepthTest);
+    GL::Renderer::setDepthFunction(GL::Renderer::DepthFunction::LessOrEqual);
+
+    GL::Renderer::setBlendEquation(GL::Renderer::BlendEquation::Add, GL::Renderer::BlendEquation::Add);
+    GL::Renderer::setBlendFunction(GL::Renderer::BlendFunction::SourceAlpha,
+                                   GL::Renderer::BlendFunction::OneMinusSourceAlpha);
+
+    scene.streamingBuffer.beginFrame();
+    scene.prepareInstances();
+
+    // the scene's LOD bias compensates for quarter-res rendering, sample textures like a normal renderer would
+    // textures are shared with the checkerboard renderer, so switch it only for this pass
+    setLodBias(scene, 0.0f);
+
+    {
+        GL::DebugGroup group(GL::DebugGroup::Source::Application, 0, "Scene rendering (native)");
+        GpuProfiler::Scope scope(profiler, "Scene rendering (native)");
+
+        GL::Framebuffer& framebuffer = _samples > 1 ? multisampleFramebuffer : outputFramebuffer;
+        framebuffer.bind();
+        framebuffer.clearDepth(1.0f);
+        // same as the checkerboard pass
+        const Color4 clearColor = Color4::fromSrgb(0x772953_rgbf);
+        framebuffer.clearColor(0, clearColor);
+
+        GL::Renderer::enable(GL::Renderer::Feature::Blending);
+
+        scene.drawQueue(RenderQueue::Pass::Color, RenderQueue::Layer::Opaque);
+        scene.drawQueue(RenderQueue::Pass::Color, RenderQueue::Layer::Transparent);
+
+        GL::Renderer::disable(GL::Renderer::Feature::Blending);
+    }
+
+    if(_samples > 1)
+    {
+        GL::DebugGroup group(GL::DebugGroup::Source::Application, 1, "MSAA resolve");
+        GpuProfiler::Scope scope(profiler, "MSAA resolve");
+
+        GL::Framebuffer::blit(multisampleFramebuffer,
+                              outputFramebuffer,
+                              multisampleFramebuffer.viewport(),
+                              GL::FramebufferBlit::Color);
+    }
+
+    setLodBias(scene, scene.textureLodBias);
+
+    scene.streamingBuffer.endFrame();
+}
@@ -0,0 +1,63 @@
+#pragma once
+
+#include "Options.h"
+#include "GpuProfiler.h"
+#include <Magnum/GL/GL.h>
+#include <Magnum/GL/Framebuffer.h>
+#include <Magnum/GL/Texture.h>
+#include <Magnum/GL/Renderbuffer.h>
+
+class Scene;
+
+// renders the scene directly at full resolution without checkerboarding
+// same scene pass as CheckerboardRenderer, but no LOD bias and optionally with MSAA,
+// used as the quality reference and cost baseline
+class NativeRenderer
+{
+public:
+    explicit NativeRenderer(Magnum::Vector2i size);
+
+    // Copying is not allowed
+    NativeRenderer(const NativeRenderer&) = delete;
+    NativeRenderer& operator=(const NativeRenderer&) = delete;
+
+    void resizeFramebuffers(Magnum::Vector2i size);
+
+    // MSAA sample count, 1 renders directly into outputFramebuffer
+    // clamped to what the implementation supports
+    void setSamples(Magnum::Int samples);
+
+    Magnum::Int samples() const
+    {
+        return _samples;
+    }
+
+    // measure each pass with the given profiler, nullptr disables it
+    // frames have to be started and ended by the caller
+    void setProfiler(GpuProfiler* profiler)
+    {
+        this->profiler = profiler;
+    }
+
+    // render one frame with Options::Native::samples, animation has to be stepped before calling this
+    void draw(Scene& scene, const Options& options);
+
+    // full-res output, same format as CheckerboardRenderer::outputFramebuffer
+    Magnum::GL::Framebuffer outputFramebuffer;
+    Magnum::GL::Texture2D outputColorAttachment;
+
+private:
+    void createMultisampleFramebuffer();
+
+    GpuProfiler* profiler = nullptr;
+
+    Magnum::Vector2i size;
+    Magnum::Int _samples = 1;
+
+    Magnum::GL::Renderbuffer depthAttachment;
+
+    // render target with MSAA, resolved into outputFramebuffer
+    Magnum::GL::Framebuffer multisampleFramebuffer;
+    Magnum::GL::Renderbuffer multisampleColorAttachment;
+    Magnum::GL::Renderbuffer multisampleDepthAttachment;
+};
@@ -3,11 +3,15 @@
 struct Options
 {
     bool reuseVelocityDepth = true; // depends on createVelocityBuffer
+    bool computeResolve = false;    // requires GL 4.3
 
     struct Scene
     {
         bool animatedObjects = false;
         bool animatedCamera = false;
+        bool frustumCulling = true;
+        bool gpuCulling = false;      // requires GL 4.3
+        bool occlusionCulling = true; // depends on gpuCulling and createVelocityBuffer
     } scene;
 
     struct Reconstruction
@@ -16,6 +20,7 @@ struct Options
         bool assumeOcclusion = false;
         float depthTolerance = 0.01f;
         bool differentialBlending = true;
+        int frames = 2; // frame cycle length, 2 = checkerboard, 4 = one sample per quarter-res pixel and frame
 
         struct Debug
         {
@@ -31,4 +36,23 @@ struct Options
             bool showColors = false;
         } debug;
     } reconstruction;
+
+    struct DynamicResolution
+    {
+        bool enabled = false;      // requires ARB_timer_query
+        float frameBudget = 16.6f; // GPU milliseconds per frame
+        float minScale = 0.5f;     // of the framebuffer size in each dimension
+    } dynamicResolution;
+
+    struct FramePacing
+    {
+        int maxFramesInFlight = 2;   // 0 = unlimited
+        float frameRateLimit = 0.0f; // frames per second, 0 = unlimited
+    } framePacing;
+
+    struct Native
+    {
+        bool enabled = false; // full-res rendering without checkerboarding, as a baseline
+        int samples = 1;      // MSAA sample count, 1 = off
+    } native;
 };
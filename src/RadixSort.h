@@ -0,0 +1,61 @@
+#pragma once
+
+#include <Magnum/Magnum.h>
+#include <Corrade/Containers/ArrayView.h>
+#include <Corrade/Utility/Assert.h>
+#include <algorithm>
+#include <type_traits>
+#include <utility>
+
+// stable LSD radix sort by an unsigned integer key, 8 bits per pass
+// key(item) returns the key, all passes are counted in a single pass over the items
+// passes where every key has the same byte (e.g. unused high bits) are skipped
+// scratch must have at least items.size() elements, the sorted result ends up in items
+template<typename T, typename F>
+void radixSort(Corrade::Containers::ArrayView<T> items, Corrade::Containers::ArrayView<T> scratch, F key)
+{
+    typedef typename std::decay<decltype(key(std::declval<const T&>()))>::type Key;
+    static_assert(std::is_unsigned<Key>::value, "radixSort(): key must be an unsigned integer");
+    constexpr size_t Passes = sizeof(Key);
+
+    CORRADE_ASSERT(scratch.size() >= items.size(), "radixSort(): scratch is too small", );
+
+    const size_t count = items.size();
+    if(count < 2)
+        return;
+
+    size_t histograms[Passes][256] = {};
+    for(const T& item : items)
+    {
+        const Key value = key(item);
+        for(size_t pass = 0; pass < Passes; pass++)
+            histograms[pass][(value >> (pass * 8)) & 0xff]++;
+    }
+
+    T* source = items.data();
+    T* destination = scratch.data();
+    for(size_t pass = 0; pass < Passes; pass++)
+    {
+        size_t* histogram = histograms[pass];
+        const size_t shift = pass * 8;
+        if(histogram[(key(source[0]) >> shift) & 0xff] == count)
+            continue;
+
+        // exclusive prefix sum = first output index of each bucket
+        size_t offset = 0;
+        for(size_t i = 0; i < 256; i++)
+        {
+            const size_t bucket = histogram[i];
+            histogram[i] = offset;
+            offset += bucket;
+        }
+
+        for(size_t i = 0; i < count; i++)
+            destination[histogram[(key(source[i]) >> shift) & 0xff]++] = source[i];
+
+        std::swap(source, destination);
+    }
+
+    if(source != items.data())
+        std::copy(source, source + count, items.data());
+}
@@ -0,0 +1,99 @@
+#include "RenderQueue.h"
+
+#include "RadixSort.h"
+#include <Magnum/Math/Functions.h>
+#include <Corrade/Utility/Assert.h>
+#include <algorithm>
+#include <cstring>
+
+using namespace Magnum;
+using namespace Corrade;
+
+namespace
+{
+
+constexpr UnsignedInt PassShift = 62;
+constexpr UnsignedInt LayerShift = 61;
+
+constexpr UnsignedLong mask(UnsignedInt bits)
+{
+    return (UnsignedLong(1) << bits) - 1;
+}
+
+// positive floats compare like their bit patterns, keep the most significant bits
+UnsignedLong depthBits(Float depth)
+{
+    depth = Math::max(depth, 0.0f);
+    UnsignedInt bits;
+    std::memcpy(&bits, &depth, sizeof(bits));
+    return bits >> (32 - RenderQueue::DepthBits);
+}
+
+}
+
+UnsignedLong RenderQueue::key(
+    Pass pass, Layer layer, UnsignedInt shader, UnsignedInt material, UnsignedInt mesh, Float depth)
+{
+    UnsignedLong key = (UnsignedLong(pass) << PassShift) | (UnsignedLong(layer) << LayerShift);
+
+    const UnsignedLong state = ((UnsignedLong(shader) & mask(ShaderBits)) << (MaterialBits + MeshBits)) |
+                               ((UnsignedLong(material) & mask(MaterialBits)) << MeshBits) |
+                               (UnsignedLong(mesh) & mask(MeshBits));
+    constexpr UnsignedInt StateBits = ShaderBits + MaterialBits + MeshBits;
+    static_assert(StateBits + DepthBits <= LayerShift, "key fields overlap");
+
+    // the rest of the bits is unused, the sort skips their passes
+    constexpr UnsignedInt lowest = LayerShift - StateBits - DepthBits;
+    if(layer == Layer::Opaque)
+        key |= (state << (DepthBits + lowest)) | (depthBits(depth) << lowest);
+    else
+        key |= ((mask(DepthBits) - depthBits(depth)) << (StateBits + lowest)) | (state << lowest);
+
+    return key;
+}
+
+RenderQueue::Pass RenderQueue::pass(UnsignedLong key)
+{
+    return Pass(key >> PassShift);
+}
+
+RenderQueue::Layer RenderQueue::layer(UnsignedLong key)
+{
+    return Layer((key >> LayerShift) & 1);
+}
+
+void RenderQueue::add(UnsignedLong key, SceneGraph::Drawable3D& drawable)
+{
+    if(_size == _items.size())
+    {
+        Containers::Array<Item> items(NoInit, Math::max<size_t>(_items.size() * 2, 64));
+        std::copy(_items.begin(), _items.end(), items.begin());
+        _items = std::move(items);
+        scratch = Containers::Array<Item>(NoInit, _items.size());
+    }
+
+    _items[_size++] = { key, &drawable };
+    sorted = false;
+}
+
+void RenderQueue::sort()
+{
+    radixSort(_items.prefix(_size), scratch.prefix(_size), [](const Item& item) { return item.key; });
+    sorted = true;
+}
+
+Containers::ArrayView<const RenderQueue::Item> RenderQueue::items(Pass pass, Layer layer) const
+{
+    CORRADE_ASSERT(sorted, "RenderQueue::items(): queue isn't sorted", {});
+
+    // pass and layer are the most significant bits, so each combination is a contiguous range
+    const UnsignedLong begin = (UnsignedLong(pass) << PassShift) | (UnsignedLong(layer) << LayerShift);
+    const UnsignedLong end = begin + (UnsignedLong(1) << LayerShift);
+
+    const Item* first = _items.data();
+    const Item* last = first + _size;
+    const auto compare = [](const Item& item, UnsignedLong key) { return item.key < key; };
+    const Item* rangeBegin = std::lower_bound(first, last, begin, compare);
+    const Item* rangeEnd = end == 0 ? last : std::lower_bound(rangeBegin, last, end, compare);
+    return { rangeBegin, size_t(rangeEnd - rangeBegin) };
+}
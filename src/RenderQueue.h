@@ -0,0 +1,80 @@
+#pragma once
+
+#include <Magnum/Magnum.h>
+#include <Magnum/SceneGraph/SceneGraph.h>
+#include <Corrade/Containers/Array.h>
+#include <Corrade/Containers/ArrayView.h>
+
+// flat list of draws for one frame, sorted by packed 64-bit keys
+// replaces DrawableGroup traversal: opaque draws are grouped by state (shader, textures, mesh) and then
+// sorted front to back to reduce overdraw, transparent draws are sorted back to front for blending
+// sorting is a radix sort and the storage is kept between frames, so a frame doesn't allocate
+class RenderQueue
+{
+public:
+    enum class Pass : Magnum::UnsignedByte
+    {
+        Velocity,
+        Color
+    };
+
+    enum class Layer : Magnum::UnsignedByte
+    {
+        Opaque,
+        // no depth writes, drawn after all opaque draws of the same pass
+        Transparent
+    };
+
+    struct Item
+    {
+        Magnum::UnsignedLong key;
+        Magnum::SceneGraph::Drawable3D* drawable;
+    };
+
+    // bits per key field, larger values are truncated
+    // this only affects sorting efficiency, not correctness
+    static constexpr Magnum::UnsignedInt ShaderBits = 8;
+    static constexpr Magnum::UnsignedInt MaterialBits = 12;
+    static constexpr Magnum::UnsignedInt MeshBits = 12;
+    static constexpr Magnum::UnsignedInt DepthBits = 24;
+
+    // from the most significant bits:
+    // pass, layer, then
+    // opaque: shader, material, mesh, depth (front to back)
+    // transparent: depth (back to front), shader, material, mesh
+    // depth is the positive view space distance
+    static Magnum::UnsignedLong key(Pass pass,
+                                    Layer layer,
+                                    Magnum::UnsignedInt shader,
+                                    Magnum::UnsignedInt material,
+                                    Magnum::UnsignedInt mesh,
+                                    Magnum::Float depth);
+
+    static Pass pass(Magnum::UnsignedLong key);
+    static Layer layer(Magnum::UnsignedLong key);
+
+    size_t size() const
+    {
+        return _size;
+    }
+
+    void clear()
+    {
+        _size = 0;
+        sorted = true;
+    }
+
+    void add(Magnum::UnsignedLong key, Magnum::SceneGraph::Drawable3D& drawable);
+
+    void sort();
+
+    // sorted draws of one pass and layer
+    Corrade::Containers::ArrayView<const Item> items(Pass pass, Layer layer) const;
+
+private:
+    // only grow, the first _size items are used
+    Corrade::Containers::Array<Item> _items;
+    Corrade::Containers::Array<Item> scratch;
+    size_t _size = 0;
+    bool sorted = true;
+};
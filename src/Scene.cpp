@@ -1,21 +1,14 @@
 #include "Scene.h"
 
-#include <Magnum/Trade/SceneData.h>
+#include "SceneCache.h"
 #include <Magnum/Trade/MeshData.h>
-#include <Magnum/Trade/TextureData.h>
-#include <Magnum/Trade/ImageData.h>
-#include <Magnum/ImageView.h>
-#include <Magnum/PixelFormat.h>
 #include <Magnum/Math/Color.h>
 #include <Magnum/Math/Constants.h>
-#include <Magnum/Math/FunctionsBatch.h>
-#include <Magnum/GL/TextureFormat.h>
+#include <Magnum/Math/Functions.h>
 #include <Magnum/MeshTools/Compile.h>
 #include <Corrade/Utility/Debug.h>
 #include <Corrade/Containers/Optional.h>
-#include <Corrade/Containers/Pair.h>
 #include <Corrade/Containers/GrowableArray.h>
-#include <Corrade/PluginManager/Manager.h>
 
 using namespace Magnum;
 using namespace Magnum::Math::Literals;
@@ -24,11 +17,27 @@ using namespace Feature;
 
 // for some reason GCC expects a definition for a static constexpr float
 constexpr Magnum::Float Scene::shininess;
+constexpr Magnum::UnsignedInt Scene::DefaultMaterialId;
+
+Scene::Scene(NoCreateT) :
+    streamingBuffer(NoCreate),
+    instanceCullingShader(NoCreate),
+    instanceOcclusionShader(NoCreate),
+    materialShader(NoCreate),
+    velocityShader(NoCreate)
+{
+}
 
-Scene::Scene(NoCreateT) : materialShader(NoCreate), velocityShader(NoCreate) { }
-
-Scene::Scene() : materialShader(NoCreate), velocityShader(NoCreate)
+Scene::Scene() :
+    streamingBuffer(NoCreate),
+    instanceCullingShader(NoCreate),
+    instanceOcclusionShader(NoCreate),
+    materialShader(NoCreate),
+    velocityShader(NoCreate)
 {
+    streamingBuffer = StreamingBuffer();
+    jobSystem.emplace();
+
     // Default material
 
     Containers::Array<GL::Texture2D> defaultTextures = defaultMaterial.createTextures({ 4, 4 });
@@ -54,18 +63,32 @@ Scene::Scene() : materialShader(NoCreate), velocityShader(NoCreate)
     root.setParent(&scene);
 
     // Shaders
+    // independent programs first, see ProgramCache::setupParallelCompile()
 
     // vertex color is coming from the instance buffer attribute
-    materialShader =
-        Shaders::PhongGL(Shaders::PhongGL::Flag::InstancedTransformation | Shaders::PhongGL::Flag::VertexColor |
-                             Shaders::PhongGL::Flag::DiffuseTexture | Shaders::PhongGL::Flag::SpecularTexture |
-                             Shaders::PhongGL::Flag::NormalTexture,
-                         lightPositions.size());
+    Shaders::PhongGL::CompileState materialShaderState = Shaders::PhongGL::compile(
+        Shaders::PhongGL::Configuration{}
+            .setFlags(Shaders::PhongGL::Flag::InstancedTransformation | Shaders::PhongGL::Flag::VertexColor |
+                      Shaders::PhongGL::Flag::DiffuseTexture | Shaders::PhongGL::Flag::SpecularTexture |
+                      Shaders::PhongGL::Flag::NormalTexture)
+            .setLightCount(lightPositions.size()));
+    VelocityShader::CompileState velocityShaderState =
+        VelocityShader::compile(VelocityShader::Flag::InstancedTransformation);
+
+    if(InstanceCullingShader::isSupported())
+    {
+        instanceCullingShader = InstanceCullingShader();
+        instanceCullingShader.setLabel("Instance culling shader");
+        instanceOcclusionShader = InstanceCullingShader(InstanceCullingShader::Flag::Occlusion);
+        instanceOcclusionShader.setLabel("Instance occlusion culling shader");
+    }
+
+    materialShader = Shaders::PhongGL(std::move(materialShaderState));
     materialShader.setLightPositions(lightPositions);
     materialShader.setLightColors(lightColors);
     materialShader.setLabel("Material shader (instanced, textured Phong)");
 
-    velocityShader = VelocityShader(VelocityShader::Flag::InstancedTransformation);
+    velocityShader = VelocityShader(std::move(velocityShaderState));
     velocityShader.setLabel("Velocity shader (instanced)");
 
     // Objects
@@ -75,270 +98,556 @@ Scene::Scene() : materialShader(NoCreate), velocityShader(NoCreate)
     Object3D& object = root.addChild<Object3D>();
     object.translate({ 0.0f, 0.0f, -5.0f });
 
-    Range3D bounds;
-    bool loaded = loadScene(mesh, object, &bounds);
-    CORRADE_ASSERT(loaded, "Failed to load scene", );
+    // drawables appear as streamScene() uploads their resources
+    loadScene(mesh, object, 2.0f);
+}
 
-    float scale = 2.0f / bounds.size().max();
+void Scene::setViewport(Vector2i size)
+{
+    camera->setViewport(size);
 
-    object.scaleLocal(Vector3(scale));
+    //constexpr Rad hFOV_4by3 = 90.0_degf;
+    //Rad vFOV = Math::atan(Math::tan(hFOV_4by3 * 0.5f) / (4.0f / 3.0f)) * 2.0f;
+    constexpr Rad vFOV = 73.74_degf;
 
-    Vector3 center(float(objectGridSize - 1) / 2.0f);
+    float aspectRatio = Vector2(size).aspectRatio();
+    Rad hFOV = Math::atan(Math::tan(vFOV * 0.5f) * aspectRatio) * 2.0f;
+    camera->setProjectionMatrix(Matrix4::perspectiveProjection(hFOV, aspectRatio, cameraNear, cameraFar));
+}
 
-    // animated objects + associated velocity drawables
+void Scene::applyOptions(const Options::Scene& options)
+{
+    for(size_t i = 0; i < meshAnimables.size(); i++)
+    {
+        meshAnimables[i].setState(options.animatedObjects ? SceneGraph::AnimationState::Running
+                                                          : SceneGraph::AnimationState::Paused);
+    }
 
-    for(TexturedDrawable3D* drawable : featuresInChildren<TexturedDrawable3D>(object))
+    for(size_t i = 0; i < cameraAnimables.size(); i++)
     {
-        Object3D& drawableObject = static_cast<Object3D&>(drawable->object());
+        cameraAnimables[i].setState(options.animatedCamera ? SceneGraph::AnimationState::Running
+                                                           : SceneGraph::AnimationState::Paused);
+    }
 
-        Magnum::UnsignedInt id = drawable->meshId();
+    animatedObjects = options.animatedObjects;
+    frustumCulling = options.frustumCulling;
+    gpuCulling = options.gpuCulling && isGpuCullingSupported();
+    occlusionCulling = options.occlusionCulling && gpuCulling;
+}
 
-        VelocityDrawable3D& velocityDrawable = drawableObject.addFeature<VelocityDrawable3D>(
-            velocityShader, id, *velocityMeshes[id], *velocityInstanceBuffers[id]);
-        velocityDrawables.add(velocityDrawable);
+void Scene::prepareInstances()
+{
+    for(size_t i = 0; i < velocityDrawables.size(); i++)
+        static_cast<VelocityDrawable3D&>(velocityDrawables[i]).clearInstances();
+    for(size_t i = 0; i < transparentVelocityDrawables.size(); i++)
+        static_cast<VelocityDrawable3D&>(transparentVelocityDrawables[i]).clearInstances();
 
-        VelocityDrawable3D& transparentVelocityDrawable = drawableObject.addFeature<VelocityDrawable3D>(
-            velocityShader, id, *velocityMeshes[id], *velocityInstanceBuffers[id]);
-        transparentVelocityDrawables.add(transparentVelocityDrawable);
+    visibleInstanceCount = culledInstanceCount = 0;
 
-        for(size_t z = 0; z < objectGridSize; z++)
+    if(gpuCulling)
+    {
+        // view space frustum, the shader transforms instances to view space anyway
+        const Frustum frustum = Frustum::fromMatrix(camera->projectionMatrix());
+        for(size_t i = 0; i < drawables.size(); i++)
         {
-            for(size_t y = 0; y < objectGridSize; y++)
-            {
-                for(size_t x = 0; x < objectGridSize; x++)
-                {
-                    Object3D& instance = drawableObject.addChild<Object3D>();
-
-                    Matrix3 toLocal = Matrix3(instance.absoluteTransformationMatrix()).inverted();
-
-                    // add instances back to front for alpha blending
-                    Vector3 translation = (Vector3(x, y, -float(objectGridSize - z - 1)) - center) * 4.0f;
-                    instance.translate(toLocal * translation);
-
-                    InstanceDrawable3D& instanceDrawable = drawable->addInstance(instance);
-
-                    bool transparent = z == (objectGridSize - 1);
-                    Color3 color =
-                        (Color3(x, y, z) + Color3(1.0f)) / objectGridSize; // +1 to avoid completely black objects
-                    float alpha = transparent ? 0.75f : 1.0f;
-                    instanceDrawable.setColor(Color4(color, alpha));
-
-                    Vector3 localX = toLocal * Vector3::xAxis();
-                    Vector3 localY = toLocal * Vector3::yAxis();
-
-                    if(transparent)
-                        transparentVelocityDrawable.addInstance(instance);
-                    else
-                        velocityDrawable.addInstance(instance);
-
-                    TranslationAnimable3D& translationAnimable = instance.addFeature<TranslationAnimable3D>(
-                        localX, 5.5f * localX.length(), 3.0f * localX.length());
-                    meshAnimables.add(translationAnimable);
-                    translationAnimable.setState(SceneGraph::AnimationState::Running);
-
-                    RotationAnimable3D& rotationAnimable =
-                        instance.addFeature<RotationAnimable3D>(localY, 90.0_degf, Rad(Constants::inf()));
-                    meshAnimables.add(rotationAnimable);
-                    rotationAnimable.setState(SceneGraph::AnimationState::Running);
-                }
-            }
+            TexturedDrawable3D& drawable = static_cast<TexturedDrawable3D&>(drawables[i]);
+            drawable.prepareInstancesGpu(*camera, frustum, meshBounds[drawable.meshId()], instanceCullingShader);
+            visibleInstanceCount += drawable.instances().size();
+        }
+    }
+    else
+    {
+        if(frustumCulling)
+            cullInstances();
+
+        // TexturedDrawables add their instances' data to the velocity drawables as well
+        for(size_t i = 0; i < drawables.size(); i++)
+        {
+            TexturedDrawable3D& drawable = static_cast<TexturedDrawable3D&>(drawables[i]);
+            const InstanceStore& instances = drawable.instances();
+            Containers::ArrayView<const UnsignedInt> visible = frustumCulling ? visibleInstances[i] : instances.all();
+            drawable.prepareInstances(*camera, visible, jobSystem.get());
+
+            visibleInstanceCount += visible.size();
+            culledInstanceCount += instances.size() - visible.size();
         }
     }
+
+    buildRenderQueue();
 }
 
-bool Scene::loadScene(const char* file, Object3D& root, Range3D* bounds)
+void Scene::buildRenderQueue()
 {
-    // load importer
+    renderQueue.clear();
 
-    PluginManager::Manager<Trade::AbstractImporter> manager;
-    Containers::Pointer<Trade::AbstractImporter> importer = manager.loadAndInstantiate("AnySceneImporter");
-    if(!importer)
-        return false;
+    const Matrix4 cameraMatrix = camera->cameraMatrix();
+    const auto depth = [&](SceneGraph::Drawable3D& drawable) {
+        return -(cameraMatrix * drawable.object().absoluteTransformationMatrix()).translation().z();
+    };
 
-    // load scene
+    // drawables without instances this frame are skipped entirely
 
-    if(!importer->openFile(file))
-        return false;
+    for(size_t i = 0; i < velocityDrawables.size(); i++)
+    {
+        VelocityDrawable3D& drawable = static_cast<VelocityDrawable3D&>(velocityDrawables[i]);
+        if(drawable.hasInstances())
+            renderQueue.add(RenderQueue::key(RenderQueue::Pass::Velocity,
+                                             RenderQueue::Layer::Opaque,
+                                             velocityShader.id(),
+                                             0,
+                                             drawable.meshId(),
+                                             depth(drawable)),
+                            drawable);
+    }
 
-    if(importer->sceneCount() == 0)
-        return false;
+    for(size_t i = 0; i < transparentVelocityDrawables.size(); i++)
+    {
+        VelocityDrawable3D& drawable = static_cast<VelocityDrawable3D&>(transparentVelocityDrawables[i]);
+        if(drawable.hasInstances())
+            renderQueue.add(RenderQueue::key(RenderQueue::Pass::Velocity,
+                                             RenderQueue::Layer::Transparent,
+                                             velocityShader.id(),
+                                             0,
+                                             drawable.meshId(),
+                                             depth(drawable)),
+                            drawable);
+    }
 
-    Int sceneId = importer->defaultScene();
-    if(sceneId == -1)
-        sceneId = 0;
-    Containers::Optional<Trade::SceneData> sceneData = importer->scene(sceneId);
-    if(!sceneData)
-        return false;
+    // opaque and transparent instances of a drawable are separate draws, only the latter wait for blending
+    for(size_t i = 0; i < drawables.size(); i++)
+    {
+        TexturedDrawable3D& drawable = static_cast<TexturedDrawable3D&>(drawables[i]);
+        for(const RenderQueue::Layer layer : { RenderQueue::Layer::Opaque, RenderQueue::Layer::Transparent })
+        {
+            if(drawable.hasInstances(layer))
+                renderQueue.add(RenderQueue::key(RenderQueue::Pass::Color,
+                                                 layer,
+                                                 drawable.materialShader().id(),
+                                                 drawable.materialId() + 1, // DefaultMaterialId wraps to 0
+                                                 drawable.meshId(),
+                                                 depth(drawable)),
+                                drawable);
+        }
+    }
 
-    if(!sceneData->is3D() ||
-       !sceneData->hasField(Trade::SceneField::Parent) || // TODO does this break files with just one object?
-       !sceneData->hasField(Trade::SceneField::Mesh))
-        return false;
+    renderQueue.sort();
+}
 
-    // load and compile meshes
+void Scene::drawQueue(RenderQueue::Pass pass, RenderQueue::Layer layer)
+{
+    // every pass only contains one drawable type
+    if(pass == RenderQueue::Pass::Velocity)
+    {
+        for(const RenderQueue::Item& item : renderQueue.items(pass, layer))
+            static_cast<VelocityDrawable3D*>(item.drawable)->render();
+    }
+    else
+    {
+        // opaque draws are sorted by material, consecutive ones with the same material keep the bound textures
+        // nothing else binds textures between the draws of one queue
+        const TexturedDrawable3D* previous = nullptr;
+        for(const RenderQueue::Item& item : renderQueue.items(pass, layer))
+        {
+            TexturedDrawable3D& drawable = *static_cast<TexturedDrawable3D*>(item.drawable);
+            drawable.render(*camera, layer, !previous || previous->materialId() != drawable.materialId());
+            previous = &drawable;
+        }
+    }
+}
 
-    Magnum::UnsignedInt meshOffset = meshes.size();
-    Containers::arrayResize(meshes, meshes.size() + importer->meshCount());
-    Containers::arrayResize(instanceBuffers, instanceBuffers.size() + importer->meshCount());
-    Containers::arrayResize(velocityMeshes, velocityMeshes.size() + importer->meshCount());
-    Containers::arrayResize(velocityInstanceBuffers, velocityInstanceBuffers.size() + importer->meshCount());
+void Scene::occludeInstances(GL::Texture2D& hiZ, const Matrix4& projection)
+{
+    CORRADE_ASSERT(gpuCulling, "Scene::occludeInstances(): requires GPU culling", );
 
-    Range3D sceneBounds;
+    for(size_t i = 0; i < drawables.size(); i++)
+    {
+        TexturedDrawable3D& drawable = static_cast<TexturedDrawable3D&>(drawables[i]);
+        drawable.occludeInstancesGpu(meshBounds[drawable.meshId()], hiZ, projection, instanceOcclusionShader);
+    }
+}
+
+void Scene::cullInstances()
+{
+    // (re)build the BVH if instances were added
 
-    for(UnsignedInt i = 0; i < importer->meshCount(); i++)
+    const size_t drawableCount = drawables.size();
+    size_t instanceCount = 0;
+    for(size_t i = 0; i < drawableCount; i++)
+        instanceCount += static_cast<TexturedDrawable3D&>(drawables[i]).instances().size();
+
+    const bool rebuild = instanceOffsets.size() != drawableCount || instanceBounds.size() != instanceCount;
+    if(rebuild)
     {
-        Containers::Optional<Trade::MeshData> data = importer->mesh(i);
-        if(data && data->hasAttribute(Trade::MeshAttribute::Position) &&
-           data->hasAttribute(Trade::MeshAttribute::Normal) && data->hasAttribute(Trade::MeshAttribute::Tangent) &&
-           data->hasAttribute(Trade::MeshAttribute::TextureCoordinates) &&
-           GL::meshPrimitive(data->primitive()) == GL::MeshPrimitive::Triangles)
-        {
-            if(bounds)
-                sceneBounds = Math::join(sceneBounds, Range3D(Math::minmax(data->positions3DAsArray())));
+        instanceOffsets = Containers::Array<UnsignedInt>(NoInit, drawableCount);
+        instanceBounds = Containers::Array<Range3D>(instanceCount);
+        instanceVisibility = Containers::Array<bool>(instanceCount);
+        visibleInstances = Containers::Array<Containers::Array<UnsignedInt>>(drawableCount);
+    }
 
-            GL::Buffer indices, vertices;
-            indices.setData(data->indexData());
-            vertices.setData(data->vertexData());
+    // world space bounds of all instances
 
-            meshes[meshOffset + i].emplace(MeshTools::compile(*data, indices, vertices));
-            instanceBuffers[meshOffset + i].emplace(InstanceDrawable3D::addInstancedBuffer(*meshes[i]));
+    UnsignedInt offset = 0;
+    for(size_t i = 0; i < drawableCount; i++)
+    {
+        TexturedDrawable3D& drawable = static_cast<TexturedDrawable3D&>(drawables[i]);
+        const InstanceStore& instances = drawable.instances();
+        instanceOffsets[i] = offset;
+
+        const Matrix4 parentTransformation = drawable.object().absoluteTransformationMatrix();
+        const Range3D& localBounds = meshBounds[drawable.meshId()];
+        const Vector3 localCenter = localBounds.center();
+        const Vector3 localExtent = localBounds.size() * 0.5f;
+        Containers::ArrayView<const Matrix4> transformations = instances.transformations();
+        Containers::ArrayView<Range3D> bounds = instanceBounds.slice(offset, offset + instances.size());
+
+        jobSystem->parallelFor(instances.size(), InstanceStore::GrainSize, [&](size_t begin, size_t end) {
+            for(size_t j = begin; j < end; j++)
+            {
+                // transformed box around the transformed box
+                const Matrix4 transformation = parentTransformation * transformations[j];
+                const Vector3 center = transformation.transformPoint(localCenter);
+                const Matrix3x3 rotationScaling = transformation.rotationScaling();
+                const Vector3 extent = Math::abs(rotationScaling[0]) * localExtent.x() +
+                                       Math::abs(rotationScaling[1]) * localExtent.y() +
+                                       Math::abs(rotationScaling[2]) * localExtent.z();
+                bounds[j] = { center - extent, center + extent };
+            }
+        });
 
-            velocityMeshes[meshOffset + i].emplace(MeshTools::compile(*data, indices, vertices));
-            velocityInstanceBuffers[meshOffset + i].emplace(
-                VelocityInstanceDrawable3D::addInstancedBuffer(*velocityMeshes[i]));
-        }
-        else
-            Warning(Warning::Flag::NoSpace)
-                << "Skipping mesh " << i << " (must be a triangle mesh with normals, tangents and UV coordinates)";
+        offset += UnsignedInt(instances.size());
     }
 
-    if(bounds)
-        *bounds = sceneBounds;
+    if(rebuild)
+        instanceBvh.build(instanceBounds);
+    else
+        instanceBvh.refit(instanceBounds);
 
-    // load materials
+    // cull
 
-    Magnum::UnsignedInt materialOffset = materials.size();
-    Containers::arrayResize(materials, materials.size() + importer->materialCount());
+    const Frustum frustum = Frustum::fromMatrix(camera->projectionMatrix() * camera->cameraMatrix());
+    instanceBvh.cull(frustum, instanceBounds, instanceVisibility);
 
-    for(UnsignedInt i = 0; i < importer->materialCount(); i++)
+    // keep instance order, we rely on it for alpha blending
+    for(size_t i = 0; i < drawableCount; i++)
     {
-        Containers::Optional<Trade::MaterialData> data = importer->material(i);
-        if(data && data->types() & Trade::MaterialType::Phong)
+        Containers::Array<UnsignedInt>& visible = visibleInstances[i];
+        Containers::arrayResize(visible, 0);
+
+        const size_t count = static_cast<TexturedDrawable3D&>(drawables[i]).instances().size();
+        for(UnsignedInt j = 0; j < count; j++)
         {
-            materials[materialOffset + i].emplace(std::move(*data));
+            if(instanceVisibility[instanceOffsets[i] + j])
+                Containers::arrayAppend(visible, j);
         }
-        else
-            Warning(Warning::Flag::NoSpace) << "Skipping material " << i << " (not Phong-compatible)";
     }
+}
+
+void Scene::loadScene(const char* file, Object3D& root, Float fitSize)
+{
+    CORRADE_ASSERT(!loading, "Scene::loadScene(): already loading a scene", );
+
+    loading.emplace();
+    loading->loader.emplace(file);
+    loading->root = &root;
+    loading->fitSize = fitSize;
+}
+
+void Scene::finishLoading()
+{
+    if(loading)
+        loading->loader->wait();
+
+    // keep uploading in slices, the staging buffer would grow to fit everything at once otherwise
+    while(loading)
+        streamScene();
+}
+
+void Scene::streamScene(size_t budget)
+{
+    if(!loading || !loading->loader->isReady())
+        return;
+
+    SceneLoader& loader = *loading->loader;
+    const SceneCache* cache = loader.cache();
+    if(!cache)
+    {
+        Error() << "Failed to load scene";
+        loading = nullptr;
+        return;
+    }
+
+    if(!loading->started)
+        instantiateScene(*cache);
 
-    // load textures
+    // one mesh or texture level at a time until the budget is used up
+    // a drawable is added as soon as its mesh and textures are resident
 
-    Magnum::UnsignedInt textureOffset = textures.size();
-    Containers::arrayResize(textures, textures.size() + importer->textureCount());
+    loader.beginUpload();
 
-    for(UnsignedInt i = 0; i < importer->textureCount(); i++)
+    const Containers::ArrayView<const SceneCache::MeshAssignment> assignments = cache->meshAssignments();
+    size_t uploaded = 0;
+    while(loading->nextAssignment < assignments.size() && uploaded < budget)
     {
-        Containers::Optional<Trade::TextureData> textureData = importer->texture(i);
-        if(textureData && textureData->type() == Trade::TextureType::Texture2D)
+        const SceneCache::MeshAssignment& assignment = assignments[loading->nextAssignment];
+        const UnsignedInt meshId = loading->meshOffset + assignment.mesh;
+
+        if(!cache->hasMesh(assignment.mesh))
+        {
+            loading->nextAssignment++;
+            continue;
+        }
+
+        if(!meshes[meshId])
+        {
+            GL::Buffer indices, vertices;
+            uploaded += loader.uploadMesh(assignment.mesh, indices, vertices);
+
+            // instance buffers are added by the drawables, they point into the streaming buffer
+            const Containers::Optional<Trade::MeshData> data = cache->mesh(assignment.mesh);
+            meshes[meshId].emplace(MeshTools::compile(*data, indices, vertices));
+            velocityMeshes[meshId].emplace(MeshTools::compile(*data, indices, vertices));
+            meshBindings[meshId].emplace();
+            velocityMeshBindings[meshId].emplace();
+            continue;
+        }
+
+        const Trade::PhongMaterialData* material = nullptr;
+        const UnsignedInt materialId = loading->materialOffset + assignment.material;
+        if(assignment.material != -1 && materials[materialId])
         {
-            Containers::Optional<Trade::ImageData2D> imageData = importer->image2D(textureData->image(), 0 /* level */);
-            if(imageData)
+            material = &materials[materialId]->as<Trade::PhongMaterialData>();
+            if(!TexturedDrawable3D::isCompatibleMaterial(*material, materialShader))
+                material = nullptr;
+        }
+
+        if(material)
+        {
+            const Int texture = pendingTexture(*material, *cache);
+            if(texture != -1)
             {
-                GL::TextureFormat format;
-                switch(imageData->format())
-                {
-                    case PixelFormat::RGB8Unorm:
-                        format = GL::TextureFormat::RGB8;
-                        break;
-                    case PixelFormat::RGBA8Unorm:
-                        format = GL::TextureFormat::RGBA8;
-                        break;
-                    default:
-                        Warning(Warning::Flag::NoSpace)
-                            << "Skipping texture " << i << " (unsupported format " << imageData->format() << ")";
-                        continue;
-                }
-                GL::Texture2D texture;
-                texture.setMagnificationFilter(textureData->magnificationFilter())
-                    .setMinificationFilter(textureData->minificationFilter(), textureData->mipmapFilter())
-                    .setWrapping(textureData->wrapping().xy())
-                    .setStorage(Math::log2(imageData->size().max()) + 1, format, imageData->size())
-                    .setSubImage(0, {}, *imageData)
-                    .generateMipmap();
-                textures[textureOffset + i].emplace(std::move(texture));
+                uploaded += uploadTexture(texture);
+                continue;
             }
         }
+
+        addDrawable(*loading->objects[assignment.object], meshId, material ? materialId : DefaultMaterialId, material);
+        loading->nextAssignment++;
+    }
+
+    loader.endUpload();
+
+    // releases the cache
+    if(loading->nextAssignment == assignments.size())
+        loading = nullptr;
+}
+
+void Scene::instantiateScene(const SceneCache& cache)
+{
+    // bounds, materials and the object hierarchy don't need GL, only meshes and textures are streamed
+
+    loading->started = true;
+
+    loading->meshOffset = meshes.size();
+    Containers::arrayResize(meshes, meshes.size() + cache.meshCount());
+    Containers::arrayResize(velocityMeshes, velocityMeshes.size() + cache.meshCount());
+    Containers::arrayResize(meshBindings, meshBindings.size() + cache.meshCount());
+    Containers::arrayResize(velocityMeshBindings, velocityMeshBindings.size() + cache.meshCount());
+    Containers::arrayResize(meshBounds, meshBounds.size() + cache.meshCount());
+
+    Range3D sceneBounds;
+    for(UnsignedInt i = 0; i < cache.meshCount(); i++)
+    {
+        if(cache.hasMesh(i))
+        {
+            meshBounds[loading->meshOffset + i] = cache.meshBounds(i);
+            sceneBounds = Math::join(sceneBounds, cache.meshBounds(i));
+        }
     }
 
-    // load objects
+    if(loading->fitSize > 0.0f)
+        loading->root->scaleLocal(Vector3(loading->fitSize / sceneBounds.size().max()));
+
+    // materials
+
+    loading->materialOffset = materials.size();
+    Containers::arrayResize(materials, materials.size() + cache.materialCount());
 
-    Containers::Array<Object3D*> objects { size_t(sceneData->mappingBound()) };
-    const auto parents = sceneData->parentsAsArray();
+    for(UnsignedInt i = 0; i < cache.materialCount(); i++)
+    {
+        Containers::Optional<Trade::MaterialData> data = cache.material(i);
+        if(data)
+            materials[loading->materialOffset + i].emplace(std::move(*data));
+    }
+
+    // textures are added once all their levels are uploaded
+
+    loading->textureOffset = textures.size();
+    Containers::arrayResize(textures, textures.size() + cache.textureCount());
+
+    // objects
+
+    const Containers::ArrayView<const SceneCache::Object> cachedObjects = cache.objects();
+    Containers::Array<Object3D*>& objects = loading->objects;
+    objects = Containers::Array<Object3D*>{ cachedObjects.size() };
     // create objects in the scene graph
-    for(const Containers::Pair<UnsignedInt, Int>& parent : parents)
+    for(UnsignedInt i = 0; i < cachedObjects.size(); i++)
     {
-        objects[parent.first()] = &root.addChild<Object3D>();
+        if(cachedObjects[i].flags & SceneCache::Object::Exists)
+            objects[i] = &loading->root->addChild<Object3D>();
     }
 
     // set parents, separate pass because children can occur
     // before parents
-    for(const Containers::Pair<UnsignedInt, Int>& parent : parents)
+    for(UnsignedInt i = 0; i < cachedObjects.size(); i++)
     {
-        Object3D* parentObject = parent.second() == -1 ? &root : objects[parent.second()];
-        objects[parent.first()]->setParent(parentObject);
+        if(Object3D* object = objects[i])
+        {
+            const Int parent = cachedObjects[i].parent;
+            Object3D* parentObject = parent == -1 ? loading->root : objects[parent];
+            object->setParent(parentObject ? parentObject : loading->root);
+            if(cachedObjects[i].flags & SceneCache::Object::HasTransformation)
+                object->setTransformation(cachedObjects[i].transformation);
+        }
     }
+}
 
-    for(const Containers::Pair<UnsignedInt, Matrix4>& transformation : sceneData->transformations3DAsArray())
+Int Scene::pendingTexture(const Trade::PhongMaterialData& material, const SceneCache& cache) const
+{
+    // same textures TexturedDrawable uses
+    UnsignedInt ids[4];
+    size_t count = 0;
+    if(material.hasAttribute(Trade::MaterialAttribute::AmbientTexture))
+        ids[count++] = material.ambientTexture();
+    if(material.hasAttribute(Trade::MaterialAttribute::DiffuseTexture))
+        ids[count++] = material.diffuseTexture();
+    if(material.hasAttribute(Trade::MaterialAttribute::SpecularTexture) ||
+       material.hasAttribute(Trade::MaterialAttribute::SpecularGlossinessTexture))
+        ids[count++] = material.specularTexture();
+    if(material.hasAttribute(Trade::MaterialAttribute::NormalTexture))
+        ids[count++] = material.normalTexture();
+
+    for(size_t i = 0; i < count; i++)
     {
-        if(Object3D* object = objects[transformation.first()])
-            object->setTransformation(transformation.second());
+        const UnsignedInt id = ids[i];
+        if(id < cache.textureCount() && cache.textureLevelCount(id) > 0 && !textures[loading->textureOffset + id])
+            return Int(id);
     }
 
-    for(const Containers::Pair<UnsignedInt, Containers::Pair<UnsignedInt, Int>>& meshMaterial :
-        sceneData->meshesMaterialsAsArray())
+    return -1;
+}
+
+size_t Scene::uploadTexture(UnsignedInt id)
+{
+    const SceneCache& cache = *loading->loader->cache();
+
+    if(!loading->texture || loading->textureId != id)
+    {
+        loading->texture.emplace(std::move(*cache.createTexture(id)));
+        loading->textureId = id;
+        loading->textureLevel = 0;
+    }
+
+    const size_t size = loading->loader->uploadTextureLevel(id, loading->textureLevel, *loading->texture);
+
+    if(++loading->textureLevel == cache.textureLevelCount(id))
     {
-        if(Object3D* object = objects[meshMaterial.first()])
+        loading->texture->setLodBias(textureLodBias);
+        textures[loading->textureOffset + id] = std::move(loading->texture);
+    }
+
+    return size;
+}
+
+void Scene::addDrawable(Object3D& object,
+                        UnsignedInt meshId,
+                        UnsignedInt materialId,
+                        const Trade::PhongMaterialData* material)
+{
+    TexturedDrawable3D* drawable;
+    if(material)
+    {
+        drawable = &object.addFeature<TexturedDrawable3D>(materialShader,
+                                                          meshId,
+                                                          materialId,
+                                                          *meshes[meshId],
+                                                          *meshBindings[meshId],
+                                                          streamingBuffer,
+                                                          textures.exceptPrefix(loading->textureOffset),
+                                                          *material,
+                                                          shininess);
+    }
+    else
+    {
+        const Trade::PhongMaterialData& defaultPhong = defaultMaterial.as<Trade::PhongMaterialData>();
+        drawable = &object.addFeature<TexturedDrawable3D>(materialShader,
+                                                          meshId,
+                                                          DefaultMaterialId,
+                                                          *meshes[meshId],
+                                                          *meshBindings[meshId],
+                                                          streamingBuffer,
+                                                          textures, // first textures are the default textures
+                                                          defaultPhong,
+                                                          defaultPhong.shininess());
+    }
+    drawables.add(*drawable);
+
+    addInstances(*drawable);
+}
+
+void Scene::addInstances(TexturedDrawable3D& drawable)
+{
+    Vector3 center(float(objectGridSize - 1) / 2.0f);
+
+    Object3D& drawableObject = static_cast<Object3D&>(drawable.object());
+
+    Magnum::UnsignedInt id = drawable.meshId();
+
+    VelocityDrawable3D& velocityDrawable =
+        drawableObject.addFeature<VelocityDrawable3D>(
+            velocityShader, id, *velocityMeshes[id], *velocityMeshBindings[id], streamingBuffer);
+    velocityDrawables.add(velocityDrawable);
+
+    VelocityDrawable3D& transparentVelocityDrawable =
+        drawableObject.addFeature<VelocityDrawable3D>(
+            velocityShader, id, *velocityMeshes[id], *velocityMeshBindings[id], streamingBuffer);
+    transparentVelocityDrawables.add(transparentVelocityDrawable);
+
+    drawable.setVelocityDrawables(&velocityDrawable, &transparentVelocityDrawable);
+
+    constexpr size_t instanceCount = objectGridSize * objectGridSize * objectGridSize;
+    InstanceStore& instances = drawable.instances();
+    instances.reserve(instanceCount);
+
+    InstanceAnimable3D& animable = drawableObject.addFeature<InstanceAnimable3D>(instances, jobSystem.get());
+    animable.reserve(instanceCount);
+    meshAnimables.add(animable);
+    animable.setState(animatedObjects ? SceneGraph::AnimationState::Running : SceneGraph::AnimationState::Paused);
+
+    // instance transformations are relative to the drawable object
+    const Matrix3 toLocal = Matrix3(drawableObject.absoluteTransformationMatrix()).inverted();
+    const Vector3 localX = toLocal * Vector3::xAxis();
+    const Vector3 localY = toLocal * Vector3::yAxis();
+
+    for(size_t z = 0; z < objectGridSize; z++)
+    {
+        for(size_t y = 0; y < objectGridSize; y++)
         {
-            bool useDefaultMaterial = true;
-            const UnsignedInt meshId = meshOffset + meshMaterial.second().first();
-            const Int materialId = meshMaterial.second().second();
-            if(materialId != -1 && materials[materialOffset + materialId])
+            for(size_t x = 0; x < objectGridSize; x++)
             {
-                const Trade::PhongMaterialData& material =
-                    materials[materialOffset + materialId]->as<Trade::PhongMaterialData>();
-                if(TexturedDrawable3D::isCompatibleMaterial(material, materialShader))
-                {
-                    TexturedDrawable3D& drawable =
-                        object->addFeature<TexturedDrawable3D>(materialShader,
-                                                               meshId,
-                                                               *meshes[meshId],
-                                                               *instanceBuffers[meshId],
-                                                               textures.exceptPrefix(textureOffset),
-                                                               material,
-                                                               shininess);
-                    drawables.add(drawable);
-                    useDefaultMaterial = false;
-                }
-            }
+                Vector3 translation = (Vector3(x, y, -float(objectGridSize - z - 1)) - center) * 4.0f;
 
-            if(useDefaultMaterial)
-            {
-                const Trade::PhongMaterialData& material = defaultMaterial.as<Trade::PhongMaterialData>();
-                TexturedDrawable3D& drawable =
-                    object->addFeature<TexturedDrawable3D>(materialShader,
-                                                           meshId,
-                                                           *meshes[meshId],
-                                                           *instanceBuffers[meshId],
-                                                           textures, // first textures are the default textures
-                                                           material,
-                                                           material.shininess());
-                drawables.add(drawable);
-            }
+                bool transparent = z == (objectGridSize - 1);
+                Color3 color =
+                    (Color3(x, y, z) + Color3(1.0f)) / objectGridSize; // +1 to avoid completely black objects
+                float alpha = transparent ? 0.75f : 1.0f;
+
+                size_t instance = instances.add(Matrix4::translation(toLocal * translation),
+                                                Color4(color, alpha),
+                                                transparent ? InstanceStore::Velocity::Transparent
+                                                            : InstanceStore::Velocity::Opaque);
 
-            // by default, there are no instances
-            // add an InstanceDrawable3D to drawable.instanceDrawables() for each instance
+                animable.add(instance, localX, 5.5f * localX.length(), 3.0f * localX.length(), localY, 90.0_degf);
+            }
         }
     }
-
-    return true;
 }
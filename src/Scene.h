@@ -1,13 +1,22 @@
 #pragma once
 
 #include "Feature.h"
+#include "Options.h"
 
 #include "Drawables/TexturedDrawable.h"
 #include "Drawables/VelocityDrawable.h"
 #include "Shaders/VelocityShader.h"
-#include "Animables/AxisTranslationAnimable.h"
+#include "Shaders/InstanceCullingShader.h"
 #include "Animables/AxisRotationAnimable.h"
+#include "Animables/InstanceAnimable.h"
+#include "InstanceStore.h"
 #include "DefaultMaterial.h"
+#include "StreamingBuffer.h"
+#include "JobSystem.h"
+#include "Bvh.h"
+#include "RenderQueue.h"
+#include "SceneCache.h"
+#include "SceneLoader.h"
 #include <Magnum/SceneGraph/Object.h>
 #include <Magnum/SceneGraph/Scene.h>
 #include <Magnum/SceneGraph/Camera.h>
@@ -30,13 +39,11 @@ public:
     typedef Magnum::SceneGraph::Scene<Transform3D> Scene3D;
 
     typedef TexturedDrawable<Transform3D> TexturedDrawable3D;
-    typedef InstanceDrawable<Transform3D> InstanceDrawable3D;
 
     typedef VelocityDrawable<Scene::Transform3D> VelocityDrawable3D;
-    typedef VelocityInstanceDrawable<Scene::Transform3D> VelocityInstanceDrawable3D;
 
-    typedef AxisTranslationAnimable<Transform3D> TranslationAnimable3D;
     typedef AxisRotationAnimable<Transform3D> RotationAnimable3D;
+    typedef InstanceAnimable<Transform3D> InstanceAnimable3D;
 
     explicit Scene(Magnum::NoCreateT);
     explicit Scene();
@@ -53,18 +60,76 @@ public:
     // hardcoded because Magnum always sets this to 80 for GLTF
     static constexpr Magnum::Float shininess = 20.0f;
 
-    bool loadScene(const char* file, Object3D& root, Magnum::Range3D* bounds = nullptr);
+    // bytes uploaded per streamScene() call
+    static constexpr size_t DefaultUploadBudget = 8 << 20;
+
+    // start loading file on a background thread, streamScene() adds it to root piece by piece
+    // fitSize > 0 scales root so the largest extent of the scene is fitSize
+    void loadScene(const char* file, Object3D& root, Magnum::Float fitSize = 0.0f);
+    // upload about budget bytes of the loading scene and add drawables whose mesh and textures are resident
+    // call once per frame, does nothing until the background thread is done
+    void streamScene(size_t budget = DefaultUploadBudget);
+    // block until the scene is completely loaded
+    void finishLoading();
+
+    bool isLoading() const
+    {
+        return bool(loading);
+    }
+
+    // set camera viewport and update the projection matrix for the new aspect ratio
+    void setViewport(Magnum::Vector2i size);
+    // start or pause animations
+    void applyOptions(const Options::Scene& options);
+    // gather this frame's instance data for all drawables and velocity drawables
+    // culls instances outside the camera frustum if enabled
+    // call after animating and before any pass draws
+    void prepareInstances();
+    // fill visibleInstances, called by prepareInstances()
+    void cullInstances();
+
+    // sort this frame's draws, called by prepareInstances()
+    void buildRenderQueue();
+    // draw one pass and layer of the render queue with the current camera
+    void drawQueue(RenderQueue::Pass pass, RenderQueue::Layer layer);
+
+    // cull instances of the color pass hidden behind the given max depth pyramid, see HiZShader
+    // only works with GPU culling, call after prepareInstances()
+    void occludeInstances(Magnum::GL::Texture2D& hiZ, const Magnum::Matrix4& projection);
+
+    // Options::Scene::gpuCulling falls back to CPU culling if this is false
+    bool isGpuCullingSupported() const
+    {
+        return instanceCullingShader.id() != 0;
+    }
+
+    // local bounds of each mesh, same indices as meshes
+    Corrade::Containers::Array<Magnum::Range3D> meshBounds;
 
     // normal meshes with default instance data (transformation, normal matrix, color)
     Corrade::Containers::Array<Corrade::Containers::Pointer<Magnum::GL::Mesh>> meshes;
-    Corrade::Containers::Array<Corrade::Containers::Pointer<Magnum::GL::Buffer>> instanceBuffers;
 
     // meshes with instance data for the velocity shader (transformation, old transformation)
     Corrade::Containers::Array<Corrade::Containers::Pointer<Magnum::GL::Mesh>> velocityMeshes;
-    Corrade::Containers::Array<Corrade::Containers::Pointer<Magnum::GL::Buffer>> velocityInstanceBuffers;
+
+    // instance buffer each of the above meshes currently points at, shared by all drawables of the mesh
+    // pointers so drawables can keep references while the arrays grow
+    Corrade::Containers::Array<Corrade::Containers::Pointer<InstanceBinding>> meshBindings;
+    Corrade::Containers::Array<Corrade::Containers::Pointer<InstanceBinding>> velocityMeshBindings;
+
+    // animation and instance packing run on all cores
+    Corrade::Containers::Pointer<JobSystem> jobSystem;
+
+    // per-frame instance data of all drawables
+    // frames have to be started and ended by the renderer
+    StreamingBuffer streamingBuffer;
 
     Corrade::Containers::Array<Corrade::Containers::Pointer<Magnum::Trade::MaterialData>> materials;
+    // TexturedDrawable::materialId() of drawables using defaultMaterial
+    static constexpr Magnum::UnsignedInt DefaultMaterialId = ~0u;
     Corrade::Containers::Array<Corrade::Containers::Pointer<Magnum::GL::Texture2D>> textures;
+    // applied to scene textures as they become resident
+    Magnum::Float textureLodBias = 0.0f;
 
     DefaultMaterial defaultMaterial;
 
@@ -76,9 +141,12 @@ public:
     float cameraNear = 1.0f;
     float cameraFar = 50.0f;
 
+    // state of animables added while loading
+    bool animatedObjects = false;
     Magnum::SceneGraph::AnimableGroup3D meshAnimables;
     Magnum::SceneGraph::AnimableGroup3D cameraAnimables;
 
+    // all drawables, drawn through renderQueue
     Magnum::SceneGraph::DrawableGroup3D drawables;
     // moving objects that contribute to the velocity buffer
     Magnum::SceneGraph::DrawableGroup3D velocityDrawables;
@@ -86,10 +154,72 @@ public:
     // only necessary if we reuse the velocity depth buffer in the quarter-res scene pass
     Magnum::SceneGraph::DrawableGroup3D transparentVelocityDrawables;
 
+    // draws of all groups for the current frame
+    RenderQueue renderQueue;
+
+    // frustum culling of instances
+    // one BVH over the world space bounds of all instances, rebuilt when instances change and refit every frame
+    bool frustumCulling = true;
+    Bvh instanceBvh;
+    Corrade::Containers::Array<Magnum::Range3D> instanceBounds;
+    // BVH item offset of each drawable's first instance
+    Corrade::Containers::Array<Magnum::UnsignedInt> instanceOffsets;
+    Corrade::Containers::Array<bool> instanceVisibility;
+    // visible instances of each drawable
+    Corrade::Containers::Array<Corrade::Containers::Array<Magnum::UnsignedInt>> visibleInstances;
+    size_t visibleInstanceCount = 0;
+    size_t culledInstanceCount = 0;
+
+    // culling and packing in a compute shader, the visible instance count never reaches the CPU
+    bool gpuCulling = false;
+    InstanceCullingShader instanceCullingShader;
+    // occlusion culling against the velocity pass depth, requires gpuCulling
+    bool occlusionCulling = false;
+    InstanceCullingShader instanceOcclusionShader;
+
     static constexpr size_t objectGridSize = 6;
     Corrade::Containers::Array<Magnum::Vector4> lightPositions;
     Corrade::Containers::Array<Magnum::Color3> lightColors;
 
     Magnum::Shaders::PhongGL materialShader;
     VelocityShader velocityShader;
+
+private:
+    // progress of loadScene() on the render thread
+    struct Loading
+    {
+        Corrade::Containers::Pointer<SceneLoader> loader;
+        Object3D* root = nullptr;
+        Magnum::Float fitSize = 0.0f;
+
+        // the object hierarchy and materials are created as soon as the cache is open
+        bool started = false;
+        Magnum::UnsignedInt meshOffset = 0;
+        Magnum::UnsignedInt materialOffset = 0;
+        Magnum::UnsignedInt textureOffset = 0;
+        Corrade::Containers::Array<Object3D*> objects;
+
+        // next SceneCache::meshAssignments() entry to add a drawable for
+        size_t nextAssignment = 0;
+
+        // texture with some of its levels uploaded, moved to textures once it's complete
+        Corrade::Containers::Pointer<Magnum::GL::Texture2D> texture;
+        Magnum::UnsignedInt textureId = 0;
+        Magnum::UnsignedInt textureLevel = 0;
+    };
+
+    void instantiateScene(const SceneCache& cache);
+    // first texture of material that isn't resident yet, -1 if there is none
+    Magnum::Int pendingTexture(const Magnum::Trade::PhongMaterialData& material, const SceneCache& cache) const;
+    // upload the next level of a texture, returns the size in bytes
+    size_t uploadTexture(Magnum::UnsignedInt id);
+    // material is nullptr for the default material
+    void addDrawable(Object3D& object,
+                     Magnum::UnsignedInt meshId,
+                     Magnum::UnsignedInt materialId,
+                     const Magnum::Trade::PhongMaterialData* material);
+    // velocity drawables, instances and their animation
+    void addInstances(TexturedDrawable3D& drawable);
+
+    Corrade::Containers::Pointer<Loading> loading;
 };
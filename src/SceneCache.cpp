@@ -0,0 +1,727 @@
+#include "SceneCache.h"
+
+#include <Magnum/FileCallback.h>
+#include <Magnum/ImageView.h>
+#include <Magnum/PixelFormat.h>
+#include <Magnum/Sampler.h>
+#include <Magnum/Math/FunctionsBatch.h>
+#include <Magnum/GL/Mesh.h>
+#include <Magnum/GL/TextureFormat.h>
+#include <Magnum/Trade/AbstractImporter.h>
+#include <Magnum/Trade/SceneData.h>
+#include <Magnum/Trade/TextureData.h>
+#include <Magnum/Trade/ImageData.h>
+#include <Corrade/Utility/Algorithms.h>
+#include <Corrade/Utility/Assert.h>
+#include <Corrade/Utility/Debug.h>
+#include <Corrade/Utility/Path.h>
+#include <Corrade/Containers/Pair.h>
+#include <Corrade/Containers/Pointer.h>
+#include <Corrade/Containers/StridedArrayView.h>
+#include <Corrade/Containers/String.h>
+#include <Corrade/Containers/GrowableArray.h>
+#include <Corrade/PluginManager/Manager.h>
+#include <cstdint>
+#include <cstring>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <utility>
+
+using namespace Magnum;
+using namespace Corrade;
+
+namespace
+{
+
+constexpr char Magic[8] = { 'M', 'O', 'S', 'C', 'A', 'C', 'H', 'E' };
+// reads back differently on a machine with the other byte order
+constexpr UnsignedInt Endianness = 0x01020304;
+
+enum : UnsignedInt
+{
+    EntryValid = 1 << 0,
+    MeshIndexed = 1 << 1
+};
+
+// blobs and sections start at 16 byte boundaries, enough for any entry and vertex format
+constexpr std::size_t Alignment = 16;
+
+UnsignedLong append(Containers::Array<char>& out, Containers::ArrayView<const void> data)
+{
+    const std::size_t offset = (out.size() + Alignment - 1) / Alignment * Alignment;
+    Containers::arrayResize(out, ValueInit, offset + data.size());
+    if(!data.isEmpty())
+        std::memcpy(out.data() + offset, data.data(), data.size());
+    return offset;
+}
+
+// size and modification time of a file the cache was built from
+struct FileStamp
+{
+    UnsignedLong size;
+    // nanoseconds, only full seconds on Windows
+    Long modified;
+};
+
+Containers::Optional<FileStamp> fileStamp(const char* file)
+{
+#ifdef CORRADE_TARGET_WINDOWS
+    struct __stat64 status;
+    if(_stat64(file, &status) != 0)
+        return {};
+    return FileStamp{ UnsignedLong(status.st_size), Long(status.st_mtime) * 1000000000 };
+#else
+    struct stat status;
+    if(stat(file, &status) != 0)
+        return {};
+#ifdef CORRADE_TARGET_APPLE
+    const timespec& modified = status.st_mtimespec;
+#else
+    const timespec& modified = status.st_mtim;
+#endif
+    return FileStamp{ UnsignedLong(status.st_size), Long(modified.tv_sec) * 1000000000 + Long(modified.tv_nsec) };
+#endif
+}
+
+// every file the importer reads goes through the file callback, so build() knows what the cache depends on
+struct LoadedFile
+{
+    Containers::String path;
+    // taken before the first read, a change during the build invalidates the cache on the next open()
+    FileStamp stamp;
+    // released again once the importer closes it
+    Containers::Array<char> data;
+};
+
+Containers::Optional<Containers::ArrayView<const char>> loadFile(const Containers::StringView file,
+                                                                 InputFileCallbackPolicy policy,
+                                                                 void* userData)
+{
+    Containers::Array<LoadedFile>& files = *static_cast<Containers::Array<LoadedFile>*>(userData);
+
+    LoadedFile* loaded = nullptr;
+    for(LoadedFile& candidate : files)
+    {
+        if(candidate.path == file)
+            loaded = &candidate;
+    }
+
+    if(policy == InputFileCallbackPolicy::Close)
+    {
+        if(loaded)
+            loaded->data = nullptr;
+        return {};
+    }
+
+    if(loaded && !loaded->data.isEmpty())
+        return Containers::ArrayView<const char>{ loaded->data };
+
+    if(!loaded)
+    {
+        Containers::String path{ file };
+        const Containers::Optional<FileStamp> stamp = fileStamp(path.data());
+        if(!stamp)
+            return {};
+        loaded = &Containers::arrayAppend(files, LoadedFile{ std::move(path), *stamp, {} });
+    }
+
+    Containers::Optional<Containers::Array<char>> data = Utility::Path::read(file);
+    if(!data)
+        return {};
+    loaded->data = std::move(*data);
+    return Containers::ArrayView<const char>{ loaded->data };
+}
+
+bool isSceneMesh(const Trade::MeshData& data)
+{
+    return data.hasAttribute(Trade::MeshAttribute::Position) && data.hasAttribute(Trade::MeshAttribute::Normal) &&
+           data.hasAttribute(Trade::MeshAttribute::Tangent) &&
+           data.hasAttribute(Trade::MeshAttribute::TextureCoordinates) &&
+           GL::meshPrimitive(data.primitive()) == GL::MeshPrimitive::Triangles;
+}
+
+// default pixel storage, rows are aligned to four bytes
+std::size_t rowPitch(Int width, std::size_t pixelSize)
+{
+    return (width * pixelSize + 3) / 4 * 4;
+}
+
+// next mip level with a 2x2 box filter, odd sizes repeat the last row/column
+Containers::Array<char> downsample(Containers::ArrayView<const char> source,
+                                   Vector2i sourceSize,
+                                   Vector2i size,
+                                   std::size_t pixelSize)
+{
+    const std::size_t sourcePitch = rowPitch(sourceSize.x(), pixelSize);
+    const std::size_t pitch = rowPitch(size.x(), pixelSize);
+    Containers::Array<char> pixels{ ValueInit, pitch * size.y() };
+
+    for(Int y = 0; y < size.y(); y++)
+    {
+        const UnsignedByte* sourcePixels = reinterpret_cast<const UnsignedByte*>(source.data());
+        const UnsignedByte* rows[2] = { sourcePixels + Math::min(2 * y, sourceSize.y() - 1) * sourcePitch,
+                                        sourcePixels + Math::min(2 * y + 1, sourceSize.y() - 1) * sourcePitch };
+        UnsignedByte* out = reinterpret_cast<UnsignedByte*>(pixels.data()) + y * pitch;
+        for(Int x = 0; x < size.x(); x++)
+        {
+            const std::size_t x0 = Math::min(2 * x, sourceSize.x() - 1) * pixelSize;
+            const std::size_t x1 = Math::min(2 * x + 1, sourceSize.x() - 1) * pixelSize;
+            for(std::size_t c = 0; c < pixelSize; c++)
+            {
+                const UnsignedInt sum = rows[0][x0 + c] + rows[0][x1 + c] + rows[1][x0 + c] + rows[1][x1 + c];
+                out[x * pixelSize + c] = UnsignedByte((sum + 2) / 4);
+            }
+        }
+    }
+
+    return pixels;
+}
+
+} // namespace
+
+struct SceneCache::Header
+{
+    char magic[8];
+    UnsignedInt version;
+    UnsignedInt endianness;
+
+    Section dependencies;
+    Section meshes;
+    Section attributes;
+    Section materials;
+    Section materialAttributes;
+    Section textures;
+    Section levels;
+    Section objects;
+    Section meshAssignments;
+};
+
+// path as passed to the importer, relative paths resolve against the working directory
+struct SceneCache::DependencyEntry
+{
+    UnsignedLong pathOffset;
+    UnsignedLong pathSize;
+    UnsignedLong size;
+    Long modified;
+};
+
+struct SceneCache::MeshEntry
+{
+    UnsignedInt flags;
+    UnsignedInt primitive;
+    UnsignedInt indexType;
+    UnsignedInt indexCount;
+    UnsignedInt vertexCount;
+    UnsignedInt firstAttribute;
+    UnsignedInt attributeCount;
+    UnsignedInt padding;
+    // index offset is relative to the index data
+    UnsignedLong indexDataOffset;
+    UnsignedLong indexDataSize;
+    UnsignedLong indexOffset;
+    UnsignedLong vertexDataOffset;
+    UnsignedLong vertexDataSize;
+    Range3D bounds;
+};
+
+struct SceneCache::AttributeEntry
+{
+    UnsignedInt name;
+    UnsignedInt format;
+    // relative to the vertex data
+    UnsignedLong offset;
+    Int stride;
+    UnsignedInt arraySize;
+};
+
+struct SceneCache::MaterialEntry
+{
+    UnsignedInt flags;
+    UnsignedInt types;
+    UnsignedInt firstAttribute;
+    UnsignedInt attributeCount;
+};
+
+struct SceneCache::TextureEntry
+{
+    UnsignedInt flags;
+    UnsignedInt format;
+    UnsignedInt magnificationFilter;
+    UnsignedInt minificationFilter;
+    UnsignedInt mipmapFilter;
+    UnsignedInt wrapping[2];
+    Vector2i size;
+    UnsignedInt firstLevel;
+    UnsignedInt levelCount;
+};
+
+// pixels are tightly packed apart from the default row alignment of 4
+struct SceneCache::LevelEntry
+{
+    Vector2i size;
+    UnsignedLong offset;
+    UnsignedLong dataSize;
+};
+
+// the file is stored as-is, make sure the layout can't silently change
+static_assert(sizeof(Trade::MaterialAttributeData) == 64, "MaterialAttributeData layout changed, bump Version");
+
+Containers::Optional<Containers::Array<char>> SceneCache::build(const char* file)
+{
+    // load importer
+
+    // has to outlive the importer, it may still reference file data until it's destroyed
+    Containers::Array<LoadedFile> files;
+
+    PluginManager::Manager<Trade::AbstractImporter> manager;
+    Containers::Pointer<Trade::AbstractImporter> importer = manager.loadAndInstantiate("AnySceneImporter");
+    if(!importer)
+        return {};
+    importer->setFileCallback(loadFile, &files);
+
+    // the source is always a dependency, even if the importer opens it without the callback
+    const Containers::Optional<FileStamp> sourceStamp = fileStamp(file);
+    if(!sourceStamp)
+        return {};
+    Containers::arrayAppend(files, LoadedFile{ Containers::String{ file }, *sourceStamp, {} });
+
+    // load scene
+
+    if(!importer->openFile(file))
+        return {};
+
+    if(importer->sceneCount() == 0)
+        return {};
+
+    Int sceneId = importer->defaultScene();
+    if(sceneId == -1)
+        sceneId = 0;
+    Containers::Optional<Trade::SceneData> sceneData = importer->scene(sceneId);
+    if(!sceneData)
+        return {};
+
+    if(!sceneData->is3D() ||
+       !sceneData->hasField(Trade::SceneField::Parent) || // TODO does this break files with just one object?
+       !sceneData->hasField(Trade::SceneField::Mesh))
+        return {};
+
+    // header is filled in at the end, blobs follow it and the entry sections come last
+    Containers::Array<char> out;
+    Containers::arrayResize(out, ValueInit, sizeof(Header));
+    Header header;
+    std::memcpy(header.magic, Magic, sizeof(Magic));
+    header.version = Version;
+    header.endianness = Endianness;
+
+    // meshes
+
+    Containers::Array<MeshEntry> meshEntries;
+    Containers::Array<AttributeEntry> attributeEntries;
+
+    for(UnsignedInt i = 0; i < importer->meshCount(); i++)
+    {
+        MeshEntry entry{};
+        Containers::Optional<Trade::MeshData> data = importer->mesh(i);
+        if(data && isSceneMesh(*data))
+        {
+            entry.flags = EntryValid;
+            entry.primitive = UnsignedInt(data->primitive());
+            entry.vertexCount = data->vertexCount();
+            entry.bounds = Range3D(Math::minmax(data->positions3DAsArray()));
+
+            if(data->isIndexed())
+            {
+                entry.flags |= MeshIndexed;
+                entry.indexType = UnsignedInt(data->indexType());
+                entry.indexCount = data->indexCount();
+                entry.indexOffset = data->indexOffset();
+                entry.indexDataSize = data->indexData().size();
+                entry.indexDataOffset = append(out, data->indexData());
+            }
+
+            entry.vertexDataSize = data->vertexData().size();
+            entry.vertexDataOffset = append(out, data->vertexData());
+
+            entry.firstAttribute = attributeEntries.size();
+            entry.attributeCount = data->attributeCount();
+            for(UnsignedInt j = 0; j < data->attributeCount(); j++)
+            {
+                AttributeEntry attribute{};
+                attribute.name = UnsignedInt(data->attributeName(j));
+                attribute.format = UnsignedInt(data->attributeFormat(j));
+                attribute.offset = data->attributeOffset(j);
+                attribute.stride = data->attributeStride(j);
+                attribute.arraySize = data->attributeArraySize(j);
+                Containers::arrayAppend(attributeEntries, attribute);
+            }
+        }
+        else
+            Warning(Warning::Flag::NoSpace)
+                << "Skipping mesh " << i << " (must be a triangle mesh with normals, tangents and UV coordinates)";
+
+        Containers::arrayAppend(meshEntries, entry);
+    }
+
+    // materials
+    // only the base layer is used by the Phong shader, pointer attributes can't be stored
+
+    Containers::Array<MaterialEntry> materialEntries;
+    Containers::Array<Trade::MaterialAttributeData> materialAttributeEntries;
+
+    for(UnsignedInt i = 0; i < importer->materialCount(); i++)
+    {
+        MaterialEntry entry{};
+        Containers::Optional<Trade::MaterialData> data = importer->material(i);
+        if(data && data->types() & Trade::MaterialType::Phong)
+        {
+            entry.flags = EntryValid;
+            entry.types = UnsignedInt(data->types());
+            entry.firstAttribute = materialAttributeEntries.size();
+            for(UnsignedInt j = 0; j < data->attributeCount(0); j++)
+            {
+                const Trade::MaterialAttributeData& attribute = data->attributeData(0, j);
+                if(attribute.type() == Trade::MaterialAttributeType::Pointer ||
+                   attribute.type() == Trade::MaterialAttributeType::MutablePointer)
+                    continue;
+                Containers::arrayAppend(materialAttributeEntries, attribute);
+            }
+            entry.attributeCount = materialAttributeEntries.size() - entry.firstAttribute;
+        }
+        else
+            Warning(Warning::Flag::NoSpace) << "Skipping material " << i << " (not Phong-compatible)";
+
+        Containers::arrayAppend(materialEntries, entry);
+    }
+
+    // textures
+    // mip chains are generated once here so loading doesn't have to
+
+    Containers::Array<TextureEntry> textureEntries;
+    Containers::Array<LevelEntry> levelEntries;
+
+    for(UnsignedInt i = 0; i < importer->textureCount(); i++)
+    {
+        TextureEntry entry{};
+        Containers::Optional<Trade::TextureData> textureData = importer->texture(i);
+        if(textureData && textureData->type() == Trade::TextureType::Texture2D)
+        {
+            Containers::Optional<Trade::ImageData2D> imageData = importer->image2D(textureData->image(), 0 /* level */);
+            if(imageData)
+            {
+                if(imageData->isCompressed() || (imageData->format() != PixelFormat::RGB8Unorm &&
+                                                 imageData->format() != PixelFormat::RGBA8Unorm))
+                {
+                    Warning(Warning::Flag::NoSpace) << "Skipping texture " << i << " (unsupported format)";
+                    Containers::arrayAppend(textureEntries, entry);
+                    continue;
+                }
+
+                entry.flags = EntryValid;
+                entry.format = UnsignedInt(imageData->format());
+                entry.magnificationFilter = UnsignedInt(textureData->magnificationFilter());
+                entry.minificationFilter = UnsignedInt(textureData->minificationFilter());
+                entry.mipmapFilter = UnsignedInt(textureData->mipmapFilter());
+                entry.wrapping[0] = UnsignedInt(textureData->wrapping().x());
+                entry.wrapping[1] = UnsignedInt(textureData->wrapping().y());
+                entry.size = imageData->size();
+                entry.firstLevel = levelEntries.size();
+                entry.levelCount = Math::log2(imageData->size().max()) + 1;
+
+                // repack the first level to the default row alignment, the importer might use any
+                const std::size_t pixelSize = imageData->pixelSize();
+                Vector2i size = imageData->size();
+                Containers::Array<char> pixels{ ValueInit, rowPitch(size.x(), pixelSize) * size.y() };
+                Utility::copy(imageData->pixels(),
+                              Containers::StridedArrayView3D<char>{
+                                  pixels,
+                                  { std::size_t(size.y()), std::size_t(size.x()), pixelSize },
+                                  { std::ptrdiff_t(rowPitch(size.x(), pixelSize)), std::ptrdiff_t(pixelSize), 1 } });
+
+                for(UnsignedInt level = 0; level < entry.levelCount; level++)
+                {
+                    if(level > 0)
+                    {
+                        const Vector2i levelSize = Math::max(size / 2, Vector2i(1));
+                        pixels = downsample(pixels, size, levelSize, pixelSize);
+                        size = levelSize;
+                    }
+
+                    LevelEntry levelEntry{};
+                    levelEntry.size = size;
+                    levelEntry.dataSize = pixels.size();
+                    levelEntry.offset = append(out, pixels);
+                    Containers::arrayAppend(levelEntries, levelEntry);
+                }
+            }
+        }
+
+        Containers::arrayAppend(textureEntries, entry);
+    }
+
+    // objects
+
+    Containers::Array<Object> objects{ ValueInit, std::size_t(sceneData->mappingBound()) };
+    for(const Containers::Pair<UnsignedInt, Int>& parent : sceneData->parentsAsArray())
+    {
+        objects[parent.first()].flags |= Object::Exists;
+        objects[parent.first()].parent = parent.second();
+    }
+
+    for(const Containers::Pair<UnsignedInt, Matrix4>& transformation : sceneData->transformations3DAsArray())
+    {
+        Object& object = objects[transformation.first()];
+        if(object.flags & Object::Exists)
+        {
+            object.flags |= Object::HasTransformation;
+            object.transformation = transformation.second();
+        }
+    }
+
+    Containers::Array<MeshAssignment> meshAssignments;
+    for(const Containers::Pair<UnsignedInt, Containers::Pair<UnsignedInt, Int>>& meshMaterial :
+        sceneData->meshesMaterialsAsArray())
+    {
+        if(objects[meshMaterial.first()].flags & Object::Exists)
+        {
+            Containers::arrayAppend(
+                meshAssignments,
+                MeshAssignment{ meshMaterial.first(), meshMaterial.second().first(), meshMaterial.second().second() });
+        }
+    }
+
+    // dependencies, the importer has read everything it needs by now
+
+    Containers::Array<DependencyEntry> dependencyEntries;
+    for(const LoadedFile& loaded : files)
+    {
+        const UnsignedLong pathOffset = append(out, Containers::arrayView(loaded.path.data(), loaded.path.size()));
+        Containers::arrayAppend(
+            dependencyEntries,
+            DependencyEntry{ pathOffset, loaded.path.size(), loaded.stamp.size, loaded.stamp.modified });
+    }
+
+    // entry sections
+
+    const auto section = [&out](auto entries) {
+        const Containers::ArrayView<const void> data = entries;
+        return Section{ append(out, data), data.size() };
+    };
+
+    header.dependencies = section(Containers::arrayView(dependencyEntries));
+    header.meshes = section(Containers::arrayView(meshEntries));
+    header.attributes = section(Containers::arrayView(attributeEntries));
+    header.materials = section(Containers::arrayView(materialEntries));
+    header.materialAttributes = section(Containers::arrayView(materialAttributeEntries));
+    header.textures = section(Containers::arrayView(textureEntries));
+    header.levels = section(Containers::arrayView(levelEntries));
+    header.objects = section(Containers::arrayView(objects));
+    header.meshAssignments = section(Containers::arrayView(meshAssignments));
+
+    std::memcpy(out.data(), &header, sizeof(Header));
+
+    // turn into a regular array, growable arrays have a custom deleter
+    Containers::arrayShrink(out, DefaultInit);
+    return Containers::optional(std::move(out));
+}
+
+template<typename T> bool SceneCache::section(const Section& section, Containers::ArrayView<const T>& out) const
+{
+    if(!blob(section.offset, section.size) || section.size % sizeof(T) != 0 ||
+       (reinterpret_cast<std::uintptr_t>(data.data()) + section.offset) % alignof(T) != 0)
+        return false;
+
+    out = { reinterpret_cast<const T*>(data.data() + section.offset), std::size_t(section.size / sizeof(T)) };
+    return true;
+}
+
+bool SceneCache::blob(UnsignedLong offset, UnsignedLong size) const
+{
+    return offset <= data.size() && size <= data.size() - offset;
+}
+
+bool SceneCache::open(Containers::ArrayView<const char> data)
+{
+    *this = SceneCache{};
+
+    if(data.size() < sizeof(Header))
+        return false;
+
+    Header header;
+    std::memcpy(&header, data.data(), sizeof(Header));
+    if(std::memcmp(header.magic, Magic, sizeof(Magic)) != 0 || header.version != Version ||
+       header.endianness != Endianness)
+        return false;
+
+    this->data = data;
+
+    // the file is only written by build() and replaced atomically, so the entries themselves are trusted
+    // still check everything that's used to index into the file to catch truncated or foreign data
+    Containers::ArrayView<const DependencyEntry> dependencies;
+    bool valid = section(header.dependencies, dependencies) && section(header.meshes, meshes) &&
+                 section(header.attributes, attributes) && section(header.materials, materials) &&
+                 section(header.materialAttributes, materialAttributes) && section(header.textures, textures) &&
+                 section(header.levels, levels) && section(header.objects, _objects) &&
+                 section(header.meshAssignments, _meshAssignments);
+
+    for(std::size_t i = 0; valid && i < meshes.size(); i++)
+    {
+        const MeshEntry& entry = meshes[i];
+        if(entry.flags & EntryValid)
+            valid = blob(entry.vertexDataOffset, entry.vertexDataSize) &&
+                    (!(entry.flags & MeshIndexed) || blob(entry.indexDataOffset, entry.indexDataSize)) &&
+                    entry.firstAttribute <= attributes.size() &&
+                    entry.attributeCount <= attributes.size() - entry.firstAttribute;
+    }
+
+    for(std::size_t i = 0; valid && i < materials.size(); i++)
+    {
+        const MaterialEntry& entry = materials[i];
+        valid = entry.firstAttribute <= materialAttributes.size() &&
+                entry.attributeCount <= materialAttributes.size() - entry.firstAttribute;
+    }
+
+    for(std::size_t i = 0; valid && i < textures.size(); i++)
+    {
+        const TextureEntry& entry = textures[i];
+        valid = entry.firstLevel <= levels.size() && entry.levelCount <= levels.size() - entry.firstLevel;
+    }
+
+    for(std::size_t i = 0; valid && i < levels.size(); i++)
+        valid = blob(levels[i].offset, levels[i].dataSize);
+
+    for(std::size_t i = 0; valid && i < _objects.size(); i++)
+        valid = _objects[i].parent >= -1 && _objects[i].parent < Int(_objects.size());
+
+    for(std::size_t i = 0; valid && i < _meshAssignments.size(); i++)
+    {
+        const MeshAssignment& assignment = _meshAssignments[i];
+        valid = assignment.object < _objects.size() && assignment.mesh < meshes.size() &&
+                assignment.material >= -1 && assignment.material < Int(materials.size());
+    }
+
+    // stale if the source or any buffer or image it references was edited since build()
+    for(std::size_t i = 0; valid && i < dependencies.size(); i++)
+    {
+        const DependencyEntry& entry = dependencies[i];
+        valid = blob(entry.pathOffset, entry.pathSize);
+        if(valid)
+        {
+            const Containers::String path{ data.data() + entry.pathOffset, std::size_t(entry.pathSize) };
+            const Containers::Optional<FileStamp> stamp = fileStamp(path.data());
+            valid = stamp && stamp->size == entry.size && stamp->modified == entry.modified;
+        }
+    }
+
+    if(!valid)
+        *this = SceneCache{};
+    return valid;
+}
+
+Containers::Optional<Trade::MeshData> SceneCache::mesh(UnsignedInt id) const
+{
+    CORRADE_ASSERT(id < meshes.size(), "SceneCache::mesh(): index out of range", {});
+
+    const MeshEntry& entry = meshes[id];
+    if(!(entry.flags & EntryValid))
+        return {};
+
+    Containers::Array<Trade::MeshAttributeData> attributeData{ entry.attributeCount };
+    for(UnsignedInt i = 0; i < entry.attributeCount; i++)
+    {
+        const AttributeEntry& attribute = attributes[entry.firstAttribute + i];
+        attributeData[i] = Trade::MeshAttributeData{ Trade::MeshAttribute(attribute.name),
+                                                     VertexFormat(attribute.format),
+                                                     std::size_t(attribute.offset),
+                                                     entry.vertexCount,
+                                                     attribute.stride,
+                                                     UnsignedShort(attribute.arraySize) };
+    }
+
+    const MeshPrimitive primitive = MeshPrimitive(entry.primitive);
+    const Containers::ArrayView<const char> vertexData =
+        data.slice(entry.vertexDataOffset, entry.vertexDataOffset + entry.vertexDataSize);
+
+    if(entry.flags & MeshIndexed)
+    {
+        const Containers::ArrayView<const char> indexData =
+            data.slice(entry.indexDataOffset, entry.indexDataOffset + entry.indexDataSize);
+        const MeshIndexType indexType = MeshIndexType(entry.indexType);
+        const Trade::MeshIndexData indices{
+            indexType,
+            indexData.slice(entry.indexOffset, entry.indexOffset + entry.indexCount * meshIndexTypeSize(indexType))
+        };
+        return Trade::MeshData{
+            primitive, {}, indexData, indices, {}, vertexData, std::move(attributeData), entry.vertexCount
+        };
+    }
+
+    return Trade::MeshData{ primitive, {}, vertexData, std::move(attributeData), entry.vertexCount };
+}
+
+bool SceneCache::hasMesh(UnsignedInt id) const
+{
+    CORRADE_ASSERT(id < meshes.size(), "SceneCache::hasMesh(): index out of range", {});
+    return meshes[id].flags & EntryValid;
+}
+
+Range3D SceneCache::meshBounds(UnsignedInt id) const
+{
+    CORRADE_ASSERT(id < meshes.size(), "SceneCache::meshBounds(): index out of range", {});
+    return meshes[id].bounds;
+}
+
+Containers::Optional<Trade::MaterialData> SceneCache::material(UnsignedInt id) const
+{
+    CORRADE_ASSERT(id < materials.size(), "SceneCache::material(): index out of range", {});
+
+    const MaterialEntry& entry = materials[id];
+    if(!(entry.flags & EntryValid))
+        return {};
+
+    Containers::Array<Trade::MaterialAttributeData> attributeData{ NoInit, entry.attributeCount };
+    if(entry.attributeCount > 0)
+        std::memcpy(static_cast<void*>(attributeData.data()),
+                    materialAttributes.data() + entry.firstAttribute,
+                    entry.attributeCount * sizeof(Trade::MaterialAttributeData));
+
+    return Trade::MaterialData{ Trade::MaterialTypes(entry.types), std::move(attributeData) };
+}
+
+UnsignedInt SceneCache::textureLevelCount(UnsignedInt id) const
+{
+    CORRADE_ASSERT(id < textures.size(), "SceneCache::textureLevelCount(): index out of range", {});
+    return textures[id].flags & EntryValid ? textures[id].levelCount : 0;
+}
+
+ImageView2D SceneCache::textureLevel(UnsignedInt id, UnsignedInt level) const
+{
+    CORRADE_ASSERT(level < textureLevelCount(id),
+                   "SceneCache::textureLevel(): index out of range",
+                   (ImageView2D{ PixelFormat::RGBA8Unorm, {} }));
+
+    const TextureEntry& entry = textures[id];
+    const LevelEntry& levelEntry = levels[entry.firstLevel + level];
+    return ImageView2D{ PixelFormat(entry.format),
+                        levelEntry.size,
+                        data.slice(levelEntry.offset, levelEntry.offset + levelEntry.dataSize) };
+}
+
+Containers::Optional<GL::Texture2D> SceneCache::createTexture(UnsignedInt id) const
+{
+    CORRADE_ASSERT(id < textures.size(), "SceneCache::createTexture(): index out of range", {});
+
+    const TextureEntry& entry = textures[id];
+    if(!(entry.flags & EntryValid))
+        return {};
+
+    GL::Texture2D texture;
+    texture.setMagnificationFilter(SamplerFilter(entry.magnificationFilter))
+        .setMinificationFilter(SamplerFilter(entry.minificationFilter), SamplerMipmap(entry.mipmapFilter))
+        .setWrapping({ SamplerWrapping(entry.wrapping[0]), SamplerWrapping(entry.wrapping[1]) })
+        .setStorage(entry.levelCount,
+                    PixelFormat(entry.format) == PixelFormat::RGBA8Unorm ? GL::TextureFormat::RGBA8
+                                                                         : GL::TextureFormat::RGB8,
+                    entry.size);
+
+    return Containers::optional(std::move(texture));
+}
@@ -0,0 +1,130 @@
+#pragma once
+
+#include <Magnum/Magnum.h>
+#include <Magnum/ImageView.h>
+#include <Magnum/Math/Matrix4.h>
+#include <Magnum/Math/Range.h>
+#include <Magnum/GL/Texture.h>
+#include <Magnum/Trade/MeshData.h>
+#include <Magnum/Trade/MaterialData.h>
+#include <Corrade/Containers/Array.h>
+#include <Corrade/Containers/ArrayView.h>
+#include <Corrade/Containers/Optional.h>
+
+// preprocessed scene in one versioned binary blob
+// everything is stored ready to upload: vertex and index data with their attribute layout, material attributes and
+// complete texture mip chains. loading is a memory map and GL uploads straight from the mapping, the importer
+// plugins, image decoding and mipmap generation only run in build().
+// nothing in here except createTexture() touches GL, building and opening can run on any thread.
+// only meshes, materials and textures usable by Scene are stored, skipped ones keep their index.
+// the format is native endian and specific to Version, anything that doesn't match is rebuilt
+// the size and modification time of the source and every file the importer read (buffers, images) are stored too,
+// editing any of them invalidates the cache
+class SceneCache
+{
+public:
+    static constexpr Magnum::UnsignedInt Version = 2;
+
+    struct Object
+    {
+        enum : Magnum::UnsignedInt
+        {
+            Exists = 1 << 0,
+            HasTransformation = 1 << 1
+        };
+
+        Magnum::UnsignedInt flags;
+        // -1 = scene root
+        Magnum::Int parent;
+        Magnum::Matrix4 transformation;
+    };
+
+    struct MeshAssignment
+    {
+        Magnum::UnsignedInt object;
+        Magnum::UnsignedInt mesh;
+        // -1 = no material
+        Magnum::Int material;
+    };
+
+    // import the default scene of file with AnySceneImporter and convert it
+    static Corrade::Containers::Optional<Corrade::Containers::Array<char>> build(const char* file);
+
+    // data must stay alive as long as anything returned by the cache
+    // returns false if data isn't a complete cache of this version or a file it was built from changed since
+    bool open(Corrade::Containers::ArrayView<const char> data);
+
+    Magnum::UnsignedInt meshCount() const
+    {
+        return Magnum::UnsignedInt(meshes.size());
+    }
+
+    bool hasMesh(Magnum::UnsignedInt id) const;
+    // indexed or non-indexed triangle mesh with positions, normals, tangents and texture coordinates
+    // index and vertex data point into the cache, NullOpt if the mesh was skipped
+    Corrade::Containers::Optional<Magnum::Trade::MeshData> mesh(Magnum::UnsignedInt id) const;
+    // position bounds, calculated in build()
+    Magnum::Range3D meshBounds(Magnum::UnsignedInt id) const;
+
+    Magnum::UnsignedInt materialCount() const
+    {
+        return Magnum::UnsignedInt(materials.size());
+    }
+
+    // Phong material (base layer only), NullOpt if the material was skipped
+    Corrade::Containers::Optional<Magnum::Trade::MaterialData> material(Magnum::UnsignedInt id) const;
+
+    Magnum::UnsignedInt textureCount() const
+    {
+        return Magnum::UnsignedInt(textures.size());
+    }
+
+    // 0 if the texture was skipped
+    Magnum::UnsignedInt textureLevelCount(Magnum::UnsignedInt id) const;
+    // pixels of one mip level with the default row alignment of 4, points into the cache
+    Magnum::ImageView2D textureLevel(Magnum::UnsignedInt id, Magnum::UnsignedInt level) const;
+    // create the texture with sampler state and storage for all levels, but no data
+    // NullOpt if the texture was skipped
+    Corrade::Containers::Optional<Magnum::GL::Texture2D> createTexture(Magnum::UnsignedInt id) const;
+
+    // indexed by object ID
+    Corrade::Containers::ArrayView<const Object> objects() const
+    {
+        return _objects;
+    }
+
+    Corrade::Containers::ArrayView<const MeshAssignment> meshAssignments() const
+    {
+        return _meshAssignments;
+    }
+
+private:
+    // offset and size in bytes, relative to the start of the file
+    struct Section
+    {
+        Magnum::UnsignedLong offset;
+        Magnum::UnsignedLong size;
+    };
+
+    struct Header;
+    struct DependencyEntry;
+    struct MeshEntry;
+    struct AttributeEntry;
+    struct MaterialEntry;
+    struct TextureEntry;
+    struct LevelEntry;
+
+    template<typename T> bool section(const Section& section, Corrade::Containers::ArrayView<const T>& out) const;
+    bool blob(Magnum::UnsignedLong offset, Magnum::UnsignedLong size) const;
+
+    Corrade::Containers::ArrayView<const char> data;
+
+    Corrade::Containers::ArrayView<const MeshEntry> meshes;
+    Corrade::Containers::ArrayView<const AttributeEntry> attributes;
+    Corrade::Containers::ArrayView<const MaterialEntry> materials;
+    Corrade::Containers::ArrayView<const Magnum::Trade::MaterialAttributeData> materialAttributes;
+    Corrade::Containers::ArrayView<const TextureEntry> textures;
+    Corrade::Containers::ArrayView<const LevelEntry> levels;
+    Corrade::Containers::ArrayView<const Object> _objects;
+    Corrade::Containers::ArrayView<const MeshAssignment> _meshAssignments;
+};
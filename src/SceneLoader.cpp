@@ -0,0 +1,139 @@
+#include "SceneLoader.h"
+
+#include <Magnum/ImageView.h>
+#include <Magnum/GL/Context.h>
+#include <Magnum/GL/OpenGL.h>
+#include <Magnum/GL/PixelFormat.h>
+#include <Magnum/Trade/MeshData.h>
+#include <Corrade/Utility/Assert.h>
+#include <Corrade/Utility/Debug.h>
+#include <Corrade/Utility/Format.h>
+#include <utility>
+
+using namespace Magnum;
+using namespace Corrade;
+
+SceneLoader::SceneLoader(const char* file) : file(file), staging(NoCreate)
+{
+    // grows if a single mesh or texture level is larger
+    staging = StreamingBuffer(4 << 20);
+    worker = std::thread(&SceneLoader::load, this);
+}
+
+SceneLoader::~SceneLoader()
+{
+    wait();
+}
+
+void SceneLoader::wait()
+{
+    if(worker.joinable())
+        worker.join();
+}
+
+const SceneCache* SceneLoader::cache() const
+{
+    CORRADE_ASSERT(isReady(), "SceneLoader::cache(): still loading", nullptr);
+    return loaded ? &_cache : nullptr;
+}
+
+void SceneLoader::load()
+{
+    const Containers::String cacheFile = Utility::format("{}.cache", file);
+    if(Utility::Path::exists(cacheFile))
+        mapped = Utility::Path::mapRead(cacheFile);
+
+    loaded = mapped && _cache.open(*mapped);
+    if(!loaded)
+    {
+        Debug() << "Building scene cache" << cacheFile;
+
+        mapped = Containers::NullOpt;
+        Containers::Optional<Containers::Array<char>> data = SceneCache::build(file.data());
+        if(data)
+        {
+            built = std::move(*data);
+
+            // write to a temporary file first so a partially written cache is never picked up
+            const Containers::String tempFile = Utility::format("{}.tmp", cacheFile);
+            if(!Utility::Path::write(tempFile, built) || !Utility::Path::move(tempFile, cacheFile))
+                Warning() << "Couldn't write scene cache" << cacheFile;
+
+            loaded = _cache.open(built);
+            CORRADE_INTERNAL_ASSERT(loaded);
+        }
+    }
+
+    // fault in the mapping here so uploads on the render thread don't wait for the disk
+    if(loaded && mapped)
+    {
+        volatile char sink = 0;
+        for(std::size_t i = 0; i < mapped->size(); i += 4096)
+            sink = sink + (*mapped)[i];
+    }
+
+    ready.store(true, std::memory_order_release);
+}
+
+void SceneLoader::beginUpload()
+{
+    staging.beginFrame();
+}
+
+void SceneLoader::endUpload()
+{
+    staging.endFrame();
+}
+
+std::size_t SceneLoader::uploadMesh(UnsignedInt id, GL::Buffer& indices, GL::Buffer& vertices)
+{
+    Containers::Optional<Trade::MeshData> data = _cache.mesh(id);
+    CORRADE_INTERNAL_ASSERT(data);
+
+    stage(data->indexData(), indices);
+    stage(data->vertexData(), vertices);
+    return data->indexData().size() + data->vertexData().size();
+}
+
+std::size_t SceneLoader::uploadTextureLevel(UnsignedInt id, UnsignedInt level, GL::Texture2D& texture)
+{
+    const ImageView2D image = _cache.textureLevel(id, level);
+    const StreamingBuffer::Allocation allocation = staging.upload(image.data(), 4);
+
+    // Magnum's BufferImage owns its buffer and always starts at offset 0, use GL directly
+    // rows are aligned to 4 bytes in the cache, same as the default unpack alignment
+    GL::Context& context = GL::Context::current();
+    context.resetState(GL::Context::State::EnterExternal);
+
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, allocation.buffer->id());
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+    glPixelStorei(GL_UNPACK_SKIP_ROWS, 0);
+    glPixelStorei(GL_UNPACK_SKIP_PIXELS, 0);
+    glBindTexture(GL_TEXTURE_2D, texture.id());
+    glTexSubImage2D(GL_TEXTURE_2D,
+                    level,
+                    0,
+                    0,
+                    image.size().x(),
+                    image.size().y(),
+                    GLenum(GL::pixelFormat(image.format())),
+                    GLenum(GL::pixelType(image.format())),
+                    reinterpret_cast<const void*>(allocation.offset));
+    glBindTexture(GL_TEXTURE_2D, 0);
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+    context.resetState(GL::Context::State::ExitExternal);
+
+    return image.data().size();
+}
+
+void SceneLoader::stage(Containers::ArrayView<const void> data, GL::Buffer& buffer)
+{
+    buffer.setData({ nullptr, data.size() }, GL::BufferUsage::StaticDraw);
+    if(data.isEmpty())
+        return;
+
+    const StreamingBuffer::Allocation allocation = staging.upload(data, 4);
+    GL::Buffer::copy(*allocation.buffer, buffer, allocation.offset, 0, data.size());
+}
@@ -0,0 +1,74 @@
+#pragma once
+
+#include "SceneCache.h"
+#include "StreamingBuffer.h"
+#include <Magnum/Magnum.h>
+#include <Magnum/GL/Buffer.h>
+#include <Magnum/GL/Texture.h>
+#include <Corrade/Containers/Array.h>
+#include <Corrade/Containers/Optional.h>
+#include <Corrade/Containers/String.h>
+#include <Corrade/Utility/Path.h>
+#include <atomic>
+#include <cstddef>
+#include <thread>
+
+// loads a scene cache on a background thread and uploads it in slices on the render thread
+// the worker maps the cache next to the source file, or imports the source and builds the cache if it's missing
+// or outdated. it only touches files and memory, never GL.
+// uploads copy through a staging buffer (a pixel unpack buffer for textures) so the driver can schedule the
+// transfers instead of blocking on them
+class SceneLoader
+{
+public:
+    // starts loading right away
+    explicit SceneLoader(const char* file);
+    ~SceneLoader();
+
+    // Copying is not allowed
+    SceneLoader(const SceneLoader&) = delete;
+    SceneLoader& operator=(const SceneLoader&) = delete;
+
+    // Moving is not allowed, the worker references this
+    SceneLoader(SceneLoader&&) = delete;
+    SceneLoader& operator=(SceneLoader&&) = delete;
+
+    // the worker is done, successfully or not
+    bool isReady() const
+    {
+        return ready.load(std::memory_order_acquire);
+    }
+
+    // blocks until isReady()
+    void wait();
+
+    // nullptr if loading failed, only call once isReady()
+    const SceneCache* cache() const;
+
+    // everything below has to be called from the render thread
+
+    // uploads of one frame have to be enclosed by these, see StreamingBuffer
+    void beginUpload();
+    void endUpload();
+
+    // upload index and vertex data of a cached mesh, returns the size in bytes
+    std::size_t uploadMesh(Magnum::UnsignedInt id, Magnum::GL::Buffer& indices, Magnum::GL::Buffer& vertices);
+    // upload one level of a texture created with SceneCache::createTexture(), returns the size in bytes
+    std::size_t uploadTextureLevel(Magnum::UnsignedInt id, Magnum::UnsignedInt level, Magnum::GL::Texture2D& texture);
+
+private:
+    void load();
+    void stage(Corrade::Containers::ArrayView<const void> data, Magnum::GL::Buffer& buffer);
+
+    Corrade::Containers::String file;
+    std::thread worker;
+    std::atomic<bool> ready { false };
+
+    // written by the worker before ready is set
+    bool loaded = false;
+    SceneCache _cache;
+    Corrade::Containers::Optional<Corrade::Containers::Array<const char, Corrade::Utility::Path::MapDeleter>> mapped;
+    Corrade::Containers::Array<char> built;
+
+    StreamingBuffer staging;
+};
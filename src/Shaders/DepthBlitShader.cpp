@@ -1,5 +1,6 @@
 #include "DepthBlitShader.h"
 
+#include "ProgramCache.h"
 #include <Magnum/GL/Shader.h>
 #include <Magnum/GL/Texture.h>
 #include <Corrade/Containers/Reference.h>
@@ -11,8 +12,12 @@ using namespace Magnum;
 
 DepthBlitShader::DepthBlitShader(NoCreateT) : GL::AbstractShaderProgram(NoCreate) { }
 
-DepthBlitShader::DepthBlitShader()
+DepthBlitShader::DepthBlitShader() : DepthBlitShader(compile()) { }
+
+DepthBlitShader::CompileState DepthBlitShader::compile()
 {
+    DepthBlitShader out(NoInit);
+
     GL::Shader vert(GLVersion, GL::Shader::Type::Vertex);
     GL::Shader frag(GLVersion, GL::Shader::Type::Fragment);
 
@@ -20,11 +25,33 @@ DepthBlitShader::DepthBlitShader()
     vert.addSource(rs.getString("DepthBlitShader.vert"));
     frag.addSource(rs.getString("DepthBlitShader.frag"));
 
-    CORRADE_INTERNAL_ASSERT_OUTPUT(GL::Shader::compile({ vert, frag }));
-    attachShaders({ vert, frag });
-    CORRADE_INTERNAL_ASSERT_OUTPUT(link());
+    const UnsignedLong key = ProgramCache::key({ vert, frag });
+    const bool cached = ProgramCache::load(out, key);
+    if(!cached)
+    {
+        vert.submitCompile();
+        frag.submitCompile();
+        out.attachShaders({ vert, frag });
+        ProgramCache::prepare(out);
+        out.submitLink();
+    }
+
+    return CompileState(std::move(out), std::move(vert), std::move(frag), key, cached);
+}
+
+DepthBlitShader::DepthBlitShader(CompileState&& state) :
+    DepthBlitShader(static_cast<DepthBlitShader&&>(std::move(state)))
+{
+    if(!state.cached)
+    {
+        CORRADE_INTERNAL_ASSERT_OUTPUT(checkLink({ state.vert, state.frag }));
+        ProgramCache::save(*this, state.key);
+    }
 
     setUniform(uniformLocation("depth"), DepthTextureUnit);
+
+    quadrantUniform = uniformLocation("quadrant");
+    setQuadrant(-1);
 }
 
 DepthBlitShader& DepthBlitShader::bindDepth(GL::Texture2D& attachment)
@@ -32,3 +59,9 @@ DepthBlitShader& DepthBlitShader::bindDepth(GL::Texture2D& attachment)
     attachment.bind(DepthTextureUnit);
     return *this;
 }
+
+DepthBlitShader& DepthBlitShader::setQuadrant(Int quadrant)
+{
+    setUniform(quadrantUniform, quadrant);
+    return *this;
+}
@@ -3,6 +3,8 @@
 #extension GL_ARB_sample_shading : require
 
 uniform sampler2D depth; // full-resolution velocity pass depth
+// quadrant each quarter-res pixel was jittered onto, -1 = one per sample
+uniform int quadrant;
 
 // downsample depth buffer to quarter-size 2X multisampled depth
 
@@ -14,5 +16,7 @@ void main()
     // let each sample copy the depth value from the full screen pass
     // this works because we know exactly which pixels the samples fall on
     // requires per-sample shading, which is forced on by using gl_SampleID
-    gl_FragDepth = texelFetch(depth, coords + ivec2(1 - gl_SampleID), 0).x;
+    // the four-frame cycle renders without multisampling, every sample gets the jittered pixel center
+    ivec2 offset = quadrant < 0 ? ivec2(1 - gl_SampleID) : ivec2(quadrant & 1, quadrant >> 1);
+    gl_FragDepth = texelFetch(depth, coords + offset, 0).x;
 }
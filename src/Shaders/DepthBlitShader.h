@@ -1,17 +1,31 @@
 #pragma once
 
 #include <Magnum/GL/AbstractShaderProgram.h>
+#include <Magnum/GL/Shader.h>
 #include <Magnum/GL/Version.h>
+#include <utility>
 
 class DepthBlitShader : public Magnum::GL::AbstractShaderProgram
 {
 public:
+    class CompileState;
+
     explicit DepthBlitShader(Magnum::NoCreateT);
     explicit DepthBlitShader();
+    // finish a program started with compile()
+    explicit DepthBlitShader(CompileState&& state);
+
+    // load the program from ProgramCache, or submit compilation and linking without waiting for them
+    static CompileState compile();
 
     DepthBlitShader& bindDepth(Magnum::GL::Texture2D& attachment);
+    // full-res pixel in each 2x2 block to copy to all samples, -1 copies the pixel under each sample instead
+    DepthBlitShader& setQuadrant(Magnum::Int quadrant);
 
 private:
+    // creates the program object, compile() sets it up
+    explicit DepthBlitShader(Magnum::NoInitT) { }
+
     using Magnum::GL::AbstractShaderProgram::drawTransformFeedback;
     using Magnum::GL::AbstractShaderProgram::dispatchCompute;
 
@@ -21,4 +35,27 @@ private:
     {
         DepthTextureUnit = 0
     };
+
+    Magnum::Int quadrantUniform = -1;
+};
+
+class DepthBlitShader::CompileState : public DepthBlitShader
+{
+private:
+    friend class DepthBlitShader;
+
+    explicit CompileState(DepthBlitShader&& shader,
+                          Magnum::GL::Shader&& vert,
+                          Magnum::GL::Shader&& frag,
+                          Magnum::UnsignedLong key,
+                          bool cached) :
+        DepthBlitShader(std::move(shader)), vert(std::move(vert)), frag(std::move(frag)), key(key), cached(cached)
+    {
+    }
+
+    Magnum::GL::Shader vert;
+    Magnum::GL::Shader frag;
+    Magnum::UnsignedLong key;
+    // linked from the binary cache, vert and frag were never compiled
+    bool cached;
 };
@@ -0,0 +1,84 @@
+#include "HiZShader.h"
+
+#include "ProgramCache.h"
+#include <Magnum/GL/Context.h>
+#include <Magnum/GL/Shader.h>
+#include <Magnum/GL/Texture.h>
+#include <Magnum/GL/TextureFormat.h>
+#include <Magnum/GL/ImageFormat.h>
+#include <Magnum/GL/Renderer.h>
+#include <Magnum/Math/Functions.h>
+#include <Corrade/Containers/Reference.h>
+#include <Corrade/Containers/StringView.h>
+#include <Corrade/Containers/StringStl.h>
+#include <Corrade/Utility/Resource.h>
+#include <Corrade/Utility/FormatStl.h>
+
+using namespace Magnum;
+
+HiZShader::HiZShader(NoCreateT) : GL::AbstractShaderProgram(NoCreate) { }
+
+HiZShader::HiZShader()
+{
+    CORRADE_ASSERT(isSupported(), "HiZShader: requires OpenGL 4.3", );
+
+    GL::Shader comp(GLVersion, GL::Shader::Type::Compute);
+
+    Utility::Resource rs("shaders");
+
+    comp.addSource(Utility::formatString("#define GROUP_SIZE {}\n", GroupSize));
+    comp.addSource(rs.getString("HiZShader.comp"));
+
+    const UnsignedLong key = ProgramCache::key({ comp });
+    if(!ProgramCache::load(*this, key))
+    {
+        CORRADE_INTERNAL_ASSERT_OUTPUT(comp.compile());
+        attachShader(comp);
+        ProgramCache::prepare(*this);
+        CORRADE_INTERNAL_ASSERT_OUTPUT(link());
+        ProgramCache::save(*this, key);
+    }
+
+    setUniform(uniformLocation("source"), SourceTextureUnit);
+    setUniform(uniformLocation("destination"), DestinationImageUnit);
+
+    sourceLevelUniform = uniformLocation("sourceLevel");
+}
+
+bool HiZShader::isSupported()
+{
+    return GL::Context::current().isVersionSupported(GLVersion);
+}
+
+GL::Texture2D HiZShader::createPyramid(Vector2i depthSize)
+{
+    const Vector2i size = Math::max(depthSize / 2, Vector2i(1));
+    GL::Texture2D pyramid;
+    // only read with texelFetch
+    pyramid.setMinificationFilter(SamplerFilter::Nearest, SamplerMipmap::Nearest)
+        .setMagnificationFilter(SamplerFilter::Nearest)
+        .setWrapping(GL::SamplerWrapping::ClampToEdge)
+        .setStorage(Math::log2(size.max()) + 1, GL::TextureFormat::R32F, size);
+    return pyramid;
+}
+
+HiZShader& HiZShader::build(GL::Texture2D& depth, GL::Texture2D& pyramid)
+{
+    const Vector2i baseSize = pyramid.imageSize(0);
+    const Int levels = Math::log2(baseSize.max()) + 1;
+    for(Int level = 0; level < levels; level++)
+    {
+        // previous level is written by the previous dispatch
+        GL::Texture2D& source = level == 0 ? depth : pyramid;
+        source.bind(SourceTextureUnit);
+        setUniform(sourceLevelUniform, level == 0 ? 0 : level - 1);
+        pyramid.bindImage(DestinationImageUnit, level, GL::ImageAccess::WriteOnly, GL::ImageFormat::R32F);
+
+        const Vector2i size = Math::max(baseSize >> level, Vector2i(1));
+        dispatchCompute({ Vector2ui((size + Vector2i(GroupSize - 1)) / GroupSize), 1 });
+
+        GL::Renderer::setMemoryBarrier(GL::Renderer::MemoryBarrier::TextureFetch);
+    }
+
+    return *this;
+}
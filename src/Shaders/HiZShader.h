@@ -0,0 +1,43 @@
+#pragma once
+
+#include <Magnum/GL/AbstractShaderProgram.h>
+#include <Magnum/GL/Version.h>
+
+// builds a hierarchical max depth pyramid for occlusion culling
+// level 0 is half the size of the depth texture
+class HiZShader : public Magnum::GL::AbstractShaderProgram
+{
+public:
+    explicit HiZShader(Magnum::NoCreateT);
+    explicit HiZShader();
+
+    // requires GL 4.3 for compute shaders
+    static bool isSupported();
+
+    // create the pyramid texture for depth of the given size
+    static Magnum::GL::Texture2D createPyramid(Magnum::Vector2i depthSize);
+
+    // fill all levels of pyramid from depth
+    HiZShader& build(Magnum::GL::Texture2D& depth, Magnum::GL::Texture2D& pyramid);
+
+private:
+    using Magnum::GL::AbstractShaderProgram::draw;
+    using Magnum::GL::AbstractShaderProgram::drawTransformFeedback;
+    using Magnum::GL::AbstractShaderProgram::dispatchCompute;
+
+    static constexpr Magnum::GL::Version GLVersion = Magnum::GL::Version::GL430;
+
+    static constexpr Magnum::Int GroupSize = 8;
+
+    enum : Magnum::Int
+    {
+        SourceTextureUnit = 0
+    };
+
+    enum : Magnum::Int
+    {
+        DestinationImageUnit = 0
+    };
+
+    Magnum::Int sourceLevelUniform = -1;
+};
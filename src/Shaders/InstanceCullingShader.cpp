@@ -0,0 +1,126 @@
+#include "InstanceCullingShader.h"
+
+#include "ProgramCache.h"
+#include <Magnum/GL/Context.h>
+#include <Magnum/GL/Shader.h>
+#include <Magnum/GL/Texture.h>
+#include <Corrade/Containers/ArrayView.h>
+#include <Corrade/Containers/Reference.h>
+#include <Corrade/Containers/StringView.h>
+#include <Corrade/Containers/StringStl.h>
+#include <Corrade/Utility/Resource.h>
+#include <Corrade/Utility/FormatStl.h>
+
+using namespace Magnum;
+
+InstanceCullingShader::InstanceCullingShader(NoCreateT) : GL::AbstractShaderProgram(NoCreate) { }
+
+InstanceCullingShader::InstanceCullingShader(const Flags flags) : _flags(flags)
+{
+    CORRADE_ASSERT(isSupported(), "InstanceCullingShader: requires OpenGL 4.3", );
+
+    GL::Shader comp(GLVersion, GL::Shader::Type::Compute);
+
+    Utility::Resource rs("shaders");
+
+    comp.addSource(flags & Flag::Occlusion ? "#define OCCLUSION\n" : "");
+    comp.addSource(Utility::formatString("#define GROUP_SIZE {}\n", GroupSize));
+    comp.addSource(rs.getString("InstanceCullingShader.comp"));
+
+    const UnsignedLong key = ProgramCache::key({ comp });
+    if(!ProgramCache::load(*this, key))
+    {
+        CORRADE_INTERNAL_ASSERT_OUTPUT(comp.compile());
+        attachShader(comp);
+        ProgramCache::prepare(*this);
+        CORRADE_INTERNAL_ASSERT_OUTPUT(link());
+        ProgramCache::save(*this, key);
+    }
+
+    instanceCountUniform = uniformLocation("instanceCount");
+    parentTransformationUniform = uniformLocation("parentTransformation");
+    frustumPlanesUniform = uniformLocation("frustumPlanes");
+    boundsCenterUniform = uniformLocation("boundsCenter");
+    boundsExtentUniform = uniformLocation("boundsExtent");
+    orderedColorOffsetUniform = uniformLocation("orderedColorOffset");
+    orderedVelocityOffsetUniform = uniformLocation("orderedVelocityOffset");
+    orderedColorCountUniform = uniformLocation("orderedColorCount");
+    orderedVelocityCountUniform = uniformLocation("orderedVelocityCount");
+    hasOldTransformationsUniform = uniformLocation("hasOldTransformations");
+
+    if(flags & Flag::Occlusion)
+    {
+        setUniform(uniformLocation("hiZ"), HiZTextureUnit);
+        projectionUniform = uniformLocation("projection");
+    }
+}
+
+bool InstanceCullingShader::isSupported()
+{
+    return GL::Context::current().isVersionSupported(GLVersion);
+}
+
+InstanceCullingShader& InstanceCullingShader::setParentTransformation(const Matrix4& transformation)
+{
+    setUniform(parentTransformationUniform, transformation);
+    return *this;
+}
+
+InstanceCullingShader& InstanceCullingShader::setFrustum(const Frustum& frustum)
+{
+    Vector4 planes[6];
+    for(size_t i = 0; i < 6; i++)
+        planes[i] = frustum[i];
+    setUniform(frustumPlanesUniform, Containers::arrayView(planes));
+    return *this;
+}
+
+InstanceCullingShader& InstanceCullingShader::setBounds(const Range3D& bounds)
+{
+    setUniform(boundsCenterUniform, bounds.center());
+    setUniform(boundsExtentUniform, bounds.size() * 0.5f);
+    return *this;
+}
+
+InstanceCullingShader& InstanceCullingShader::setOrderedOffsets(UnsignedInt colorOffset, UnsignedInt velocityOffset)
+{
+    setUniform(orderedColorOffsetUniform, colorOffset);
+    setUniform(orderedVelocityOffsetUniform, velocityOffset);
+    return *this;
+}
+
+InstanceCullingShader& InstanceCullingShader::setOrderedCounts(UnsignedInt colorCount, UnsignedInt velocityCount)
+{
+    setUniform(orderedColorCountUniform, colorCount);
+    setUniform(orderedVelocityCountUniform, velocityCount);
+    return *this;
+}
+
+InstanceCullingShader& InstanceCullingShader::setHasOldTransformations(bool hasOldTransformations)
+{
+    setUniform(hasOldTransformationsUniform, Int(hasOldTransformations));
+    return *this;
+}
+
+InstanceCullingShader& InstanceCullingShader::bindHiZ(GL::Texture2D& pyramid)
+{
+    CORRADE_ASSERT(_flags & Flag::Occlusion, "InstanceCullingShader::bindHiZ(): requires Flag::Occlusion", *this);
+    pyramid.bind(HiZTextureUnit);
+    return *this;
+}
+
+InstanceCullingShader& InstanceCullingShader::setProjectionMatrix(const Matrix4& projection)
+{
+    CORRADE_ASSERT(_flags & Flag::Occlusion,
+                   "InstanceCullingShader::setProjectionMatrix(): requires Flag::Occlusion",
+                   *this);
+    setUniform(projectionUniform, projection);
+    return *this;
+}
+
+InstanceCullingShader& InstanceCullingShader::dispatch(UnsignedInt instanceCount)
+{
+    setUniform(instanceCountUniform, instanceCount);
+    dispatchCompute({ (instanceCount + GroupSize - 1) / GroupSize, 1, 1 });
+    return *this;
+}
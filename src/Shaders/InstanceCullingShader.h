@@ -0,0 +1,94 @@
+#pragma once
+
+#include <Magnum/GL/AbstractShaderProgram.h>
+#include <Magnum/GL/Version.h>
+#include <Magnum/Math/Matrix4.h>
+#include <Magnum/Math/Range.h>
+#include <Magnum/Math/Frustum.h>
+#include <Corrade/Containers/EnumSet.h>
+
+// GPU frustum culling and instance packing, see GpuInstances
+class InstanceCullingShader : public Magnum::GL::AbstractShaderProgram
+{
+public:
+    // shader storage buffer bindings
+    enum : Magnum::UnsignedInt
+    {
+        TransformationBuffer = 0,
+        StaticInstanceBuffer = 1,
+        OldTransformationBuffer = 2,
+        ColorOutputBuffer = 3,
+        VelocityOutputBuffer = 4,
+        CommandBuffer = 5,
+        OrderedInstanceBuffer = 6
+    };
+
+    enum class Flag : Magnum::UnsignedShort
+    {
+        // second pass after the depth pyramid is built, only repacks the color output
+        // use bindHiZ() and setProjectionMatrix()
+        Occlusion = 1 << 0
+    };
+
+    typedef Corrade::Containers::EnumSet<Flag> Flags;
+
+    static constexpr Magnum::UnsignedInt GroupSize = 64;
+
+    explicit InstanceCullingShader(Magnum::NoCreateT);
+    explicit InstanceCullingShader(const Flags flags = {});
+
+    Flags flags() const
+    {
+        return _flags;
+    }
+
+    // requires GL 4.3 for compute shaders, shader storage buffers and multi-draw indirect
+    static bool isSupported();
+
+    // camera-relative transformation of the object the instance transformations are relative to
+    InstanceCullingShader& setParentTransformation(const Magnum::Matrix4& transformation);
+    // view space frustum
+    InstanceCullingShader& setFrustum(const Magnum::Frustum& frustum);
+    // local mesh bounds
+    InstanceCullingShader& setBounds(const Magnum::Range3D& bounds);
+    // first output slots of the ordered instances
+    InstanceCullingShader& setOrderedOffsets(Magnum::UnsignedInt colorOffset, Magnum::UnsignedInt velocityOffset);
+    // number of ordered instances, they're sorted back to front among each other
+    InstanceCullingShader& setOrderedCounts(Magnum::UnsignedInt colorCount, Magnum::UnsignedInt velocityCount);
+    InstanceCullingShader& setHasOldTransformations(bool hasOldTransformations);
+
+    // Flag::Occlusion only, max depth pyramid built by HiZShader
+    InstanceCullingShader& bindHiZ(Magnum::GL::Texture2D& pyramid);
+    // Flag::Occlusion only, projection the depth pyramid was rendered with
+    InstanceCullingShader& setProjectionMatrix(const Magnum::Matrix4& projection);
+
+    InstanceCullingShader& dispatch(Magnum::UnsignedInt instanceCount);
+
+private:
+    using Magnum::GL::AbstractShaderProgram::draw;
+    using Magnum::GL::AbstractShaderProgram::drawTransformFeedback;
+    using Magnum::GL::AbstractShaderProgram::dispatchCompute;
+
+    static constexpr Magnum::GL::Version GLVersion = Magnum::GL::Version::GL430;
+
+    enum : Magnum::Int
+    {
+        HiZTextureUnit = 0
+    };
+
+    Flags _flags;
+
+    Magnum::Int instanceCountUniform = -1;
+    Magnum::Int parentTransformationUniform = -1;
+    Magnum::Int frustumPlanesUniform = -1;
+    Magnum::Int boundsCenterUniform = -1;
+    Magnum::Int boundsExtentUniform = -1;
+    Magnum::Int orderedColorOffsetUniform = -1;
+    Magnum::Int orderedVelocityOffsetUniform = -1;
+    Magnum::Int orderedColorCountUniform = -1;
+    Magnum::Int orderedVelocityCountUniform = -1;
+    Magnum::Int hasOldTransformationsUniform = -1;
+    Magnum::Int projectionUniform = -1;
+};
+
+CORRADE_ENUMSET_OPERATORS(InstanceCullingShader::Flags)
@@ -0,0 +1,62 @@
+#include "LinearDepthShader.h"
+
+#include "ProgramCache.h"
+#include <Magnum/GL/Shader.h>
+#include <Magnum/GL/MultisampleTexture.h>
+#include <Corrade/Containers/Reference.h>
+#include <Corrade/Containers/StringView.h>
+#include <Corrade/Containers/StringStl.h>
+#include <Corrade/Utility/Resource.h>
+#include <Corrade/Utility/FormatStl.h>
+
+using namespace Magnum;
+
+LinearDepthShader::LinearDepthShader(NoCreateT) : GL::AbstractShaderProgram(NoCreate) { }
+
+LinearDepthShader::LinearDepthShader()
+{
+    GL::Shader vert(GLVersion, GL::Shader::Type::Vertex);
+    GL::Shader frag(GLVersion, GL::Shader::Type::Fragment);
+
+    Utility::Resource rs("shaders");
+
+    vert.addSource(rs.getString("LinearDepthShader.vert"));
+
+    frag.addSource(Utility::formatString("#define LINEAR_DEPTH_OUTPUT_ATTRIBUTE_LOCATION {}\n", LinearDepthOutput));
+    frag.addSource(rs.getString("LinearDepthShader.frag"));
+
+    const UnsignedLong key = ProgramCache::key({ vert, frag });
+    if(!ProgramCache::load(*this, key))
+    {
+        CORRADE_INTERNAL_ASSERT_OUTPUT(GL::Shader::compile({ vert, frag }));
+        attachShaders({ vert, frag });
+        ProgramCache::prepare(*this);
+        CORRADE_INTERNAL_ASSERT_OUTPUT(link());
+        ProgramCache::save(*this, key);
+    }
+
+    setUniform(uniformLocation("depth"), DepthTextureUnit);
+
+    layerUniform = uniformLocation("layer");
+    nearUniform = uniformLocation("near");
+    farUniform = uniformLocation("far");
+}
+
+LinearDepthShader& LinearDepthShader::bindDepth(GL::MultisampleTexture2DArray& attachment)
+{
+    attachment.bind(DepthTextureUnit);
+    return *this;
+}
+
+LinearDepthShader& LinearDepthShader::setLayer(Int layer)
+{
+    setUniform(layerUniform, layer);
+    return *this;
+}
+
+LinearDepthShader& LinearDepthShader::setCameraPlanes(float nearPlane, float farPlane)
+{
+    setUniform(nearUniform, nearPlane);
+    setUniform(farUniform, farPlane);
+    return *this;
+}
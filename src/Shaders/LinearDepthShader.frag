@@ -0,0 +1,37 @@
+// sampler2DMS
+// core in 3.2
+#extension GL_ARB_texture_multisample : require
+// layout(location = ...)
+// core in 3.3
+#extension GL_ARB_explicit_attrib_location : require
+
+#ifdef VALIDATION
+#define LINEAR_DEPTH_OUTPUT_ATTRIBUTE_LOCATION 0
+#endif
+
+uniform sampler2DMSArray depth; // quarter-res 2X multisampled depth
+uniform int layer;
+uniform float near;
+uniform float far;
+
+// x = sample 0, y = sample 1
+layout(location = LINEAR_DEPTH_OUTPUT_ATTRIBUTE_LOCATION) out vec2 linearDepth;
+
+// undo depth projection
+// assumes a projection transformation produced by Matrix4::perspectiveProjection with finite far plane
+// solve for view space z: (z(n+f) + 2nf)/(-z(n-f)) = 2w-1
+// w = window space depth [0;1]
+// 2w-1 = NDC space depth [-1;1]
+float screenToViewDepth(float depth)
+{
+    return (far * near) / ((far * depth) - far - (near * depth));
+}
+
+// linearize once per sample here, so the resolve pass doesn't do it for every neighbor it reads
+
+void main()
+{
+    ivec3 coords = ivec3(ivec2(floor(gl_FragCoord.xy)), layer);
+    linearDepth = vec2(screenToViewDepth(texelFetch(depth, coords, 0).x),
+                       screenToViewDepth(texelFetch(depth, coords, 1).x));
+}
@@ -0,0 +1,38 @@
+#pragma once
+
+#include <Magnum/GL/AbstractShaderProgram.h>
+#include <Magnum/GL/Version.h>
+#include <Magnum/Shaders/GenericGL.h>
+
+// converts one layer of the quarter-res 2X multisampled depth to linear view space depth
+// output is a two-channel float texture, one channel per sample
+class LinearDepthShader : public Magnum::GL::AbstractShaderProgram
+{
+public:
+    enum : Magnum::UnsignedInt
+    {
+        LinearDepthOutput = Magnum::Shaders::GenericGL3D::ColorOutput
+    };
+
+    explicit LinearDepthShader(Magnum::NoCreateT);
+    explicit LinearDepthShader();
+
+    LinearDepthShader& bindDepth(Magnum::GL::MultisampleTexture2DArray& attachment);
+    LinearDepthShader& setLayer(Magnum::Int layer);
+    LinearDepthShader& setCameraPlanes(float nearPlane, float farPlane);
+
+private:
+    using Magnum::GL::AbstractShaderProgram::drawTransformFeedback;
+    using Magnum::GL::AbstractShaderProgram::dispatchCompute;
+
+    static constexpr Magnum::GL::Version GLVersion = Magnum::GL::Version::GL300;
+
+    enum : Magnum::Int
+    {
+        DepthTextureUnit = 0
+    };
+
+    Magnum::Int layerUniform = -1;
+    Magnum::Int nearUniform = -1;
+    Magnum::Int farUniform = -1;
+};
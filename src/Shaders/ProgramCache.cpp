@@ -0,0 +1,136 @@
+#include "ProgramCache.h"
+
+#include <Magnum/GL/AbstractShaderProgram.h>
+#include <Magnum/GL/Context.h>
+#include <Magnum/GL/Extensions.h>
+#include <Magnum/GL/OpenGL.h>
+#include <Magnum/GL/Shader.h>
+#include <Corrade/Containers/Array.h>
+#include <Corrade/Containers/Optional.h>
+#include <Corrade/Containers/String.h>
+#include <Corrade/Containers/StringView.h>
+#include <Corrade/Containers/StringStl.h>
+#include <Corrade/Utility/Debug.h>
+#include <Corrade/Utility/Format.h>
+#include <Corrade/Utility/Path.h>
+#include <cstring>
+
+using namespace Magnum;
+using namespace Corrade;
+
+namespace
+{
+
+struct Header
+{
+    char magic[4];
+    GLenum format;
+};
+
+constexpr char Magic[4] = { 'M', 'P', 'B', 'C' };
+
+// 64-bit FNV-1a
+void hash(UnsignedLong& value, Containers::ArrayView<const void> data)
+{
+    for(const char c : Containers::arrayCast<const char>(data))
+    {
+        value ^= UnsignedByte(c);
+        value *= 0x100000001b3ull;
+    }
+}
+
+bool isSupported()
+{
+    return GL::Context::current().isExtensionSupported<GL::Extensions::ARB::get_program_binary>();
+}
+
+Containers::String fileName(UnsignedLong key)
+{
+    return Utility::Path::join(ProgramCache::Directory, Utility::format("{:.16x}.bin", key));
+}
+
+} // namespace
+
+void ProgramCache::setupParallelCompile()
+{
+    if(GL::Context::current().isExtensionSupported<GL::Extensions::KHR::parallel_shader_compile>())
+        glMaxShaderCompilerThreadsKHR(0xffffffffu); // implementation-defined maximum
+}
+
+UnsignedLong ProgramCache::key(Shaders shaders)
+{
+    UnsignedLong value = 0xcbf29ce484222325ull;
+
+    GL::Context& context = GL::Context::current();
+    for(const Containers::StringView string :
+        { Containers::StringView{ context.vendorString() },
+          Containers::StringView{ context.rendererString() },
+          Containers::StringView{ context.versionString() } })
+        hash(value, string);
+
+    for(const GL::Shader& shader : shaders)
+    {
+        const GL::Shader::Type type = shader.type();
+        hash(value, { &type, sizeof(type) });
+        for(const auto& source : shader.sources())
+            hash(value, Containers::StringView{ source });
+    }
+
+    return value;
+}
+
+bool ProgramCache::load(GL::AbstractShaderProgram& program, UnsignedLong key)
+{
+    if(!isSupported())
+        return false;
+
+    const Containers::String file = fileName(key);
+    if(!Utility::Path::exists(file))
+        return false;
+
+    const Containers::Optional<Containers::Array<char>> data = Utility::Path::read(file);
+    if(!data || data->size() <= sizeof(Header))
+        return false;
+
+    Header header;
+    std::memcpy(&header, data->data(), sizeof(Header));
+    if(std::memcmp(header.magic, Magic, sizeof(Magic)) != 0)
+        return false;
+
+    const Containers::ArrayView<const char> binary = data->exceptPrefix(sizeof(Header));
+    glProgramBinary(program.id(), header.format, binary.data(), GLsizei(binary.size()));
+
+    GLint linked = GL_FALSE;
+    glGetProgramiv(program.id(), GL_LINK_STATUS, &linked);
+    return linked == GL_TRUE;
+}
+
+void ProgramCache::prepare(GL::AbstractShaderProgram& program)
+{
+    if(isSupported())
+        glProgramParameteri(program.id(), GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+}
+
+void ProgramCache::save(GL::AbstractShaderProgram& program, UnsignedLong key)
+{
+    if(!isSupported())
+        return;
+
+    GLint size = 0;
+    glGetProgramiv(program.id(), GL_PROGRAM_BINARY_LENGTH, &size);
+    if(size <= 0)
+        return;
+
+    Containers::Array<char> data{ NoInit, sizeof(Header) + std::size_t(size) };
+    Header header;
+    std::memcpy(header.magic, Magic, sizeof(Magic));
+    glGetProgramBinary(program.id(), size, nullptr, &header.format, data.data() + sizeof(Header));
+    std::memcpy(data.data(), &header, sizeof(Header));
+
+    // write to a temporary file first so a partially written binary is never picked up
+    const Containers::String file = fileName(key);
+    const Containers::String tempFile = Utility::format("{}.tmp", file);
+    if(!Utility::Path::make(Directory) || !Utility::Path::write(tempFile, data) ||
+       !Utility::Path::move(tempFile, file))
+        Warning() << "ProgramCache: couldn't write" << file;
+}
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <Magnum/Magnum.h>
+#include <Magnum/GL/GL.h>
+#include <Corrade/Containers/Reference.h>
+#include <initializer_list>
+
+// on-disk cache of linked program binaries (ARB_get_program_binary, core in 4.1)
+// binaries are keyed by a hash of the driver strings and all shader sources, so driver updates and shader changes
+// simply miss the cache. a binary the driver rejects is treated like a miss.
+// usage: compute key() from the shaders with all sources added, try load() and only compile and link on a miss,
+// with prepare() called before linking, then save() the linked program
+class ProgramCache
+{
+public:
+    static constexpr const char* Directory = "shadercache";
+
+    // let the driver compile on multiple threads if KHR_parallel_shader_compile is supported
+    // compilation and linking then return immediately and only block when the result is queried
+    // so construct all independent programs before checking or using any of them, the driver compiles them in
+    // parallel while the rest of the setup runs
+    static void setupParallelCompile();
+
+    typedef std::initializer_list<Corrade::Containers::Reference<const Magnum::GL::Shader>> Shaders;
+
+    static Magnum::UnsignedLong key(Shaders shaders);
+
+    // true if program is linked from the cached binary, attaching shaders isn't necessary then
+    static bool load(Magnum::GL::AbstractShaderProgram& program, Magnum::UnsignedLong key);
+    // ask the driver to keep the binary around, call before linking
+    static void prepare(Magnum::GL::AbstractShaderProgram& program);
+    // call after linking program successfully
+    static void save(Magnum::GL::AbstractShaderProgram& program, Magnum::UnsignedLong key);
+};
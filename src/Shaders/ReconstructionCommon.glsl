@@ -0,0 +1,626 @@
+// checkerboard resolve shared between the fragment and compute shader variants
+// ReconstructionOptions.h has to be included before this
+// the including shader defines fetchColor() and fetchDepth()
+
+#ifndef COMPUTE
+// uniform buffer
+// core in 3.1
+#extension GL_ARB_uniform_buffer_object : require
+// sampler2DMS
+// core in 3.2
+#extension GL_ARB_texture_multisample : require
+// layout(location = ...)
+// core in 3.3
+#extension GL_ARB_explicit_attrib_location : require
+#endif
+
+// References:
+
+//  Checkerboard Rendering for Real-Time Upscaling on Intel Integrated Graphics
+// https://software.intel.com/en-us/articles/checkerboard-rendering-for-real-time-upscaling-on-intel-integrated-graphics
+// - checkerboard pattern, viewport jitter
+// - velocity pass, depth reprojection
+// - initial reconstruction shader with depth-based occlusion test
+
+// Rendering Rainbow Six Siege, Jalal El Mansouri
+// https://twvideo01.ubm-us.net/o1/vault/gdc2016/Presentations/El_Mansouri_Jalal_Rendering_Rainbow_Six.pdf
+// - color clamping and confidence blend
+// - dilated velocity, preserves object silhouette (TODO)
+//   - use velocity of pixel in 3x3 neighboorhood that's closest to the camera
+//   - we need full-res depth here which requires the velocity pass to render the entire scene
+
+// 4K Checkerboard in Battlefield 1 and Mass Effect, Graham Wihlidal
+// http://frostbite-wp-prd.s3.amazonaws.com/wp-content/uploads/2017/03/04173623/GDC-Checkerboard.compressed.pdf
+// - differential blend operator, removes artifacts around object edges
+// - sharpen filter (TODO)
+
+// Dynamic Temporal Antialiasing and Upsampling in Call of Duty, Jorge Jimenez
+// https://www.activision.com/cdn/research/Dynamic_Temporal_Antialiasing_and_Upsampling_in_Call_of_Duty_v4.pdf
+// - composite object velocity with camera velocity (TODO)
+//   - downsample to half-res closest velocity in same pass
+//     - reduces texture reads required, 2 gathers for velocity
+
+// quarter-res 2X multisampled textures
+// one layer per frame in the cycle
+// two frames: even / odd (jittered)
+uniform sampler2DMSArray color;
+
+// quarter-res linear view space depth, same layers as color
+// x = sample 0, y = sample 1
+uniform sampler2DArray linearDepth;
+
+// full-res screen-space velocity buffer
+// .z is a mask for moving objects
+uniform sampler2D velocity;
+
+layout(std140) uniform OptionsBlock
+{
+    // [0] is the last frame, [1] the one before that, ...
+    // the two-frame cycle only uses [0]
+    mat4 prevViewProjection[MAX_FRAMES - 1];
+    mat4 invViewProjection;
+    ivec2 viewport;
+    float near;
+    float far;
+    int currentFrame; // position in the frame cycle (-> index into color and depth array layers)
+    int historyFrames; // previous frames with usable data, 0 after the camera parameters changed
+    int flags;
+    float depthTolerance;
+};
+
+// OPTIONS is defined per program variant, branches on these options are resolved at compile time
+// only the debug options are read from flags
+#define OPTION_SET(OPT) ((OPTIONS & (OPTION_ ## OPT)) != 0)
+#ifdef DEBUG
+#define DEBUG_OPTION_SET(OPT) ((flags & (OPTION_DEBUG_ ## OPT)) != 0)
+#else
+#define DEBUG_OPTION_SET(OPT) (false)
+#endif
+
+// FRAMES is the length of the frame cycle, defined per program variant
+// two frames: checkerboard, two samples per quarter-res pixel and frame (1/2 shading rate)
+// four frames: one sample per quarter-res pixel and frame (1/4 shading rate)
+
+/*
+each quarter-res pixel corresponds to 4 pixels (quadrants) in the full-res output
+
+quadrants:
++---+---+
+| 2 | 3 |
++---+---+
+| 0 | 1 |
++---+---+
+*/
+
+int calculateQuadrant(ivec2 pixelCoords)
+{
+    return (pixelCoords.x & 1) + (pixelCoords.y & 1) * 2;
+}
+
+ivec2 quadrantOffset(int quadrant)
+{
+    return ivec2(quadrant & 1, quadrant >> 1);
+}
+
+#if FRAMES == 4
+
+/*
+the quarter-res pixel center lies on the corner between its quadrants
+each frame jitters the viewport half a full-res pixel in x and y so the center lands on one quadrant,
+rotating through all of them so every full-res pixel is shaded once per cycle
+
+frame 0:     frame 1:     frame 2:     frame 3:
++---+---+    +---+---+    +---+---+    +---+---+
+|   |   |    |   | 1 |    |   |   |    | 3 |   |
++---+---+    +---+---+    +---+---+    +---+---+
+| 0 |   |    |   |   |    |   | 2 |    |   |   |
++---+---+    +---+---+    +---+---+    +---+---+
+
+multisampling is disabled while rendering, both MSAA samples get the same value and only sample 0 is read
+*/
+
+// quadrant rendered in each frame, alternating diagonals so consecutive frames are spread out
+// CheckerboardRenderer jitters in the same order
+const int FRAME_QUADRANTS[4] = int[4](0, 3, 1, 2);
+// inverse of FRAME_QUADRANTS, layer that stores each quadrant
+const int QUADRANT_FRAMES[4] = int[4](0, 2, 3, 1);
+
+bool isFrameQuadrant(int frame, int quadrant)
+{
+    return quadrant == FRAME_QUADRANTS[frame];
+}
+
+vec4 fetchQuadrant(sampler2DMSArray tex, ivec2 coords, int quadrant)
+{
+    return texelFetch(tex, ivec3(coords, QUADRANT_FRAMES[quadrant]), 0);
+}
+
+// same as fetchQuadrant for the linear depth texture, samples are stored in channels
+float fetchLinearDepthQuadrant(ivec2 coords, int quadrant)
+{
+    return texelFetch(linearDepth, ivec3(coords, QUADRANT_FRAMES[quadrant]), 0).x;
+}
+
+#else
+
+/*
+each quarter-res pixel has two MSAA samples at fixed positions
+
+sample positions:
++---+---+
+|   | 0 |
++---+---+
+| 1 |   |
++---+---+
+
+the odd frames' viewport is jittered half a pixel (= one full-res pixel) to the right
+so the sample positions overlap for full coverage across two frames
+
+even:
+    +---+---+
+    |   | 0 |
+    +---+---+
+    | 1 |   |
+    +---+---+
+ 
+odd:
+    +---+---+
+    |   | A |
+    +---+---+
+    | B |   |
+    +---+---+
+ 
+combined:
+    +---+---+
+    | A | 0 |
++---+---+---+
+| B | 1 |   |
++---+---+---+
+*/
+
+// quadrants rendered in each frame
+const ivec2 FRAME_QUADRANTS[2] = ivec2[2](
+    ivec2(3, 0), // even
+    ivec2(2, 1) // odd
+);
+
+bool isFrameQuadrant(int frame, int quadrant)
+{
+    return any(equal(ivec2(quadrant), FRAME_QUADRANTS[frame]));
+}
+
+vec4 fetchQuadrant(sampler2DMSArray tex, ivec2 coords, int quadrant)
+{
+    switch(quadrant)
+    {
+        default:
+        case 0: // (x, y, even/odd), sample
+            return texelFetch(tex, ivec3(coords, 0), 1);
+        case 1:
+            return texelFetch(tex, ivec3(coords + ivec2(1, 0), 1), 1);
+        case 2:
+            return texelFetch(tex, ivec3(coords, 1), 0);
+        case 3:
+            return texelFetch(tex, ivec3(coords, 0), 0);
+    }
+}
+
+// same as fetchQuadrant for the linear depth texture, samples are stored in channels
+float fetchLinearDepthQuadrant(ivec2 coords, int quadrant)
+{
+    switch(quadrant)
+    {
+        default:
+        case 0:
+            return texelFetch(linearDepth, ivec3(coords, 0), 0).y;
+        case 1:
+            return texelFetch(linearDepth, ivec3(coords + ivec2(1, 0), 1), 0).y;
+        case 2:
+            return texelFetch(linearDepth, ivec3(coords, 1), 0).x;
+        case 3:
+            return texelFetch(linearDepth, ivec3(coords, 0), 0).x;
+    }
+}
+
+#endif
+
+/*
+quadrants to evaluate when averaging values around a quadrant:
+
+0:
+   +---+---+
+   | 0 |   |
+---+---+---+
+ 1 | X | 1 |
+---+---+---+
+   | 0 |
+
+1:
+   +---+---+
+   |   | 0 |
+   +---+---+---
+   | 1 | X | 1
+   +---+---+---
+       | 0 |
+
+2:
+   | 1 |
+---+---+---+
+ 0 | X | 0 |
+---+---+---+
+   | 1 |   |
+   +---+---+
+
+3:
+       | 1 |
+   +---+---+---
+   | 0 | X | 0
+   +---+---+---
+   |   | 1 |
+   +---+---+
+*/
+
+#define UP 0
+#define DOWN 1
+#define LEFT 2
+#define RIGHT 3
+
+const ivec2 directionOffsets[4*4] = ivec2[4*4](
+    // quadrant 0
+    ivec2( 0,  0), // up
+    ivec2( 0, -1), // down
+    ivec2(-1,  0), // left
+    ivec2( 0,  0), // right
+    // quadrant 1
+    ivec2( 0,  0),
+    ivec2( 0, -1),
+    ivec2( 0,  0),
+    ivec2(+1,  0),
+    // quadrant 2
+    ivec2( 0, +1),
+    ivec2( 0,  0),
+    ivec2(-1,  0),
+    ivec2( 0,  0),
+    // quadrant 3
+    ivec2( 0, +1),
+    ivec2( 0,  0),
+    ivec2( 0,  0),
+    ivec2(+1,  0)
+);
+
+const ivec4 directionQuadrants[4] = ivec4[4](
+    // quadrant 0
+    ivec4(ivec2(2), ivec2(1)), // up/down, left/right
+    // quadrant 1
+    ivec4(ivec2(3), ivec2(0)),
+    // quadrant 2
+    ivec4(ivec2(0), ivec2(3)),
+    // quadrant 3
+    ivec4(ivec2(1), ivec2(2))
+);
+
+// tonemapping operator for combining HDR colors to prevent bright samples from dominating the result
+// https://gpuopen.com/learn/optimized-reversible-tonemapper-for-resolve/
+
+vec4 tonemap(vec4 color)
+{
+    return color / (max(color.r, max(color.g, color.b)) + 1.0);
+}
+
+vec4 undoTonemap(vec4 color)
+{
+    return color / (1.0 - max(color.r, max(color.g, color.b)));
+}
+
+// color and linear view space depth of a quadrant, see fetchQuadrant
+vec4 fetchColor(ivec2 coords, int quadrant);
+float fetchDepth(ivec2 coords, int quadrant);
+
+struct ColorNeighborhood
+{
+    // values are tonemapped!
+    // if you want to output any of these (or a linear combination of them) use undoTonemap
+    vec4 up;
+    vec4 down;
+    vec4 left;
+    vec4 right;
+};
+
+// differential blend operator
+// look at vertical and horizontal color blend
+// higher weight on whichever has the lowest color difference
+// this greatly reduces checkerboard artifacts at color discontinuities and edges
+
+float colorBlendWeight(vec4 a, vec4 b)
+{
+    return 1.0 / max(length(a.rgb - b.rgb), 0.001);
+}
+
+vec4 differentialBlend(ColorNeighborhood neighbors)
+{
+    float verticalWeight = colorBlendWeight(neighbors.up, neighbors.down);
+    float horizontalWeight = colorBlendWeight(neighbors.left, neighbors.right);
+    vec4 result = (neighbors.up + neighbors.down) * verticalWeight +
+                  (neighbors.left + neighbors.right) * horizontalWeight;
+    return result * 0.5 * 1.0/(verticalWeight + horizontalWeight);
+}
+
+#if FRAMES == 4
+
+// the current frame only has one sample per quarter-res pixel, two full-res pixels apart
+// use the closest ones instead of the direct neighbors:
+// - between two of them horizontally or vertically, up/down and left/right are the same pair
+// - between four of them diagonally, up/down and left/right are the two diagonals
+void neighborCoords(ivec2 coords, int quadrant, out ivec2 neighbors[4])
+{
+    ivec2 delta = coords * 2 + quadrantOffset(quadrant) - quadrantOffset(FRAME_QUADRANTS[currentFrame]);
+    ivec2 base = delta >> 1;
+    ivec2 odd = delta & 1;
+    ivec2 maxCoords = viewport / 2 - 1;
+    bool diagonal = all(equal(odd, ivec2(1)));
+    neighbors[UP] = clamp(base + odd, ivec2(0), maxCoords);
+    neighbors[DOWN] = clamp(base, ivec2(0), maxCoords);
+    neighbors[LEFT] = diagonal ? clamp(base + ivec2(0, 1), ivec2(0), maxCoords) : neighbors[DOWN];
+    neighbors[RIGHT] = diagonal ? clamp(base + ivec2(1, 0), ivec2(0), maxCoords) : neighbors[UP];
+}
+
+void fetchColorNeighborhood(ivec2 coords, int quadrant, out ColorNeighborhood neighbors)
+{
+    ivec2 texels[4];
+    neighborCoords(coords, quadrant, texels);
+    int current = FRAME_QUADRANTS[currentFrame];
+    neighbors.up    = tonemap(fetchColor(texels[UP   ], current));
+    neighbors.down  = tonemap(fetchColor(texels[DOWN ], current));
+    neighbors.left  = tonemap(fetchColor(texels[LEFT ], current));
+    neighbors.right = tonemap(fetchColor(texels[RIGHT], current));
+}
+
+#else
+
+void fetchColorNeighborhood(ivec2 coords, int quadrant, out ColorNeighborhood neighbors)
+{
+    int k = quadrant * 4;
+    neighbors.up    = tonemap(fetchColor(coords + directionOffsets[k + UP   ], directionQuadrants[quadrant][UP   ]));
+    neighbors.down  = tonemap(fetchColor(coords + directionOffsets[k + DOWN ], directionQuadrants[quadrant][DOWN ]));
+    neighbors.left  = tonemap(fetchColor(coords + directionOffsets[k + LEFT ], directionQuadrants[quadrant][LEFT ]));
+    neighbors.right = tonemap(fetchColor(coords + directionOffsets[k + RIGHT], directionQuadrants[quadrant][RIGHT]));
+}
+
+#endif
+
+vec4 colorAverage(ColorNeighborhood neighbors)
+{
+    vec4 result;
+    if(OPTION_SET(DIFFERENTIAL_BLENDING))
+        result = differentialBlend(neighbors);
+    else
+        result = (neighbors.up + neighbors.down + neighbors.left + neighbors.right) * 0.25;
+    return undoTonemap(result);
+}
+
+vec4 colorClamp(ColorNeighborhood neighbors, vec4 color)
+{
+    vec4 minColor = min(min(neighbors.up, neighbors.down), min(neighbors.left, neighbors.right));
+    vec4 maxColor = max(max(neighbors.up, neighbors.down), max(neighbors.left, neighbors.right));
+    return undoTonemap(clamp(tonemap(color), minColor, maxColor));
+}
+
+// apply depth projection to view space depth, inverse of screenToViewDepth in LinearDepthShader
+// assumes a projection transformation produced by Matrix4::perspectiveProjection with finite far plane
+// NDC space depth = (z(n+f) + 2nf)/(-z(n-f))
+float viewToNdcDepth(float z)
+{
+    return (z * (near + far) + 2.0 * near * far) / (-z * (near - far));
+}
+
+// returns averaged depth in view space
+// depth is linearized up front, averaging non-linear depth buffer values produces incorrect results
+#if FRAMES == 4
+float fetchDepthAverage(ivec2 coords, int quadrant)
+{
+    ivec2 texels[4];
+    neighborCoords(coords, quadrant, texels);
+    int current = FRAME_QUADRANTS[currentFrame];
+    float result =
+        fetchDepth(texels[UP   ], current) +
+        fetchDepth(texels[DOWN ], current) +
+        fetchDepth(texels[LEFT ], current) +
+        fetchDepth(texels[RIGHT], current);
+    return result * 0.25;
+}
+#else
+float fetchDepthAverage(ivec2 coords, int quadrant)
+{
+    int k = quadrant * 4;
+    float result =
+        fetchDepth(coords + directionOffsets[k + UP   ], directionQuadrants[quadrant][UP   ]) +
+        fetchDepth(coords + directionOffsets[k + DOWN ], directionQuadrants[quadrant][DOWN ]) +
+        fetchDepth(coords + directionOffsets[k + LEFT ], directionQuadrants[quadrant][LEFT ]) +
+        fetchDepth(coords + directionOffsets[k + RIGHT], directionQuadrants[quadrant][RIGHT]);
+    return result * 0.25;
+}
+#endif
+
+// get screen space velocity vector from fullscreen coordinates
+// the z component is a mask for dynamic objects, if it's 0 no velocity was calculated at that coordinate
+// and camera reprojection is necessary
+vec3 fetchVelocity(ivec2 coords)
+{
+    return texelFetch(velocity, coords, 0).xyz * vec3(viewport, 1.0);
+}
+
+// get old frame's pixel position based on camera movement
+// unprojects world position from view space depth, then projects into previous frame's screen space
+// age is the number of frames to go back, 1 is the last frame
+ivec2 reprojectPixel(ivec2 coords, float depth, int age)
+{
+    vec2 screen = vec2(coords) + 0.5; // gl_FragCoord x/y are located at half-pixel centers, undo the flooring
+    vec3 ndc = vec3(screen / viewport * 2.0 - 1.0, viewToNdcDepth(depth));
+    vec4 clip = vec4(ndc, 1.0);
+    vec4 world = invViewProjection * clip;
+    world /= world.w;
+    clip = prevViewProjection[age - 1] * world;
+    ndc = clip.xyz / clip.w;
+    screen = (ndc.xy * 0.5 + 0.5) * viewport;
+    coords = ivec2(floor(screen));
+    return coords;
+}
+
+// resolve a single full-res pixel
+vec4 resolve(ivec2 coords)
+{
+    // pixel center, same as gl_FragCoord.xy in a fullscreen pass
+    vec2 screen = vec2(coords) + 0.5;
+    ivec2 halfCoords = coords >> 1;
+    int quadrant = calculateQuadrant(coords);
+
+    // debug output: velocity buffer
+    if(DEBUG_OPTION_SET(SHOW_VELOCITY))
+    {
+        vec2 vel = texelFetch(velocity, coords, 0).xy;
+        return vec4(abs(vel * 255.0), 0.0, 1.0);
+    }
+
+    // debug output: checkered frame
+    // with four frames, these are the first two frames of the cycle
+    if(DEBUG_OPTION_SET(SHOW_SAMPLES))
+    {
+        int sampleFrame = DEBUG_OPTION_SET(SHOW_EVEN_SAMPLES) ? 0 : 1;
+        if(isFrameQuadrant(sampleFrame, quadrant))
+            return fetchColor(halfCoords, quadrant);
+        else
+            return vec4(0.0, 0.0, 0.0, 0.0);
+    }
+
+    // was this pixel rendered with the most recent frame?
+    // -> just use it
+    if(isFrameQuadrant(currentFrame, quadrant))
+    {
+        return fetchColor(halfCoords, quadrant);
+    }
+
+    ColorNeighborhood neighbors;
+    fetchColorNeighborhood(halfCoords, quadrant, neighbors);
+
+    // we have no old data, use average
+    if(historyFrames == 0)
+    {
+        return colorAverage(neighbors);
+    }
+
+    bool possiblyOccluded = false;
+
+    // find pixel position in previous frames
+
+    vec2 screenVelocity = vec2(0.0);
+    bool velocityFromDepth = true;
+
+    // for fully general results, sample from a velocity buffer
+    if(OPTION_SET(USE_VELOCITY_BUFFER))
+    {
+        vec3 velocity = fetchVelocity(coords);
+        // z is a mask for dynamic objects
+        if(velocity.z > 0.0)
+        {
+            screenVelocity = velocity.xy;
+            velocityFromDepth = false;
+        }
+        else
+        {
+            // force occlusion check to prevent ghosting around previously
+            // occluded pixels
+            // if we only check for quarter-pixel movement, we'd see (0,0) movement in
+            // that case and directly use the old frame's, but we need to average			
+            possiblyOccluded = true;
+        }
+    }
+
+    // if we're not using a velocity buffer or the object is static, reproject using the camera transformation
+    float z = velocityFromDepth ? fetchDepth(halfCoords, quadrant) : 0.0;
+
+    // go back frame by frame until one of them rendered the previous position
+    // there's only one candidate with two frames
+    // the velocity buffer only covers the last frame, older frames assume constant velocity
+    ivec2 oldCoords = coords;
+    int oldQuadrant = quadrant;
+    bool outsideScreen = false;
+    bool rendered = false;
+    int ages = min(historyFrames, FRAMES - 1);
+    for(int age = 1; age <= ages && !rendered; age++)
+    {
+        if(velocityFromDepth)
+            oldCoords = reprojectPixel(coords, z, age);
+        else
+            oldCoords = ivec2(floor(screen - screenVelocity * float(age)));
+        oldQuadrant = calculateQuadrant(oldCoords);
+
+        // is the previous position outside the screen?
+        // is the previous position not in that frame's quadrants?
+        // this happens when any movement cancelled the jitter
+        // -> there's no shading information
+        if(any(lessThan(oldCoords, ivec2(0, 0))) || any(greaterThanEqual(oldCoords, viewport)))
+            outsideScreen = true;
+        else
+            rendered = isFrameQuadrant((currentFrame + FRAMES - age) % FRAMES, oldQuadrant);
+    }
+
+    if(!rendered)
+    {
+        if(DEBUG_OPTION_SET(SHOW_COLORS))
+            return outsideScreen ? vec4(1.0, 1.0, 0.0, 1.0) : vec4(0.0, 1.0, 1.0, 1.0);
+        else
+            return colorAverage(neighbors);
+    }
+
+    ivec2 oldHalfCoords = oldCoords >> 1;
+
+    // TODO
+    // this eliminates jitter, but breaks with smearing everywhere
+    // occlusion?
+    //return fetchColor(oldHalfCoords, oldQuadrant);
+
+    // check for occlusion if the old position was in a different quarter-res pixel
+    if(any(greaterThan(abs(oldHalfCoords - halfCoords), ivec2(0))))
+    {
+        possiblyOccluded = true;
+    }
+
+    // check for occlusion
+    // simple variant: always assume occlusion
+    bool occluded = possiblyOccluded && OPTION_SET(ASSUME_OCCLUSION);
+
+    // needed for the occlusion heuristic and the confidence blend below, only fetch them once
+    float currentDepthAverage = 0.0;
+    float oldDepth = 0.0;
+    if(!occluded)
+    {
+        currentDepthAverage = fetchDepthAverage(halfCoords, quadrant);
+        oldDepth = fetchDepth(oldHalfCoords, oldQuadrant);
+    }
+
+    // more correct heuristic: check depth against current depth average
+    if(possiblyOccluded && !occluded)
+    {
+        occluded = abs(currentDepthAverage - oldDepth) >= depthTolerance;
+    }
+
+    if(occluded)
+    {
+        if(DEBUG_OPTION_SET(SHOW_COLORS))
+            return vec4(1.0, 0.0, 1.0, 1.0);
+        else
+            return colorAverage(neighbors);
+    }
+
+    // clamp color based on neighbors
+    vec4 reprojectedColor = fetchColor(oldHalfCoords, oldQuadrant);
+    vec4 clampedColor = colorClamp(neighbors, reprojectedColor);
+
+    // blend back towards reprojected result using confidence based on old depth
+    float diff = abs(currentDepthAverage - oldDepth);
+    // reuse depthTolerance to indicate 0 confidence cutoff
+    // square falloff
+    float deviation = diff - depthTolerance;
+    float confidence = clamp(deviation * deviation, 0.0, 1.0);
+    return mix(clampedColor, reprojectedColor, confidence);
+}
@@ -14,4 +14,7 @@
 #define OPTION_DEBUG_SHOW_VELOCITY (1 << 5)
 #define OPTION_DEBUG_SHOW_COLORS (1 << 6)
 
+// longest frame cycle, the uniform buffer always has room for its history
+#define MAX_FRAMES 4
+
 #endif
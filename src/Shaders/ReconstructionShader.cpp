@@ -1,9 +1,14 @@
 #include "ReconstructionShader.h"
 
 #include "ReconstructionOptions.h"
+#include "ProgramCache.h"
+#include <Magnum/GL/Context.h>
 #include <Magnum/GL/Shader.h>
+#include <Magnum/GL/ImageFormat.h>
 #include <Magnum/GL/MultisampleTexture.h>
 #include <Magnum/GL/Texture.h>
+#include <Magnum/GL/TextureArray.h>
+#include <Magnum/Math/Functions.h>
 #include <Corrade/Containers/Reference.h>
 #include <Corrade/Containers/StringView.h>
 #include <Corrade/Containers/StringStl.h>
@@ -12,35 +17,141 @@
 
 using namespace Magnum;
 
-ReconstructionShader::ReconstructionShader(NoCreateT) : GL::AbstractShaderProgram(NoCreate), optionsBuffer(NoCreate) { }
+ReconstructionShader::ReconstructionShader(NoCreateT) : GL::AbstractShaderProgram(NoCreate) { }
 
-ReconstructionShader::ReconstructionShader(const Flags flags) : _flags(flags)
+ReconstructionShader::ReconstructionShader(const Flags flags) : ReconstructionShader(compile(flags)) { }
+
+ReconstructionShader::CompileState ReconstructionShader::compile(const Flags flags)
 {
-    GL::Shader vert(GLVersion, GL::Shader::Type::Vertex);
-    GL::Shader frag(GLVersion, GL::Shader::Type::Fragment);
+    ReconstructionShader out(NoInit);
+    out._flags = flags;
 
     Utility::Resource rs("shaders");
 
-    vert.addSource(rs.getString("ReconstructionShader.vert"));
+    GLint options = 0;
+    if(flags & Flag::VelocityBuffer)
+        options |= OPTION_USE_VELOCITY_BUFFER;
+    if(flags & Flag::AssumeOcclusion)
+        options |= OPTION_ASSUME_OCCLUSION;
+    if(flags & Flag::DifferentialBlending)
+        options |= OPTION_DIFFERENTIAL_BLENDING;
+    const std::string optionsDefine = Utility::formatString("#define OPTIONS {}\n#define FRAMES {}\n",
+                                                            options,
+                                                            flags & Flag::FourFrames ? 4 : 2);
+
+    GL::Shader vert(NoCreate);
+    GL::Shader frag(NoCreate);
+    GL::Shader comp(NoCreate);
+    UnsignedLong key;
+
+    if(flags & Flag::Compute)
+    {
+        CORRADE_ASSERT(isComputeSupported(),
+                       "ReconstructionShader: compute resolve requires OpenGL 4.3",
+                       CompileState(std::move(out), std::move(vert), std::move(frag), std::move(comp), 0, true));
+
+        comp = GL::Shader(ComputeGLVersion, GL::Shader::Type::Compute);
+
+        comp.addSource(flags & Flag::Debug ? "#define DEBUG\n" : "");
+        comp.addSource(optionsDefine);
+        comp.addSource("#define COMPUTE\n");
+        comp.addSource(Utility::formatString("#define GROUP_SIZE {}\n", ComputeGroupSize));
+        comp.addSource(rs.getString("ReconstructionOptions.h"));
+        comp.addSource(rs.getString("ReconstructionCommon.glsl"));
+        comp.addSource(rs.getString("ReconstructionShader.comp"));
+
+        key = ProgramCache::key({ comp });
+    }
+    else
+    {
+        vert = GL::Shader(GLVersion, GL::Shader::Type::Vertex);
+        frag = GL::Shader(GLVersion, GL::Shader::Type::Fragment);
 
-    frag.addSource(flags & Flag::Debug ? "#define DEBUG\n" : "");
-    frag.addSource(Utility::formatString("#define COLOR_OUTPUT_ATTRIBUTE_LOCATION {}\n", ColorOutput));
-    frag.addSource(rs.getString("ReconstructionOptions.h"));
-    frag.addSource(rs.getString("ReconstructionShader.frag"));
+        vert.addSource(rs.getString("ReconstructionShader.vert"));
 
-    // possibly parallel compilation
-    CORRADE_INTERNAL_ASSERT_OUTPUT(GL::Shader::compile({ vert, frag }));
-    attachShaders({ vert, frag });
-    CORRADE_INTERNAL_ASSERT_OUTPUT(link());
+        frag.addSource(flags & Flag::Debug ? "#define DEBUG\n" : "");
+        frag.addSource(optionsDefine);
+        frag.addSource(Utility::formatString("#define COLOR_OUTPUT_ATTRIBUTE_LOCATION {}\n", ColorOutput));
+        frag.addSource(rs.getString("ReconstructionOptions.h"));
+        frag.addSource(rs.getString("ReconstructionCommon.glsl"));
+        frag.addSource(rs.getString("ReconstructionShader.frag"));
+
+        key = ProgramCache::key({ vert, frag });
+    }
+
+    const bool cached = ProgramCache::load(out, key);
+    if(!cached)
+    {
+        if(flags & Flag::Compute)
+        {
+            comp.submitCompile();
+            out.attachShader(comp);
+        }
+        else
+        {
+            vert.submitCompile();
+            frag.submitCompile();
+            out.attachShaders({ vert, frag });
+        }
+        ProgramCache::prepare(out);
+        out.submitLink();
+    }
+
+    return CompileState(std::move(out), std::move(vert), std::move(frag), std::move(comp), key, cached);
+}
+
+ReconstructionShader::ReconstructionShader(CompileState&& state) :
+    ReconstructionShader(static_cast<ReconstructionShader&&>(std::move(state)))
+{
+    if(!state.cached)
+    {
+        if(_flags & Flag::Compute)
+            CORRADE_INTERNAL_ASSERT_OUTPUT(checkLink({ state.comp }));
+        else
+            CORRADE_INTERNAL_ASSERT_OUTPUT(checkLink({ state.vert, state.frag }));
+        ProgramCache::save(*this, state.key);
+    }
 
     setUniform(uniformLocation("color"), ColorTextureUnit);
-    setUniform(uniformLocation("depth"), DepthTextureUnit);
+    setUniform(uniformLocation("linearDepth"), DepthTextureUnit);
     setUniform(uniformLocation("velocity"), VelocityTextureUnit);
+    if(_flags & Flag::Compute)
+        setUniform(uniformLocation("outputImage"), OutputImageUnit);
 
     optionsBlock = uniformBlockIndex("OptionsBlock");
+}
+
+bool ReconstructionShader::isComputeSupported()
+{
+    return GL::Context::current().isVersionSupported(ComputeGLVersion);
+}
+
+ReconstructionShader::Flags ReconstructionShader::variant(const Options::Reconstruction& options)
+{
+    Flags flags;
+    if(options.createVelocityBuffer)
+        flags |= Flag::VelocityBuffer;
+    if(options.assumeOcclusion)
+        flags |= Flag::AssumeOcclusion;
+    if(options.differentialBlending)
+        flags |= Flag::DifferentialBlending;
+    if(options.frames == 4)
+        flags |= Flag::FourFrames;
+    return flags;
+}
 
-    optionsBuffer = GL::Buffer(GL::Buffer::TargetHint::Uniform, { optionsData }, GL::BufferUsage::DynamicDraw);
-    optionsBuffer.setLabel("Checkerboard resolve uniform buffer");
+size_t ReconstructionShader::variantIndex(const Flags flags)
+{
+    size_t index = 0;
+    if(flags & Flag::VelocityBuffer)
+        index |= 1 << 0;
+    if(flags & Flag::AssumeOcclusion)
+        index |= 1 << 1;
+    if(flags & Flag::DifferentialBlending)
+        index |= 1 << 2;
+    if(flags & Flag::FourFrames)
+        index |= 1 << 3;
+    return index;
 }
 
 ReconstructionShader& ReconstructionShader::bindColor(GL::MultisampleTexture2DArray& attachment)
@@ -49,7 +160,7 @@ ReconstructionShader& ReconstructionShader::bindColor(GL::MultisampleTexture2DAr
     return *this;
 }
 
-ReconstructionShader& ReconstructionShader::bindDepth(GL::MultisampleTexture2DArray& attachment)
+ReconstructionShader& ReconstructionShader::bindLinearDepth(GL::Texture2DArray& attachment)
 {
     attachment.bind(DepthTextureUnit);
     return *this;
@@ -61,40 +172,67 @@ ReconstructionShader& ReconstructionShader::bindVelocity(GL::Texture2D& attachme
     return *this;
 }
 
+ReconstructionShader& ReconstructionShader::bindOutput(GL::Texture2D& output)
+{
+    CORRADE_ASSERT(_flags & Flag::Compute, "ReconstructionShader::bindOutput(): requires Flag::Compute", *this);
+    output.bindImage(OutputImageUnit, 0 /* level */, GL::ImageAccess::WriteOnly, GL::ImageFormat::RGBA8);
+    return *this;
+}
+
 ReconstructionShader& ReconstructionShader::setCurrentFrame(Int currentFrame)
 {
     optionsData.currentFrame = currentFrame;
     return *this;
 }
 
-ReconstructionShader& ReconstructionShader::setCameraInfo(SceneGraph::Camera3D& camera, float nearPlane, float farPlane)
+ReconstructionShader& ReconstructionShader::setCameraInfo(SceneGraph::Camera3D& camera,
+                                                          const Vector2i& viewport,
+                                                          float nearPlane,
+                                                          float farPlane)
 {
+    // a new render size invalidates the previous frames as well, they were rendered at a different resolution
     bool projectionChanged = (projection - camera.projectionMatrix()).toVector() != Math::Vector<4 * 4, Float>(0.0f);
-    optionsData.cameraParametersChanged = viewport != camera.viewport() || projectionChanged;
+    const bool cameraParametersChanged = this->viewport != viewport || projectionChanged;
+    historyFrames = cameraParametersChanged ? 0 : Math::min(historyFrames + 1, Int(MaxHistoryFrames));
+    optionsData.historyFrames = historyFrames;
     projection = camera.projectionMatrix();
 
-    viewport = camera.viewport();
+    this->viewport = viewport;
     optionsData.viewport = viewport;
     optionsData.near = nearPlane;
     optionsData.far = farPlane;
 
     const Matrix4 viewProjection = projection * camera.cameraMatrix();
-    optionsData.prevViewProjection = prevViewProjection;
     optionsData.invViewProjection = viewProjection.inverted();
-    prevViewProjection = viewProjection;
+    for(size_t i = MaxHistoryFrames; i > 0; i--)
+    {
+        optionsData.prevViewProjection[i - 1] = prevViewProjection[i - 1];
+        prevViewProjection[i - 1] = i > 1 ? prevViewProjection[i - 2] : viewProjection;
+    }
 
     return *this;
 }
 
+ReconstructionShader& ReconstructionShader::copyCameraInfo(const ReconstructionShader& other)
+{
+    viewport = other.viewport;
+    projection = other.projection;
+    for(size_t i = 0; i < MaxHistoryFrames; i++)
+        prevViewProjection[i] = other.prevViewProjection[i];
+    historyFrames = other.historyFrames;
+    return *this;
+}
+
+ReconstructionShader& ReconstructionShader::invalidateHistory()
+{
+    historyFrames = -1;
+    return *this;
+}
+
 ReconstructionShader& ReconstructionShader::setOptions(const Options::Reconstruction& options)
 {
+    // the other options select the program variant
     GLint flags_bitset = 0;
-    if(options.createVelocityBuffer)
-        flags_bitset |= OPTION_USE_VELOCITY_BUFFER;
-    if(options.assumeOcclusion)
-        flags_bitset |= OPTION_ASSUME_OCCLUSION;
-    if(options.differentialBlending)
-        flags_bitset |= OPTION_DIFFERENTIAL_BLENDING;
     if(options.debug.showSamples != Options::Reconstruction::Debug::Samples::Combined)
         flags_bitset |= OPTION_DEBUG_SHOW_SAMPLES;
     if(options.debug.showSamples == Options::Reconstruction::Debug::Samples::Even)
@@ -109,11 +247,19 @@ ReconstructionShader& ReconstructionShader::setOptions(const Options::Reconstruc
     return *this;
 }
 
-ReconstructionShader& ReconstructionShader::setBuffer()
+ReconstructionShader& ReconstructionShader::setBuffer(StreamingBuffer& streamingBuffer)
+{
+    // a new range of the streaming buffer every frame, so there's no need to orphan or wait
+    const StreamingBuffer::Allocation allocation =
+        streamingBuffer.upload({ &optionsData, sizeof(optionsData) }, GL::Buffer::uniformOffsetAlignment());
+    allocation.buffer->bind(GL::Buffer::Target::Uniform, optionsBlock, allocation.offset, sizeof(optionsData));
+    return *this;
+}
+
+ReconstructionShader& ReconstructionShader::dispatch(const Vector2i& size)
 {
-    // orphan the old buffer to prevent stalls
-    optionsBuffer.setData({ optionsData }, GL::BufferUsage::DynamicDraw);
-    //optionsBuffer.setSubData(0, { optionsData });
-    optionsBuffer.bind(GL::Buffer::Target::Uniform, optionsBlock);
+    CORRADE_ASSERT(_flags & Flag::Compute, "ReconstructionShader::dispatch(): requires Flag::Compute", *this);
+    const Vector2i groups = (size + Vector2i(ComputeGroupSize - 1)) / ComputeGroupSize;
+    dispatchCompute({ Vector2ui(groups), 1 });
     return *this;
 }
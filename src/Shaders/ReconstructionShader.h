@@ -1,12 +1,16 @@
 #pragma once
 
 #include <Magnum/GL/AbstractShaderProgram.h>
+#include <Magnum/GL/Shader.h>
 #include <Magnum/GL/Version.h>
 #include <Magnum/GL/Buffer.h>
 #include <Magnum/Shaders/GenericGL.h>
 #include <Magnum/SceneGraph/Camera.h>
 #include <Corrade/Containers/EnumSet.h>
 #include "Options.h"
+#include "StreamingBuffer.h"
+#include "ReconstructionOptions.h"
+#include <utility>
 
 class ReconstructionShader : public Magnum::GL::AbstractShaderProgram
 {
@@ -19,13 +23,41 @@ public:
     enum class Flag : Magnum::UnsignedShort
     {
         // Debug output (configured through setOptions)
-        Debug = 1 << 0
+        Debug = 1 << 0,
+        // Compute shader resolve into an image instead of a fullscreen pass, requires GL 4.3
+        // use bindOutput() and dispatch() instead of draw()
+        Compute = 1 << 1,
+        // Program variants with the corresponding option compiled in, see variant()
+        VelocityBuffer = 1 << 2,
+        AssumeOcclusion = 1 << 3,
+        DifferentialBlending = 1 << 4,
+        // Four-frame cycle with one sample per quarter-res pixel and frame instead of the two-frame checkerboard
+        FourFrames = 1 << 5
     };
 
     typedef Corrade::Containers::EnumSet<Flag> Flags;
 
+    // number of distinct option variants, see variantIndex()
+    static constexpr size_t VariantCount = 1 << 4;
+
+    class CompileState;
+
     explicit ReconstructionShader(Magnum::NoCreateT);
     explicit ReconstructionShader(const Flags flags);
+    // finish a program started with compile()
+    explicit ReconstructionShader(CompileState&& state);
+
+    // load the program from ProgramCache, or submit compilation and linking without waiting for them
+    // lets the driver work on other programs in the meantime
+    static CompileState compile(const Flags flags);
+
+    static bool isComputeSupported();
+
+    // variant flags for the options that get baked into the program
+    // the shader ignores them in setOptions(), use a program compiled with these flags instead
+    static Flags variant(const Options::Reconstruction& options);
+    // index of the variant flags in [0, VariantCount), the other flags are ignored
+    static size_t variantIndex(const Flags flags);
 
     Flags flags() const
     {
@@ -33,20 +65,44 @@ public:
     };
 
     ReconstructionShader& bindColor(Magnum::GL::MultisampleTexture2DArray& attachment);
-    ReconstructionShader& bindDepth(Magnum::GL::MultisampleTexture2DArray& attachment);
+    // linear view space depth written by LinearDepthShader
+    ReconstructionShader& bindLinearDepth(Magnum::GL::Texture2DArray& attachment);
     ReconstructionShader& bindVelocity(Magnum::GL::Texture2D& attachment);
+    // Flag::Compute only, RGBA8 output
+    ReconstructionShader& bindOutput(Magnum::GL::Texture2D& output);
     ReconstructionShader& setCurrentFrame(Magnum::Int currentFrame);
-    ReconstructionShader& setCameraInfo(Magnum::SceneGraph::Camera3D& camera, float nearPlane, float farPlane);
+    // viewport is the full-res render size, it can be smaller than the camera viewport with dynamic resolution
+    ReconstructionShader& setCameraInfo(Magnum::SceneGraph::Camera3D& camera,
+                                        const Magnum::Vector2i& viewport,
+                                        float nearPlane,
+                                        float farPlane);
+    // take over the previous camera of another program, e.g. when switching to a newly created variant
+    ReconstructionShader& copyCameraInfo(const ReconstructionShader& other);
+    // the previous frames can't be reprojected into, e.g. because the frame cycle changed
+    ReconstructionShader& invalidateHistory();
     ReconstructionShader& setOptions(const Options::Reconstruction& options);
     // call this once before draw, after setting all the data, to transfer the uniform buffer
     // the alternative would be to implement all 6 versions of AbstractShaderProgram::draw()
-    ReconstructionShader& setBuffer();
+    // the data is only valid for the current streaming buffer frame
+    ReconstructionShader& setBuffer(StreamingBuffer& streamingBuffer);
+    // Flag::Compute only, resolve the full-res output of the given size
+    ReconstructionShader& dispatch(const Magnum::Vector2i& size);
 
 private:
+    // creates the program object, compile() sets it up
+    explicit ReconstructionShader(Magnum::NoInitT) { }
+
     using Magnum::GL::AbstractShaderProgram::drawTransformFeedback;
     using Magnum::GL::AbstractShaderProgram::dispatchCompute;
 
     static constexpr Magnum::GL::Version GLVersion = Magnum::GL::Version::GL300;
+    static constexpr Magnum::GL::Version ComputeGLVersion = Magnum::GL::Version::GL430;
+
+    // full-res pixels per workgroup in each dimension, must be even
+    static constexpr Magnum::Int ComputeGroupSize = 16;
+
+    // previous frames the longest frame cycle reprojects into, same array size as in the uniform block
+    static constexpr size_t MaxHistoryFrames = MAX_FRAMES - 1;
 
     Flags _flags;
 
@@ -57,25 +113,62 @@ private:
         VelocityTextureUnit = 2
     };
 
+    enum : Magnum::Int
+    {
+        OutputImageUnit = 0
+    };
+
     Magnum::Int optionsBlock = -1;
-    Magnum::GL::Buffer optionsBuffer;
 
     struct OptionsBufferData
     {
-        Magnum::Matrix4 prevViewProjection = Magnum::Matrix4(Magnum::Math::IdentityInit);
+        // identity by default
+        Magnum::Matrix4 prevViewProjection[MaxHistoryFrames];
         Magnum::Matrix4 invViewProjection = Magnum::Matrix4(Magnum::Math::IdentityInit);
         Magnum::Vector2i viewport = { 0, 0 };
         float near = 0.01f;
         float far = 50.0f;
         GLint currentFrame = 0;
-        GLuint cameraParametersChanged = false;
+        GLint historyFrames = 0;
         GLint flags = 0;
         GLfloat depthTolerance = 0.01f;
     } optionsData;
 
     Magnum::Vector2i viewport = { 0, 0 };
     Magnum::Matrix4 projection = Magnum::Matrix4(Magnum::Math::IdentityInit);
-    Magnum::Matrix4 prevViewProjection = Magnum::Matrix4(Magnum::Math::IdentityInit);
+    // most recent first
+    Magnum::Matrix4 prevViewProjection[MaxHistoryFrames];
+    // previous frames with usable data, -1 until the next setCameraInfo() after invalidateHistory()
+    Magnum::Int historyFrames = 0;
+};
+
+class ReconstructionShader::CompileState : public ReconstructionShader
+{
+private:
+    friend class ReconstructionShader;
+
+    // vert and frag for the fragment shader resolve, only comp with Flag::Compute
+    explicit CompileState(ReconstructionShader&& shader,
+                          Magnum::GL::Shader&& vert,
+                          Magnum::GL::Shader&& frag,
+                          Magnum::GL::Shader&& comp,
+                          Magnum::UnsignedLong key,
+                          bool cached) :
+        ReconstructionShader(std::move(shader)),
+        vert(std::move(vert)),
+        frag(std::move(frag)),
+        comp(std::move(comp)),
+        key(key),
+        cached(cached)
+    {
+    }
+
+    Magnum::GL::Shader vert;
+    Magnum::GL::Shader frag;
+    Magnum::GL::Shader comp;
+    Magnum::UnsignedLong key;
+    // linked from the binary cache, the shaders were never compiled
+    bool cached;
 };
 
 CORRADE_ENUMSET_OPERATORS(ReconstructionShader::Flags)
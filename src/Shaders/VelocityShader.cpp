@@ -1,5 +1,6 @@
 #include "VelocityShader.h"
 
+#include "ProgramCache.h"
 #include <Magnum/GL/Shader.h>
 #include <Corrade/Containers/Reference.h>
 #include <Corrade/Containers/StringView.h>
@@ -11,8 +12,13 @@ using namespace Magnum;
 
 VelocityShader::VelocityShader(NoCreateT) : GL::AbstractShaderProgram(NoCreate) { }
 
-VelocityShader::VelocityShader(const Flags flags) : _flags(flags)
+VelocityShader::VelocityShader(const Flags flags) : VelocityShader(compile(flags)) { }
+
+VelocityShader::CompileState VelocityShader::compile(const Flags flags)
 {
+    VelocityShader out(NoInit);
+    out._flags = flags;
+
     GL::Shader vert(GLVersion, GL::Shader::Type::Vertex);
     GL::Shader frag(GLVersion, GL::Shader::Type::Fragment);
 
@@ -30,9 +36,27 @@ VelocityShader::VelocityShader(const Flags flags) : _flags(flags)
     frag.addSource(Utility::formatString("#define VELOCITY_OUTPUT_ATTRIBUTE_LOCATION {}\n", VelocityOutput));
     frag.addSource(rs.getString("VelocityShader.frag"));
 
-    CORRADE_INTERNAL_ASSERT_OUTPUT(GL::Shader::compile({ vert, frag }));
-    attachShaders({ vert, frag });
-    CORRADE_INTERNAL_ASSERT_OUTPUT(link());
+    const UnsignedLong key = ProgramCache::key({ vert, frag });
+    const bool cached = ProgramCache::load(out, key);
+    if(!cached)
+    {
+        vert.submitCompile();
+        frag.submitCompile();
+        out.attachShaders({ vert, frag });
+        ProgramCache::prepare(out);
+        out.submitLink();
+    }
+
+    return CompileState(std::move(out), std::move(vert), std::move(frag), key, cached);
+}
+
+VelocityShader::VelocityShader(CompileState&& state) : VelocityShader(static_cast<VelocityShader&&>(std::move(state)))
+{
+    if(!state.cached)
+    {
+        CORRADE_INTERNAL_ASSERT_OUTPUT(checkLink({ state.vert, state.frag }));
+        ProgramCache::save(*this, state.key);
+    }
 
     transformationMatrixUniform = uniformLocation("transformationMatrix");
     oldTransformationMatrixUniform = uniformLocation("oldTransformationMatrix");
@@ -1,10 +1,12 @@
 #pragma once
 
 #include <Magnum/GL/AbstractShaderProgram.h>
+#include <Magnum/GL/Shader.h>
 #include <Magnum/GL/Version.h>
 #include <Magnum/Shaders/GenericGL.h>
 #include <Magnum/Math/Matrix4.h>
 #include <Corrade/Containers/EnumSet.h>
+#include <utility>
 
 class VelocityShader : public Magnum::GL::AbstractShaderProgram
 {
@@ -33,8 +35,16 @@ public:
 
     typedef Corrade::Containers::EnumSet<Flag> Flags;
 
+    class CompileState;
+
     explicit VelocityShader(Magnum::NoCreateT);
     explicit VelocityShader(const Flags flags = {});
+    // finish a program started with compile()
+    explicit VelocityShader(CompileState&& state);
+
+    // load the program from ProgramCache, or submit compilation and linking without waiting for them
+    // lets the driver work on other programs in the meantime
+    static CompileState compile(const Flags flags = {});
 
     Flags flags() const
     {
@@ -48,6 +58,9 @@ public:
     VelocityShader& setOldProjectionMatrix(const Magnum::Matrix4& oldProjectionMatrix);
 
 private:
+    // creates the program object, compile() sets it up
+    explicit VelocityShader(Magnum::NoInitT) { }
+
     using Magnum::GL::AbstractShaderProgram::drawTransformFeedback;
     using Magnum::GL::AbstractShaderProgram::dispatchCompute;
 
@@ -61,4 +74,25 @@ private:
     Magnum::Int oldProjectionMatrixUniform = -1;
 };
 
+class VelocityShader::CompileState : public VelocityShader
+{
+private:
+    friend class VelocityShader;
+
+    explicit CompileState(VelocityShader&& shader,
+                          Magnum::GL::Shader&& vert,
+                          Magnum::GL::Shader&& frag,
+                          Magnum::UnsignedLong key,
+                          bool cached) :
+        VelocityShader(std::move(shader)), vert(std::move(vert)), frag(std::move(frag)), key(key), cached(cached)
+    {
+    }
+
+    Magnum::GL::Shader vert;
+    Magnum::GL::Shader frag;
+    Magnum::UnsignedLong key;
+    // linked from the binary cache, vert and frag were never compiled
+    bool cached;
+};
+
 CORRADE_ENUMSET_OPERATORS(VelocityShader::Flags)
@@ -0,0 +1,74 @@
+#ifndef SharedMemoryFormat_h
+#define SharedMemoryFormat_h
+
+#ifdef __cplusplus
+#pragma once
+#endif
+
+/*
+layout of the shared memory ring written by SharedMemoryOutput
+plain C so consumers can include it without depending on anything else
+
+the object starts with MosaiikkiSharedRing, followed by slotCount slots at slotOffset + i * slotSize.
+each slot starts with MosaiikkiSharedFrame, the pixels are at pixelOffset inside the slot.
+frame N is written to slot N % slotCount.
+
+reading without copying (seqlock):
+- load published (acquire), the newest frame is published - 1
+- load the slot's sequence (acquire), skip the frame if it's odd (being written)
+- use the header and pixels in place
+- load sequence again, if it changed the frame was overwritten in the meantime and the data can't be trusted
+the producer stays slotCount - 1 frames ahead before it overwrites a slot, that's the time a consumer has
+
+if state drops to 0 the producer went away or changed the frame size, unmap and open the object again
+*/
+
+#include <stdint.h>
+
+#define MOSAIIKKI_SHM_NAME "/mosaiikki"
+#define MOSAIIKKI_SHM_MAGIC "MOSAIIKK"
+#define MOSAIIKKI_SHM_VERSION 1
+
+#define MOSAIIKKI_SHM_MAX_PASSES 16
+#define MOSAIIKKI_SHM_PASS_NAME_SIZE 48
+
+/* pixel formats */
+#define MOSAIIKKI_SHM_FORMAT_RGBA8 1 /* rows bottom to top, tightly packed */
+
+typedef struct MosaiikkiSharedPass
+{
+    char name[MOSAIIKKI_SHM_PASS_NAME_SIZE]; /* null-terminated */
+    double milliseconds;
+} MosaiikkiSharedPass;
+
+typedef struct MosaiikkiSharedFrame
+{
+    uint64_t sequence; /* 2 * frameIndex + 1 while writing, 2 * frameIndex + 2 when done */
+    uint64_t frameIndex;
+    int64_t submitTime;  /* CLOCK_MONOTONIC nanoseconds when the frame was submitted for readback */
+    int64_t publishTime; /* CLOCK_MONOTONIC nanoseconds when it was written to the ring */
+    /* GPU pass times arrive a few frames late, these are from the newest frame that was measured */
+    uint64_t passFrameIndex;
+    uint32_t passCount;
+    uint32_t reserved;
+    MosaiikkiSharedPass passes[MOSAIIKKI_SHM_MAX_PASSES];
+} MosaiikkiSharedFrame;
+
+typedef struct MosaiikkiSharedRing
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t state; /* 1 while the producer is writing to this object */
+    uint32_t width;
+    uint32_t height;
+    uint32_t format;
+    uint32_t rowStride; /* bytes */
+    uint32_t slotCount;
+    uint32_t reserved;
+    uint64_t slotOffset;  /* bytes from the start of the object */
+    uint64_t slotSize;    /* bytes between slots */
+    uint64_t pixelOffset; /* bytes from the start of a slot */
+    uint64_t published;   /* number of published frames */
+} MosaiikkiSharedRing;
+
+#endif
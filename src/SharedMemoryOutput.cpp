@@ -0,0 +1,191 @@
+#include "SharedMemoryOutput.h"
+
+#include "GpuProfiler.h"
+#include <Corrade/Utility/Algorithms.h>
+#include <Corrade/Utility/Assert.h>
+#include <Corrade/Utility/Debug.h>
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+
+#ifdef CORRADE_TARGET_UNIX
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <time.h>
+#include <unistd.h>
+#endif
+
+using namespace Magnum;
+using namespace Corrade;
+
+namespace
+{
+// consumers map whole pages, keep each slot on its own
+constexpr UnsignedLong SlotAlignment = 4096;
+
+UnsignedLong alignSlot(UnsignedLong offset)
+{
+    return (offset + SlotAlignment - 1) / SlotAlignment * SlotAlignment;
+}
+
+Long monotonicTime()
+{
+#ifdef CORRADE_TARGET_UNIX
+    timespec time;
+    clock_gettime(CLOCK_MONOTONIC, &time);
+    return Long(time.tv_sec) * 1000000000 + time.tv_nsec;
+#else
+    return 0;
+#endif
+}
+
+// the shared fields are plain integers so C consumers can read them, the producer side uses atomics on them
+// UnsignedLong is unsigned long long, ATOMIC_LLONG_LOCK_FREE is 2 if its atomics are always lock-free
+static_assert(sizeof(std::atomic<UnsignedLong>) == sizeof(uint64_t) && ATOMIC_LLONG_LOCK_FREE == 2,
+              "lock-free 64-bit atomics are required for sharing with other processes");
+
+void storeRelease(uint64_t& value, UnsignedLong newValue)
+{
+    reinterpret_cast<std::atomic<UnsignedLong>&>(value).store(newValue, std::memory_order_release);
+}
+} // namespace
+
+bool SharedMemoryOutput::isSupported()
+{
+#ifdef CORRADE_TARGET_UNIX
+    return true;
+#else
+    return false;
+#endif
+}
+
+SharedMemoryOutput::SharedMemoryOutput(Containers::StringView name, const Vector2i& size) : name(name), readback(size)
+{
+#ifdef CORRADE_TARGET_UNIX
+    const UnsignedLong rowStride = size.x() * 4;
+    const UnsignedLong pixelOffset = alignSlot(sizeof(MosaiikkiSharedFrame));
+    const UnsignedLong slotSize = alignSlot(pixelOffset + rowStride * size.y());
+    const UnsignedLong slotOffset = alignSlot(sizeof(MosaiikkiSharedRing));
+    const size_t totalSize = slotOffset + slotSize * SlotCount;
+
+    // replace leftovers of a previous run, consumers of it see the old object until they reopen
+    shm_unlink(this->name.data());
+    const int fd = shm_open(this->name.data(), O_CREAT | O_EXCL | O_RDWR, 0600);
+    if(fd < 0)
+    {
+        Error() << "SharedMemoryOutput: can't create" << this->name << Debug::nospace << ":" << std::strerror(errno);
+        return;
+    }
+
+    void* memory = MAP_FAILED;
+    if(ftruncate(fd, totalSize) == 0)
+        memory = mmap(nullptr, totalSize, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    // the mapping keeps the object alive
+    close(fd);
+
+    if(memory == MAP_FAILED)
+    {
+        Error() << "SharedMemoryOutput: can't map" << this->name << Debug::nospace << ":" << std::strerror(errno);
+        shm_unlink(this->name.data());
+        return;
+    }
+
+    // ftruncate zero-fills, so every slot starts with sequence 0 (never written)
+    ring = static_cast<MosaiikkiSharedRing*>(memory);
+    mappedSize = totalSize;
+
+    std::memcpy(ring->magic, MOSAIIKKI_SHM_MAGIC, sizeof(ring->magic));
+    ring->version = MOSAIIKKI_SHM_VERSION;
+    ring->width = size.x();
+    ring->height = size.y();
+    ring->format = MOSAIIKKI_SHM_FORMAT_RGBA8;
+    ring->rowStride = rowStride;
+    ring->slotCount = SlotCount;
+    ring->slotOffset = slotOffset;
+    ring->slotSize = slotSize;
+    ring->pixelOffset = pixelOffset;
+    ring->published = 0;
+    reinterpret_cast<std::atomic<UnsignedInt>&>(ring->state).store(1, std::memory_order_release);
+#else
+    Error() << "SharedMemoryOutput: POSIX shared memory is not supported on this platform";
+#endif
+}
+
+SharedMemoryOutput::~SharedMemoryOutput()
+{
+#ifdef CORRADE_TARGET_UNIX
+    if(ring)
+    {
+        reinterpret_cast<std::atomic<UnsignedInt>&>(ring->state).store(0, std::memory_order_release);
+        munmap(ring, mappedSize);
+        shm_unlink(name.data());
+    }
+#endif
+}
+
+void SharedMemoryOutput::output(GL::Framebuffer& framebuffer, const GpuProfiler* profiler)
+{
+    if(!ring)
+        return;
+
+    if(profiler && profiler->historyCount() > 0)
+    {
+        const GpuProfiler::FrameResult& result = profiler->historyFrame(profiler->historyCount() - 1);
+        passFrameIndex = result.frame;
+        passCount = 0;
+        for(size_t pass = 0; pass < profiler->passCount() && passCount < MOSAIIKKI_SHM_MAX_PASSES; pass++)
+        {
+            if(result.durations[pass] < 0.0)
+                continue;
+            MosaiikkiSharedPass& shared = passes[passCount++];
+            std::strncpy(shared.name, profiler->passName(pass), sizeof(shared.name) - 1);
+            shared.name[sizeof(shared.name) - 1] = '\0';
+            shared.milliseconds = result.durations[pass];
+        }
+    }
+
+    // publish everything that's done, oldest first to keep the order
+    while(readback.acquire(false))
+        publish();
+    if(readback.isFull())
+    {
+        readback.acquire(true);
+        publish();
+    }
+
+    const size_t frame = readback.read(framebuffer);
+    submitTimes[frame % FrameReadback::BufferCount] = monotonicTime();
+}
+
+void SharedMemoryOutput::flush()
+{
+    while(readback.acquire(true))
+        publish();
+}
+
+void SharedMemoryOutput::publish()
+{
+    const UnsignedLong frameIndex = readback.frame();
+    char* const slot = reinterpret_cast<char*>(ring) + ring->slotOffset + (frameIndex % SlotCount) * ring->slotSize;
+    MosaiikkiSharedFrame& header = *reinterpret_cast<MosaiikkiSharedFrame*>(slot);
+
+    // odd while writing, consumers that started reading the previous frame in this slot notice the change
+    storeRelease(header.sequence, frameIndex * 2 + 1);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    header.frameIndex = frameIndex;
+    header.submitTime = submitTimes[frameIndex % FrameReadback::BufferCount];
+    header.passFrameIndex = passFrameIndex;
+    header.passCount = passCount;
+    Utility::copy(Containers::arrayView(passes).prefix(passCount),
+                  Containers::arrayView(header.passes).prefix(passCount));
+
+    const Containers::ArrayView<const char> pixels = readback.pixels();
+    std::memcpy(slot + ring->pixelOffset, pixels.data(), pixels.size());
+    readback.release();
+
+    header.publishTime = monotonicTime();
+    storeRelease(header.sequence, frameIndex * 2 + 2);
+    storeRelease(ring->published, frameIndex + 1);
+    published++;
+}
@@ -0,0 +1,72 @@
+#pragma once
+
+#include "FrameReadback.h"
+#include "SharedMemoryFormat.h"
+#include <Magnum/Magnum.h>
+#include <Magnum/GL/GL.h>
+#include <Magnum/Math/Vector2.h>
+#include <Corrade/Containers/String.h>
+#include <Corrade/Containers/StringView.h>
+
+class GpuProfiler;
+
+// publishes resolved frames to a POSIX shared memory object for a consumer process on the same machine
+// frames are read back with FrameReadback and copied into a ring of slots that consumers map and read in place,
+// see SharedMemoryFormat.h for the layout and the reading protocol
+class SharedMemoryOutput
+{
+public:
+    static constexpr Magnum::UnsignedInt SlotCount = 4;
+
+    // POSIX shared memory, not available on Windows
+    static bool isSupported();
+
+    // creates (or replaces) the shared memory object, check isOpen() afterwards
+    explicit SharedMemoryOutput(Corrade::Containers::StringView name, const Magnum::Vector2i& size);
+    // marks the ring as closed and removes the object, consumers keep their mapping until they unmap it
+    ~SharedMemoryOutput();
+
+    // Copying is not allowed
+    SharedMemoryOutput(const SharedMemoryOutput&) = delete;
+    SharedMemoryOutput& operator=(const SharedMemoryOutput&) = delete;
+
+    bool isOpen() const
+    {
+        return ring != nullptr;
+    }
+
+    Magnum::Vector2i size() const
+    {
+        return readback.size();
+    }
+
+    // queue the frame for readback and publish all earlier frames whose readback finished
+    // profiler is optional, the newest finished frame's pass times are attached to published frames
+    void output(Magnum::GL::Framebuffer& framebuffer, const GpuProfiler* profiler);
+
+    // wait for all pending readbacks and publish them
+    void flush();
+
+    size_t publishedFrames() const
+    {
+        return published;
+    }
+
+private:
+    void publish();
+
+    Corrade::Containers::String name;
+    FrameReadback readback;
+
+    MosaiikkiSharedRing* ring = nullptr;
+    size_t mappedSize = 0;
+    size_t published = 0;
+
+    // submit time of each frame in flight, indexed by frame % BufferCount
+    Magnum::Long submitTimes[FrameReadback::BufferCount] = {};
+
+    // copy of the newest profiler results, the profiler might be gone by the time frames are published
+    Magnum::UnsignedLong passFrameIndex = 0;
+    Magnum::UnsignedInt passCount = 0;
+    MosaiikkiSharedPass passes[MOSAIIKKI_SHM_MAX_PASSES];
+};
@@ -0,0 +1,176 @@
+#include "StreamingBuffer.h"
+
+#include <Magnum/GL/Context.h>
+#include <Magnum/GL/Extensions.h>
+#include <Corrade/Utility/Assert.h>
+#include <cstring>
+#include <utility>
+
+using namespace Magnum;
+using namespace Corrade;
+
+bool waitFence(GLsync& fence, bool wait)
+{
+    // flush on the first retry in case the fence is still in our command queue
+    GLbitfield flags = 0;
+    GLuint64 timeout = 0;
+    GLenum result;
+    while((result = glClientWaitSync(fence, flags, timeout)) == GL_TIMEOUT_EXPIRED)
+    {
+        if(!wait)
+            return false;
+        flags = GL_SYNC_FLUSH_COMMANDS_BIT;
+        timeout = 1000000; // 1 ms
+    }
+    CORRADE_INTERNAL_ASSERT(result != GL_WAIT_FAILED);
+    glDeleteSync(fence);
+    fence = nullptr;
+    return true;
+}
+
+StreamingBuffer::StreamingBuffer(NoCreateT) : buffer(NoCreate) { }
+
+StreamingBuffer::StreamingBuffer(size_t frameCapacity) : buffer(NoCreate)
+{
+    CORRADE_ASSERT(frameCapacity > 0, "StreamingBuffer: capacity can't be 0", );
+
+    GL::Context& context = GL::Context::current();
+    persistent = context.isExtensionSupported<GL::Extensions::ARB::buffer_storage>(); // core in 4.4
+    baseInstance = context.isExtensionSupported<GL::Extensions::ARB::base_instance>(); // core in 4.2
+
+    allocate(frameCapacity);
+}
+
+StreamingBuffer::~StreamingBuffer()
+{
+    destroyFences();
+}
+
+StreamingBuffer::StreamingBuffer(StreamingBuffer&& other) noexcept : StreamingBuffer(NoCreate)
+{
+    *this = std::move(other);
+}
+
+StreamingBuffer& StreamingBuffer::operator=(StreamingBuffer&& other) noexcept
+{
+    using std::swap;
+    swap(buffer, other.buffer);
+    swap(mapped, other.mapped);
+    swap(persistent, other.persistent);
+    swap(baseInstance, other.baseInstance);
+    swap(frameCapacity, other.frameCapacity);
+    swap(region, other.region);
+    swap(regionOffset, other.regionOffset);
+    swap(inFrame, other.inFrame);
+    swap(fences, other.fences);
+    swap(generation, other.generation);
+    return *this;
+}
+
+void StreamingBuffer::beginFrame()
+{
+    CORRADE_ASSERT(!inFrame, "StreamingBuffer::beginFrame(): frame already started", );
+
+    if(persistent)
+    {
+        region = (region + 1) % FramesInFlight;
+        if(fences[region])
+            waitFence(fences[region]);
+    }
+    else
+    {
+        // orphan, the driver hands out new storage while the GPU still reads the old one
+        buffer.setData({ nullptr, frameCapacity }, GL::BufferUsage::StreamDraw);
+    }
+
+    regionOffset = 0;
+    inFrame = true;
+}
+
+void StreamingBuffer::endFrame()
+{
+    CORRADE_ASSERT(inFrame, "StreamingBuffer::endFrame(): no frame started", );
+
+    if(persistent)
+        fences[region] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+
+    inFrame = false;
+}
+
+StreamingBuffer::Allocation StreamingBuffer::upload(Containers::ArrayView<const void> data, size_t alignment)
+{
+    CORRADE_ASSERT(inFrame, "StreamingBuffer::upload(): no frame started", {});
+    CORRADE_ASSERT(alignment > 0, "StreamingBuffer::upload(): alignment can't be 0", {});
+
+    const size_t regionStart = persistent ? region * frameCapacity : 0;
+    size_t offset = (regionStart + regionOffset + alignment - 1) / alignment * alignment;
+
+    if(offset + data.size() > regionStart + frameCapacity)
+    {
+        // out of space, replace the buffer with a larger one
+        // previous draws keep referencing the old storage until they're done
+        size_t capacity = frameCapacity * 2;
+        while(capacity < data.size() + alignment)
+            capacity *= 2;
+        allocate(capacity);
+
+        offset = 0;
+    }
+
+    if(persistent)
+        std::memcpy(mapped + offset, data.data(), data.size());
+    else
+        buffer.setSubData(offset, data);
+
+    regionOffset = offset + data.size() - (persistent ? region * frameCapacity : 0);
+
+    Allocation allocation;
+    allocation.buffer = &buffer;
+    allocation.offset = offset;
+    allocation.generation = generation;
+    return allocation;
+}
+
+void StreamingBuffer::allocate(size_t capacity)
+{
+    // the new buffer isn't in use by the GPU yet
+    destroyFences();
+
+    frameCapacity = capacity;
+    region = 0;
+    regionOffset = 0;
+    generation++;
+
+    buffer = GL::Buffer(GL::Buffer::TargetHint::Array);
+    buffer.setLabel("Streaming buffer");
+
+    if(persistent)
+    {
+        const size_t size = frameCapacity * FramesInFlight;
+        buffer.setStorage({ nullptr, size },
+                          GL::Buffer::StorageFlag::MapWrite | GL::Buffer::StorageFlag::MapPersistent |
+                              GL::Buffer::StorageFlag::MapCoherent);
+        mapped = buffer.map(0,
+                            size,
+                            GL::Buffer::MapFlag::Write | GL::Buffer::MapFlag::Persistent |
+                                GL::Buffer::MapFlag::Coherent);
+        CORRADE_INTERNAL_ASSERT(mapped);
+    }
+    else
+    {
+        mapped = nullptr;
+        buffer.setData({ nullptr, frameCapacity }, GL::BufferUsage::StreamDraw);
+    }
+}
+
+void StreamingBuffer::destroyFences()
+{
+    for(GLsync& fence : fences)
+    {
+        if(fence)
+        {
+            glDeleteSync(fence);
+            fence = nullptr;
+        }
+    }
+}
@@ -0,0 +1,89 @@
+#pragma once
+
+#include <Magnum/Magnum.h>
+#include <Magnum/GL/Buffer.h>
+#include <Magnum/GL/OpenGL.h>
+#include <Corrade/Containers/ArrayView.h>
+
+// upload allocator for data that changes every frame (instance data, uniform buffers)
+// with ARB_buffer_storage the buffer is persistently mapped and split into one region per frame in flight,
+// a fence keeps each region from being overwritten while the GPU might still read it.
+// without it, the buffer is orphaned once per frame and written with setSubData().
+// all allocations are only valid until the next beginFrame()
+class StreamingBuffer
+{
+public:
+    static constexpr size_t FramesInFlight = 3;
+
+    struct Allocation
+    {
+        Magnum::GL::Buffer* buffer = nullptr;
+        // offset into buffer in bytes
+        Magnum::GLintptr offset = 0;
+        // changes whenever the buffer is replaced with a larger one
+        // anything that references buffer (e.g. instanced attributes) has to be set up again
+        Magnum::UnsignedInt generation = 0;
+    };
+
+    explicit StreamingBuffer(Magnum::NoCreateT);
+    // frameCapacity is the initial size in bytes available to each frame, the buffer grows if needed
+    explicit StreamingBuffer(size_t frameCapacity = 1 << 20);
+
+    ~StreamingBuffer();
+
+    // Copying is not allowed
+    StreamingBuffer(const StreamingBuffer&) = delete;
+    StreamingBuffer& operator=(const StreamingBuffer&) = delete;
+
+    StreamingBuffer(StreamingBuffer&& other) noexcept;
+    StreamingBuffer& operator=(StreamingBuffer&& other) noexcept;
+
+    bool isPersistent() const
+    {
+        return persistent;
+    }
+
+    // ARB_base_instance, instanced attributes can stay bound at offset 0 and the
+    // allocation is selected with Mesh::setBaseInstance()
+    bool isBaseInstanceSupported() const
+    {
+        return baseInstance;
+    }
+
+    // changes whenever the buffer is replaced, see Allocation::generation
+    Magnum::UnsignedInt currentGeneration() const
+    {
+        return generation;
+    }
+
+    // waits for the GPU to finish reading the region that's about to be reused
+    // this only blocks if the CPU is more than FramesInFlight frames ahead
+    void beginFrame();
+    void endFrame();
+
+    // copy data into the buffer, offset is a multiple of alignment (doesn't have to be a power of two)
+    Allocation upload(Corrade::Containers::ArrayView<const void> data, size_t alignment = 4);
+
+private:
+    void allocate(size_t capacity);
+    void destroyFences();
+
+    Magnum::GL::Buffer buffer;
+    char* mapped = nullptr;
+    bool persistent = false;
+    bool baseInstance = false;
+
+    size_t frameCapacity = 0;
+    // current frame region and how much of it is used
+    size_t region = 0;
+    size_t regionOffset = 0;
+    bool inFrame = false;
+
+    GLsync fences[FramesInFlight] = {};
+
+    Magnum::UnsignedInt generation = 0;
+};
+
+// wait for a fence from glFenceSync(), then delete it and set it to nullptr
+// returns false without waiting if wait is false and the fence isn't signaled yet
+bool waitFence(GLsync& fence, bool wait = true);
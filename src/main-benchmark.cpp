@@ -0,0 +1,3 @@
+#include "MosaiikkiBenchmark.h"
+
+MAGNUM_WINDOWLESSAPPLICATION_MAIN(MosaiikkiBenchmark)